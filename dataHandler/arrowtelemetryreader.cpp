@@ -0,0 +1,181 @@
+// Arrow first, Qt's keyword macros must not leak into its headers
+#include <arrow/api.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/reader.h>
+
+#include "arrowtelemetryreader.h"
+#include <QDebug>
+
+namespace {
+
+struct ColumnIndices {
+    int series = -1;
+    int time = -1;
+    int value = -1;
+};
+
+bool resolveColumns(const arrow::Schema& schema, ColumnIndices& indices, QString& message)
+{
+    indices.series = schema.GetFieldIndex("series");
+    indices.time = schema.GetFieldIndex("time");
+    indices.value = schema.GetFieldIndex("value");
+    if (indices.series < 0 || indices.time < 0 || indices.value < 0) {
+        message = QString("Arrow schema lacks series/time/value columns: %1")
+                      .arg(QString::fromStdString(schema.ToString()));
+        return false;
+    }
+
+    const arrow::Type::type seriesType = schema.field(indices.series)->type()->id();
+    const arrow::Type::type valueType = schema.field(indices.value)->type()->id();
+    if (seriesType != arrow::Type::INT32 && seriesType != arrow::Type::INT64) {
+        message = "Arrow column 'series' must be int32 or int64";
+        return false;
+    }
+    if (schema.field(indices.time)->type()->id() != arrow::Type::TIMESTAMP) {
+        message = "Arrow column 'time' must be a timestamp";
+        return false;
+    }
+    if (valueType != arrow::Type::DOUBLE && valueType != arrow::Type::FLOAT && valueType != arrow::Type::INT64) {
+        message = "Arrow column 'value' must be float64, float32 or int64";
+        return false;
+    }
+    return true;
+}
+
+// Copies one record batch; returns the number of rows that were skipped
+template <typename SeriesArray, typename ValueArray>
+qint64 appendRows(const arrow::Array& seriesColumn, const arrow::TimestampArray& times,
+                  const arrow::Array& valueColumn, TelemetryColumns& columns)
+{
+    const auto& series = static_cast<const SeriesArray&>(seriesColumn);
+    const auto& values = static_cast<const ValueArray&>(valueColumn);
+
+    // Scale to milliseconds once per batch instead of per row
+    qint64 multiplier = 1;
+    qint64 divisor = 1;
+    switch (static_cast<const arrow::TimestampType&>(*times.type()).unit()) {
+    case arrow::TimeUnit::SECOND: multiplier = 1000; break;
+    case arrow::TimeUnit::MILLI: break;
+    case arrow::TimeUnit::MICRO: divisor = 1000; break;
+    case arrow::TimeUnit::NANO: divisor = 1000000; break;
+    }
+
+    const auto *seriesData = series.raw_values();
+    const int64_t *timeData = times.raw_values();
+    const auto *valueData = values.raw_values();
+    const bool hasNulls = series.null_count() > 0 || times.null_count() > 0 || values.null_count() > 0;
+
+    // Rows of one series usually come in long runs, resolve the target per run
+    int64_t currentId = -1;
+    TelemetrySeries *target = nullptr;
+    qint64 skipped = 0;
+
+    const int64_t rows = times.length();
+    for (int64_t i = 0; i < rows; ++i) {
+        if (hasNulls && (series.IsNull(i) || times.IsNull(i) || values.IsNull(i))) {
+            skipped++;
+            continue;
+        }
+        if (seriesData[i] != currentId) {
+            currentId = seriesData[i];
+            target = columns.series(int(currentId));
+        }
+        if (!target) {
+            skipped++;
+            continue;
+        }
+        target->append(timeData[i] * multiplier / divisor, double(valueData[i]));
+    }
+    return skipped;
+}
+
+template <typename SeriesArray>
+qint64 appendRowsByValueType(const arrow::Array& seriesColumn, const arrow::TimestampArray& times,
+                             const arrow::Array& valueColumn, TelemetryColumns& columns)
+{
+    switch (valueColumn.type_id()) {
+    case arrow::Type::DOUBLE:
+        return appendRows<SeriesArray, arrow::DoubleArray>(seriesColumn, times, valueColumn, columns);
+    case arrow::Type::FLOAT:
+        return appendRows<SeriesArray, arrow::FloatArray>(seriesColumn, times, valueColumn, columns);
+    default:
+        return appendRows<SeriesArray, arrow::Int64Array>(seriesColumn, times, valueColumn, columns);
+    }
+}
+
+qint64 appendBatch(const arrow::RecordBatch& batch, const ColumnIndices& indices, TelemetryColumns& columns)
+{
+    const arrow::Array& seriesColumn = *batch.column(indices.series);
+    const auto& times = static_cast<const arrow::TimestampArray&>(*batch.column(indices.time));
+    const arrow::Array& valueColumn = *batch.column(indices.value);
+
+    if (seriesColumn.type_id() == arrow::Type::INT32) {
+        return appendRowsByValueType<arrow::Int32Array>(seriesColumn, times, valueColumn, columns);
+    }
+    return appendRowsByValueType<arrow::Int64Array>(seriesColumn, times, valueColumn, columns);
+}
+
+} // namespace
+
+bool ArrowTelemetryReader::read(const QByteArray& data, TelemetryColumns& columns, QString *error)
+{
+    auto fail = [error](const QString& message) {
+        qDebug() << "ArrowTelemetryReader:" << message;
+        if (error) *error = message;
+        return false;
+    };
+
+    // Wrap the reply without copying it, data outlives the reader
+    auto buffer = std::make_shared<arrow::Buffer>(reinterpret_cast<const uint8_t*>(data.constData()),
+                                                  int64_t(data.size()));
+    auto input = std::make_shared<arrow::io::BufferReader>(buffer);
+
+    ColumnIndices indices;
+    QString message;
+    qint64 rows = 0;
+    qint64 skipped = 0;
+
+    // The IPC file format starts with the "ARROW1" magic, everything else is read as a stream
+    if (data.startsWith("ARROW1")) {
+        auto opened = arrow::ipc::RecordBatchFileReader::Open(input);
+        if (!opened.ok()) {
+            return fail(QString::fromStdString(opened.status().ToString()));
+        }
+        std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader = *opened;
+        if (!resolveColumns(*reader->schema(), indices, message)) {
+            return fail(message);
+        }
+        for (int i = 0; i < reader->num_record_batches(); ++i) {
+            auto batch = reader->ReadRecordBatch(i);
+            if (!batch.ok()) {
+                return fail(QString::fromStdString(batch.status().ToString()));
+            }
+            rows += (*batch)->num_rows();
+            skipped += appendBatch(**batch, indices, columns);
+        }
+    } else {
+        auto opened = arrow::ipc::RecordBatchStreamReader::Open(input);
+        if (!opened.ok()) {
+            return fail(QString::fromStdString(opened.status().ToString()));
+        }
+        std::shared_ptr<arrow::ipc::RecordBatchStreamReader> reader = *opened;
+        if (!resolveColumns(*reader->schema(), indices, message)) {
+            return fail(message);
+        }
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> batch;
+            arrow::Status status = reader->ReadNext(&batch);
+            if (!status.ok()) {
+                return fail(QString::fromStdString(status.ToString()));
+            }
+            if (!batch) break;
+            rows += batch->num_rows();
+            skipped += appendBatch(*batch, indices, columns);
+        }
+    }
+
+    if (skipped > 0) {
+        qDebug() << "ArrowTelemetryReader: Skipped" << skipped << "of" << rows << "rows (null or unknown series)";
+    }
+    return true;
+}
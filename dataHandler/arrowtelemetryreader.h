@@ -0,0 +1,20 @@
+#ifndef ARROWTELEMETRYREADER_H
+#define ARROWTELEMETRYREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include "telemetrycolumns.h"
+
+// Decodes an Arrow IPC stream or file holding the columns
+//   series (int32/int64, a TelemetryColumns::Series id),
+//   time   (timestamp, any unit),
+//   value  (float64/float32/int64)
+// and copies the time and value buffers straight into TelemetryColumns,
+// without going through text. Only built when Arrow is available.
+class ArrowTelemetryReader
+{
+public:
+    static bool read(const QByteArray& data, TelemetryColumns& columns, QString *error = nullptr);
+};
+
+#endif // ARROWTELEMETRYREADER_H
@@ -0,0 +1,359 @@
+#include "compressedtelemetry.h"
+#include <QtAlgorithms>
+#include <QTimeZone>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+quint64 doubleBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsDouble(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Most significant bit first, into 64-bit words
+class BitWriter
+{
+public:
+    explicit BitWriter(QList<quint64>& words) : m_words(words), m_bitCount(0) {}
+
+    // The low 'bits' bits of value, 1 <= bits <= 64
+    void write(quint64 value, int bits)
+    {
+        if (bits < 64) value &= (quint64(1) << bits) - 1;
+        const int offset = int(m_bitCount & 63);
+        if (offset == 0) m_words.append(0);
+        const int free = 64 - offset;
+        if (bits <= free) {
+            m_words.last() |= value << (free - bits);
+        } else {
+            const int rest = bits - free;
+            m_words.last() |= value >> rest;
+            m_words.append(value << (64 - rest));
+        }
+        m_bitCount += bits;
+    }
+
+private:
+    QList<quint64>& m_words;
+    qint64 m_bitCount;
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const QList<quint64>& words) : m_words(words.constData()), m_position(0) {}
+
+    quint64 read(int bits)
+    {
+        const quint64 word = m_words[m_position >> 6];
+        const int offset = int(m_position & 63);
+        const int available = 64 - offset;
+        m_position += bits;
+        if (bits <= available) {
+            const quint64 value = word >> (available - bits);
+            return bits < 64 ? value & ((quint64(1) << bits) - 1) : value;
+        }
+        const int rest = bits - available;
+        const quint64 high = word & ((quint64(1) << available) - 1);
+        return (high << rest) | (m_words[(m_position - 1) >> 6] >> (64 - rest));
+    }
+
+    bool readBit() { return read(1) != 0; }
+
+private:
+    const quint64 *m_words;
+    qint64 m_position;
+};
+
+// Delta-of-delta codes: '0' for a repeated interval, then growing buckets of
+// the zigzagged difference
+void encodeTimestamps(const qint64 *msecs, qsizetype count, QList<quint64>& words)
+{
+    BitWriter writer(words);
+    writer.write(quint64(msecs[0]), 64);
+    qint64 previousDelta = 0;
+    for (qsizetype i = 1; i < count; ++i) {
+        const qint64 delta = msecs[i] - msecs[i - 1];
+        const quint64 code = zigzag(delta - previousDelta);
+        previousDelta = delta;
+        if (code == 0) {
+            writer.write(0, 1);
+        } else if (code < (quint64(1) << 7)) {
+            writer.write(0b10, 2);
+            writer.write(code, 7);
+        } else if (code < (quint64(1) << 12)) {
+            writer.write(0b110, 3);
+            writer.write(code, 12);
+        } else if (code < (quint64(1) << 20)) {
+            writer.write(0b1110, 4);
+            writer.write(code, 20);
+        } else {
+            writer.write(0b1111, 4);
+            writer.write(code, 64);
+        }
+    }
+}
+
+void decodeTimestamps(const QList<quint64>& words, qsizetype count, qint64 *msecs)
+{
+    BitReader reader(words);
+    msecs[0] = qint64(reader.read(64));
+    qint64 delta = 0;
+    for (qsizetype i = 1; i < count; ++i) {
+        int bits = 0;
+        if (!reader.readBit()) bits = 0;
+        else if (!reader.readBit()) bits = 7;
+        else if (!reader.readBit()) bits = 12;
+        else if (!reader.readBit()) bits = 20;
+        else bits = 64;
+        if (bits > 0) delta += unzigzag(reader.read(bits));
+        msecs[i] = msecs[i - 1] + delta;
+    }
+}
+
+// XOR with the previous value: '0' when equal, otherwise the meaningful bits,
+// reusing the previous leading/trailing zero window when they fit in it
+void encodeValues(const double *values, qsizetype count, QList<quint64>& words)
+{
+    BitWriter writer(words);
+    quint64 previous = doubleBits(values[0]);
+    writer.write(previous, 64);
+    int leading = -1;
+    int trailing = 0;
+    for (qsizetype i = 1; i < count; ++i) {
+        const quint64 bits = doubleBits(values[i]);
+        const quint64 xored = bits ^ previous;
+        previous = bits;
+        if (xored == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+        const int newLeading = qMin(int(qCountLeadingZeroBits(xored)), 31);
+        const int newTrailing = int(qCountTrailingZeroBits(xored));
+        if (leading >= 0 && newLeading >= leading && newTrailing >= trailing) {
+            writer.write(0b10, 2);
+            writer.write(xored >> trailing, 64 - leading - trailing);
+        } else {
+            leading = newLeading;
+            trailing = newTrailing;
+            const int significant = 64 - leading - trailing;
+            writer.write(0b11, 2);
+            writer.write(quint64(leading), 5);
+            writer.write(quint64(significant - 1), 6);
+            writer.write(xored >> trailing, significant);
+        }
+    }
+}
+
+void decodeValues(const QList<quint64>& words, qsizetype count, double *values)
+{
+    BitReader reader(words);
+    quint64 previous = reader.read(64);
+    values[0] = bitsDouble(previous);
+    int leading = 0;
+    int trailing = 0;
+    for (qsizetype i = 1; i < count; ++i) {
+        if (reader.readBit()) {
+            if (reader.readBit()) {
+                leading = int(reader.read(5));
+                trailing = 64 - leading - (int(reader.read(6)) + 1);
+            }
+            previous ^= reader.read(64 - leading - trailing) << trailing;
+        }
+        values[i] = bitsDouble(previous);
+    }
+}
+
+} // namespace
+
+void CompressedTelemetry::BlockSummary::add(qint64 msecs)
+{
+    if (count == 0) firstMsecs = msecs;
+    lastMsecs = msecs;
+    count++;
+}
+
+CompressedTelemetry::CompressedTelemetry()
+    : m_size(0)
+{
+}
+
+void CompressedTelemetry::append(qint64 msecs, double speed, double charge)
+{
+    // Sealed when the next point arrives, so the newest point is always in the tail
+    if (m_tail.count == BLOCK_POINTS) {
+        sealTail();
+    }
+    if (m_tailMsecs.isEmpty()) {
+        m_tailMsecs.reserve(BLOCK_POINTS);
+        m_tailSpeeds.reserve(BLOCK_POINTS);
+        m_tailCharges.reserve(BLOCK_POINTS);
+    }
+    m_tailMsecs.append(msecs);
+    m_tailSpeeds.append(speed);
+    m_tailCharges.append(charge);
+    m_tail.add(msecs);
+    m_size++;
+}
+
+void CompressedTelemetry::sealTail()
+{
+    Block block;
+    block.summary = m_tail;
+    const qsizetype count = m_tailMsecs.size();
+    encodeTimestamps(m_tailMsecs.constData(), count, block.timeBits);
+    encodeValues(m_tailSpeeds.constData(), count, block.speedBits);
+    encodeValues(m_tailCharges.constData(), count, block.chargeBits);
+    block.timeBits.squeeze();
+    block.speedBits.squeeze();
+    block.chargeBits.squeeze();
+    m_blocks.append(block);
+
+    m_tail = BlockSummary();
+    m_tailMsecs.clear();
+    m_tailSpeeds.clear();
+    m_tailCharges.clear();
+}
+
+void CompressedTelemetry::clear()
+{
+    m_blocks.clear();
+    m_tail = BlockSummary();
+    m_tailMsecs.clear();
+    m_tailSpeeds.clear();
+    m_tailCharges.clear();
+    m_size = 0;
+}
+
+VehicleDataPoint CompressedTelemetry::first() const
+{
+    if (m_blocks.isEmpty()) {
+        if (m_tailMsecs.isEmpty()) return VehicleDataPoint();
+        return VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(m_tailMsecs.first(), QTimeZone::UTC),
+                                m_tailSpeeds.first(), m_tailCharges.first());
+    }
+    // The first value of every stream is stored as is
+    const Block& block = m_blocks.first();
+    return VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(block.summary.firstMsecs, QTimeZone::UTC),
+                            bitsDouble(block.speedBits.first()), bitsDouble(block.chargeBits.first()));
+}
+
+VehicleDataPoint CompressedTelemetry::last() const
+{
+    if (m_tailMsecs.isEmpty()) return VehicleDataPoint();
+    return VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(m_tailMsecs.last(), QTimeZone::UTC),
+                            m_tailSpeeds.last(), m_tailCharges.last());
+}
+
+void CompressedTelemetry::removeBefore(qint64 msecs)
+{
+    if (m_tail.count > 0 && m_tail.lastMsecs < msecs) {
+        clear();
+        return;
+    }
+    qsizetype expired = 0;
+    while (expired < m_blocks.size() && m_blocks[expired].summary.lastMsecs < msecs) {
+        m_size -= m_blocks[expired].summary.count;
+        expired++;
+    }
+    if (expired > 0) {
+        m_blocks.remove(0, expired);
+    }
+}
+
+int CompressedTelemetry::blockCount() const
+{
+    return int(m_blocks.size()) + (m_tail.count > 0 ? 1 : 0);
+}
+
+CompressedTelemetry::BlockSummary CompressedTelemetry::summary(int block) const
+{
+    return block < m_blocks.size() ? m_blocks[block].summary : m_tail;
+}
+
+void CompressedTelemetry::decodeBlock(int block, QList<qint64>& msecs, QList<double>& speeds,
+                                      QList<double>& charges) const
+{
+    if (block >= m_blocks.size()) {
+        msecs.append(m_tailMsecs);
+        speeds.append(m_tailSpeeds);
+        charges.append(m_tailCharges);
+        return;
+    }
+
+    const Block& sealed = m_blocks[block];
+    const qsizetype count = sealed.summary.count;
+    const qsizetype offset = msecs.size();
+    msecs.resize(offset + count);
+    speeds.resize(offset + count);
+    charges.resize(offset + count);
+    decodeTimestamps(sealed.timeBits, count, msecs.data() + offset);
+    decodeValues(sealed.speedBits, count, speeds.data() + offset);
+    decodeValues(sealed.chargeBits, count, charges.data() + offset);
+}
+
+QList<VehicleDataPoint> CompressedTelemetry::toDataPoints(int firstBlock, int endBlock) const
+{
+    QList<qint64> msecs;
+    QList<double> speeds;
+    QList<double> charges;
+    for (int block = firstBlock; block < endBlock; ++block) {
+        decodeBlock(block, msecs, speeds, charges);
+    }
+
+    QList<VehicleDataPoint> points;
+    points.reserve(msecs.size());
+    for (qsizetype i = 0; i < msecs.size(); ++i) {
+        points.append(VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(msecs[i], QTimeZone::UTC),
+                                       speeds[i], charges[i]));
+    }
+    return points;
+}
+
+QList<VehicleDataPoint> CompressedTelemetry::pointsBetween(qint64 from, qint64 to) const
+{
+    // Blocks are in time order, find the first one that ends at or after 'from'
+    const auto firstSealed = std::lower_bound(m_blocks.cbegin(), m_blocks.cend(), from,
+        [](const Block& block, qint64 msecs) { return block.summary.lastMsecs < msecs; });
+
+    int endBlock = int(firstSealed - m_blocks.cbegin());
+    while (endBlock < blockCount() && summary(endBlock).firstMsecs <= to) {
+        endBlock++;
+    }
+
+    QList<VehicleDataPoint> points = toDataPoints(int(firstSealed - m_blocks.cbegin()), endBlock);
+    const auto first = std::lower_bound(points.cbegin(), points.cend(), from,
+        [](const VehicleDataPoint& point, qint64 msecs) { return point.timestamp.toMSecsSinceEpoch() < msecs; });
+    const auto last = std::upper_bound(first, points.cend(), to,
+        [](qint64 msecs, const VehicleDataPoint& point) { return msecs < point.timestamp.toMSecsSinceEpoch(); });
+    return QList<VehicleDataPoint>(first, last);
+}
+
+qsizetype CompressedTelemetry::compressedBytes() const
+{
+    qsizetype bytes = 0;
+    for (const Block& block : m_blocks) {
+        bytes += (block.timeBits.size() + block.speedBits.size() + block.chargeBits.size()) * qsizetype(sizeof(quint64));
+    }
+    return bytes;
+}
@@ -0,0 +1,85 @@
+#ifndef COMPRESSEDTELEMETRY_H
+#define COMPRESSEDTELEMETRY_H
+
+#include <QList>
+#include <QtGlobal>
+
+#include "tripdata.h"
+
+// Append-only in-memory history of the merged speed and charge timeline,
+// compressed the way Gorilla (Facebook's time-series store) does it.
+//
+// Points are sealed in blocks of BLOCK_POINTS. Within a block each column is
+// its own bit stream: timestamps as delta-of-delta with short codes for
+// regular sampling, speed and charge as the XOR of consecutive IEEE doubles,
+// which is a single bit for a repeated value. A parked vehicle costs a few
+// bits per point, driving a few bytes, against 24 bytes and up for a
+// VehicleDataPoint. Values are stored exactly, NaN included.
+//
+// Every block keeps a summary of its time range, so time range reads decode
+// only the blocks they overlap. Decoding goes column by
+// column into flat arrays, the layout the statistics kernels take. The newest
+// points stay uncompressed until their block is full.
+class CompressedTelemetry
+{
+public:
+    struct BlockSummary {
+        qint64 firstMsecs = 0;
+        qint64 lastMsecs = 0;
+        int count = 0;
+
+        void add(qint64 msecs);
+    };
+
+    CompressedTelemetry();
+
+    // Points must come in time order
+    void append(qint64 msecs, double speed, double charge);
+    void clear();
+
+    qsizetype size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    VehicleDataPoint first() const;
+    VehicleDataPoint last() const;
+    qint64 lastMsecs() const { return m_tail.lastMsecs; }
+
+    // Drops the blocks whose points are all older than 'msecs'; a block that
+    // straddles it is kept whole
+    void removeBefore(qint64 msecs);
+
+    // Sealed blocks followed by the open one, if it has points
+    int blockCount() const;
+    BlockSummary summary(int block) const;
+    // Appends the block's columns to the lists
+    void decodeBlock(int block, QList<qint64>& msecs, QList<double>& speeds, QList<double>& charges) const;
+
+    // Points of blocks [firstBlock, endBlock)
+    QList<VehicleDataPoint> toDataPoints(int firstBlock, int endBlock) const;
+    // Points with from <= time <= to, only the overlapping blocks are decoded
+    QList<VehicleDataPoint> pointsBetween(qint64 from, qint64 to) const;
+
+    // Memory held by the sealed blocks' bit streams
+    qsizetype compressedBytes() const;
+
+    static const int BLOCK_POINTS = 1024;
+
+private:
+    struct Block {
+        BlockSummary summary;
+        QList<quint64> timeBits;
+        QList<quint64> speedBits;
+        QList<quint64> chargeBits;
+    };
+
+    void sealTail();
+
+    QList<Block> m_blocks;
+    // Open block, uncompressed
+    BlockSummary m_tail;
+    QList<qint64> m_tailMsecs;
+    QList<double> m_tailSpeeds;
+    QList<double> m_tailCharges;
+    qsizetype m_size;
+};
+
+#endif // COMPRESSEDTELEMETRY_H
@@ -0,0 +1,66 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// CPU feature dispatch shared by the vectorized kernels (TripStatsKernels,
+// MotionSegmentation). Every kernel has a scalar version; on x86 with GCC or
+// Clang an AVX2 version is also built, regardless of the compiler flags, and
+// chosen at run time when the CPU has AVX2. On AArch64 NEON is always there.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_FEATURES_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define CPU_FEATURES_NEON
+#include <arm_neon.h>
+#endif
+
+// Marks a function built for AVX2, only to be called after the CPU check
+#define CPU_FEATURES_TARGET_AVX2 __attribute__((target("avx2")))
+
+// A kernel function where the feature is compiled in, nullptr elsewhere
+#ifdef CPU_FEATURES_AVX2
+#define CPU_FEATURES_IF_AVX2(function) function
+#else
+#define CPU_FEATURES_IF_AVX2(function) nullptr
+#endif
+#ifdef CPU_FEATURES_NEON
+#define CPU_FEATURES_IF_NEON(function) function
+#else
+#define CPU_FEATURES_IF_NEON(function) nullptr
+#endif
+
+namespace CpuFeatures {
+
+inline bool hasAvx2()
+{
+#ifdef CPU_FEATURES_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// The implementation picked for this CPU and its name, for logging
+template <typename Function>
+struct Kernel {
+    Function function;
+    const char *name;
+};
+
+// Best available of the AVX2, NEON and scalar versions of a kernel; pass the
+// first two through CPU_FEATURES_IF_AVX2() and CPU_FEATURES_IF_NEON()
+template <typename Function>
+Kernel<Function> select(Function avx2, Function neon, Function scalar)
+{
+    if (avx2 && hasAvx2()) {
+        return { avx2, "avx2" };
+    }
+    if (neon) {
+        return { neon, "neon" };
+    }
+    return { scalar, "scalar" };
+}
+
+} // namespace CpuFeatures
+
+#endif // CPUFEATURES_H
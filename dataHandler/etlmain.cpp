@@ -0,0 +1,37 @@
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QDebug>
+#include "resamplingetl.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("dataTreatment");
+
+    ResamplingEtl::Config config;
+    config.url = qEnvironmentVariable("INFLUX_URL", "https://eu-central-1-1.aws.cloud2.influxdata.com");
+    config.token = qEnvironmentVariable("INFLUX_TOKEN");
+    config.org = qEnvironmentVariable("INFLUX_ORG", "jetracer");
+    config.bucket = qEnvironmentVariable("INFLUX_BUCKET", "jetracer");
+    config.vehicleId = qEnvironmentVariable("ETL_VEHICLE_ID", "1");
+    config.watermarkPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                           + "/etl_watermarks.json";
+
+    if (config.token.isEmpty()) {
+        qDebug() << "WARNING: Please set your InfluxDB credentials (INFLUX_TOKEN)";
+        return 1;
+    }
+
+    qDebug() << "=== Telemetry Resampling ETL ===";
+    qDebug() << "Source/target bucket:" << config.bucket;
+    qDebug() << "Lookback:" << config.lookbackDays << "days, window:" << config.windowSeconds << "s";
+    qDebug() << "Watermarks:" << config.watermarkPath;
+
+    ResamplingEtl etl(config);
+    QObject::connect(&etl, &ResamplingEtl::finished, &app, [](bool success) {
+        QCoreApplication::exit(success ? 0 : 1);
+    });
+    etl.run();
+
+    return app.exec();
+}
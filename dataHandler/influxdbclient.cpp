@@ -1,33 +1,87 @@
 #include "influxdbclient.h"
+#include "triptelemetrycodec.h"
+#include <QTimeZone>
+#include <QSaveFile>
+#include <QDataStream>
+#ifdef HAVE_ARROW
+#include "arrowtelemetryreader.h"
+#endif
 #include <iostream>
 #include <algorithm>
 #include <limits>
+#include <cmath>
 
-InfluxDBClient::InfluxDBClient(QObject *parent)
+// Dynamic property used to tag each reply with the sequence number of its request
+static const char *REQUEST_SEQUENCE_PROPERTY = "requestSequence";
+
+// Detector checkpoint file, next to the telemetry segments
+static const char *CHECKPOINT_FILE_NAME = "detector.checkpoint";
+static const quint32 CHECKPOINT_MAGIC = 0x54444350; // "TDCP"
+static const quint32 CHECKPOINT_VERSION = 2;
+
+InfluxDBClient::InfluxDBClient(const TripDetectorConfig& detectorConfig, QObject *parent)
     : QObject(parent)
     , m_networkManager(new QNetworkAccessManager(this))
     , m_timer(new QTimer(this))
+    , m_requestSequence(0)
+    , m_pollPending(false)
+    , m_collecting(false)
+    , m_idlePollIntervalMs(POLL_IDLE_MIN_INTERVAL_MS)
+    , m_lastResponseLatencyMs(0)
+    , m_dataArrivalIntervalMs(0)
+    , m_pushIngestEnabled(false)
+    , m_timeoutTimer(new QTimer(this))
+    , m_databaseWriter(nullptr)
+    , m_tripCache(TRIP_CACHE_SIZE)
+    , m_tripWriter(nullptr)
+    , m_republishTimer(new QTimer(this))
+    , m_tripDetector(TripDetector::create(detectorConfig))
     , m_speed(0.0)
-    , m_charge(0.0)
+    , m_charge(std::numeric_limits<double>::quiet_NaN()) // unknown until the first SoC sample
     , m_autonomyLevel(0.0)
-    , m_inTrip(false)
-    , m_nextTripId(0)
+    , m_bufferAnalyzed(false)
+    , m_querySinceMsecs(-1)
+    , m_speedWatermark(-1)
+    , m_chargeWatermark(-1)
 {
     // InfluxDB Cloud configuration - using your actual credentials
     m_url = "https://eu-central-1-1.aws.cloud2.influxdata.com";
     m_token = "rYtXXREgOrb0Kd5DSkA4b--qI9AC1gHvIGfNK90Ne0yGHsIDAYkvyxKzgxDLonwTVhzclF8ZZoVk7R9atXeHbQ==";
     m_org = "jetracer";
     m_bucket = "jetracer";
+    m_speedMeasurement = "Vehicle/1/qt/speed";
+    m_chargeMeasurement = "Vehicle/1/qt/charge";
     
-    // Setup timer for periodic trip analysis
-    m_timer->setInterval(300000); // Analyze every 30 seconds
+    // Setup timer for periodic trip analysis; the interval is chosen after every
+    // response by scheduleNextPoll() depending on trip state and data flow
+    m_timer->setSingleShot(true);
     connect(m_timer, &QTimer::timeout, this, &InfluxDBClient::onTimerTimeout);
     
+    // In push ingest mode nothing polls, so open trips are checked for timeout separately
+    m_timeoutTimer->setInterval(PUSH_TIMEOUT_CHECK_MS);
+    connect(m_timeoutTimer, &QTimer::timeout, this, &InfluxDBClient::onTimeoutCheck);
+    
+    m_republishTimer->setSingleShot(true);
+    m_republishTimer->setInterval(TRIP_REPUBLISH_DELAY_MS);
+    connect(m_republishTimer, &QTimer::timeout, this, &InfluxDBClient::republishTrips);
+    
+    setTripPublishingEnabled(true);
+    
     // Initialize database
     if (!initializeDatabase()) {
         qDebug() << "Warning: Failed to initialize trip database";
     }
     
+    // Start from the telemetry stored by the last run, the first query then
+    // only fetches what came in since
+    const QString telemetryPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/telemetry";
+    if (m_segmentStore.open(telemetryPath)) {
+        loadStoredTelemetry();
+    } else {
+        qDebug() << "Warning: Failed to open telemetry store, every start queries the full range";
+    }
+    
+    qDebug() << "InfluxDBClient: Trip detector" << m_tripDetector->description();
     qDebug() << "InfluxDBClient: Initialized with URL:" << m_url;
     qDebug() << "InfluxDBClient: Using org:" << m_org;
     qDebug() << "InfluxDBClient: Using bucket:" << m_bucket;
@@ -36,19 +90,42 @@ InfluxDBClient::InfluxDBClient(QObject *parent)
 void InfluxDBClient::startDataCollection()
 {
     qDebug() << "InfluxDBClient: Starting trip analysis system...";
-    m_timer->start();
-    // Fetch initial data immediately for trip analysis
+    m_collecting = true;
+    m_idlePollIntervalMs = POLL_IDLE_MIN_INTERVAL_MS;
+    if (m_pushIngestEnabled) {
+        m_timeoutTimer->start();
+    }
+    // Fetch initial data immediately for trip analysis; the next poll is scheduled once it completes
     fetchLatestData();
 }
 
 void InfluxDBClient::stopDataCollection()
 {
     qDebug() << "InfluxDBClient: Stopping data collection...";
+    m_collecting = false;
     m_timer->stop();
+    m_timeoutTimer->stop();
+    m_pollPending = false;
+    saveDetectorCheckpoint(true);
+    
+    if (m_activeReply) {
+        // Invalidate the outstanding request before aborting so its reply is discarded
+        ++m_requestSequence;
+        m_activeReply->abort();
+    }
 }
 
 void InfluxDBClient::fetchLatestData()
 {
+    if (m_activeReply) {
+        // A query is still running: coalesce this tick into one follow-up request
+        if (!m_pollPending) {
+            qDebug() << "InfluxDBClient: Request" << m_requestSequence << "still in flight - deferring poll";
+        }
+        m_pollPending = true;
+        return;
+    }
+    
     qDebug() << "InfluxDBClient: Fetching latest data from InfluxDB...";
     makeInfluxDBRequest();
 }
@@ -58,26 +135,312 @@ void InfluxDBClient::onTimerTimeout()
     fetchLatestData();
 }
 
-void InfluxDBClient::makeInfluxDBRequest()
+void InfluxDBClient::setPushIngestEnabled(bool enabled)
+{
+    m_pushIngestEnabled = enabled;
+    qDebug() << "InfluxDBClient: Push ingest" << (enabled ? "enabled - polling only backfills on start" : "disabled");
+    
+    if (!m_collecting) return;
+    
+    if (enabled) {
+        m_timer->stop();
+        m_timeoutTimer->start();
+    } else {
+        m_timeoutTimer->stop();
+        scheduleNextPoll(false);
+    }
+}
+
+void InfluxDBClient::setTripDetectorConfig(const TripDetectorConfig& config)
+{
+    // The next analysis starts from scratch, IDs continue after the stored rows
+    m_tripDetector = TripDetector::create(config);
+    m_bufferAnalyzed = false;
+    qDebug() << "InfluxDBClient: Trip detector" << m_tripDetector->description();
+}
+
+void InfluxDBClient::setTripPublishingEnabled(bool enabled)
 {
-    // Flux query to get both vehicle speed and battery charge data for comprehensive trip analysis
-    QString fluxQuery = QString(
-        "from(bucket: \"%1\")"
-        " |> range(start: -10d)"
-        " |> filter(fn: (r) => r[\"_measurement\"] == \"Vehicle/1/qt/speed\" or r[\"_measurement\"] == \"Vehicle/1/qt/charge\")"
-        " |> sort(columns: [\"_time\"])"  // Sort by time to ensure chronological order
-        " |> yield(name: \"vehicle_data\")"
-    ).arg(m_bucket);
+    if (enabled == (m_tripWriter != nullptr)) return;
+    
+    if (!enabled) {
+        m_tripWriter->flush();
+        m_tripWriter->deleteLater();
+        m_tripWriter = nullptr;
+        m_republishTimer->stop();
+        m_unpublishedTripIds.clear();
+        return;
+    }
+    
+    LineProtocolWriter::Config config;
+    config.url = m_url;
+    config.token = m_token;
+    config.org = m_org;
+    config.bucket = m_bucket;
+    config.precision = "s";
+    m_tripWriter = new LineProtocolWriter(config, this);
+    connect(m_tripWriter, &LineProtocolWriter::batchFailed, this,
+            [this](const QString& error, int lines, const QList<qint64>& keys) {
+        qDebug() << "InfluxDBClient: Failed to publish" << lines << "trips, retrying in"
+                 << int(TRIP_REPUBLISH_DELAY_MS) / 1000 << "s:" << error;
+        // Trips end only once, nothing else would write them again
+        for (qint64 tripId : keys) {
+            m_publishedTripEnds.remove(int(tripId));
+            m_unpublishedTripIds.insert(int(tripId));
+        }
+        if (!m_unpublishedTripIds.isEmpty() && !m_republishTimer->isActive()) {
+            m_republishTimer->start();
+        }
+    });
+}
 
-    qDebug() << "InfluxDBClient: Fetching Vehicle/1/qt/speed and Vehicle/1/qt/charge data for trip analysis (last 24h):" << fluxQuery;
+void InfluxDBClient::republishTrips()
+{
+    const QSet<int> tripIds = m_unpublishedTripIds;
+    m_unpublishedTripIds.clear();
+    
+    for (int tripId : tripIds) {
+        // The detector has the trip unless it was analyzed again since, the
+        // database has it in any case
+        TripInfo trip;
+        bool found = false;
+        for (const TripInfo& detected : m_tripDetector->trips()) {
+            if (detected.tripId == tripId && detected.endTime.isValid()) {
+                trip = detected;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            found = loadTripFromDatabase(tripId, trip);
+        }
+        if (!found) {
+            qDebug() << "InfluxDBClient: Trip" << tripId << "is gone, not republishing it";
+            continue;
+        }
+        publishTrip(trip);
+    }
+}
+
+void InfluxDBClient::publishTrip(const TripInfo& trip)
+{
+    if (!m_tripWriter) return;
+    
+    // A full re-analysis ends the stored trips again, only write what changed
+    if (m_publishedTripEnds.value(trip.tripId) == trip.endTime) return;
+    
+    LineProtocolPoint point("trips", trip.startTime.toSecsSinceEpoch());
+    point.tag("vehicle", m_speedMeasurement.section('/', 1, 1))
+         .tag("trip_id", QString::number(trip.tripId))
+         .field("end_time", trip.endTime.toSecsSinceEpoch())
+         .field("duration_seconds", trip.durationSeconds)
+         .field("max_speed", trip.maxSpeed)
+         .field("average_speed", trip.averageSpeed)
+         .field("distance_km", trip.distanceTraveled)
+         .field("start_battery_charge", trip.startBatteryCharge)
+         .field("end_battery_charge", trip.endBatteryCharge)
+         .field("battery_used_percent", trip.batteryUsedPercent)
+         .field("energy_consumed_wh", trip.energyConsumedWh)
+         .field("energy_efficiency_whkm", trip.energyEfficiencyWhKm)
+         .field("energy_confidence_wh", trip.energyConfidenceWh)
+         .field("data_points", qint64(trip.dataPointCount()))
+         .field("trip_name", trip.getFormattedTripName())
+         .field("driver_name", trip.driverName);
+    
+    // The trip id comes back with batchFailed() if the write is dropped
+    if (m_tripWriter->write(point, trip.tripId)) {
+        m_publishedTripEnds.insert(trip.tripId, trip.endTime);
+    } else {
+        qDebug() << "InfluxDBClient: Trip writer queue full, retrying trip" << trip.tripId << "later";
+        m_unpublishedTripIds.insert(trip.tripId);
+        if (!m_republishTimer->isActive()) {
+            m_republishTimer->start();
+        }
+    }
+}
 
+void InfluxDBClient::ingestSamples(const QList<TelemetrySample>& samples)
+{
+    // Keep only this vehicle's series, in time order
+    QList<TelemetrySample> accepted;
+    accepted.reserve(samples.size());
+    for (const TelemetrySample& sample : samples) {
+        if (sample.measurement == m_speedMeasurement || sample.measurement == m_chargeMeasurement) {
+            accepted.append(sample);
+        }
+    }
+    if (accepted.isEmpty()) return;
+    
+    std::stable_sort(accepted.begin(), accepted.end(),
+                     [](const TelemetrySample& a, const TelemetrySample& b) { return a.timestamp < b.timestamp; });
+    
+    int dropped = 0;
+    for (const TelemetrySample& sample : accepted) {
+        // The detector only moves forward in time, late samples cannot be replayed
+        if (!m_dataBuffer.isEmpty() && sample.timestamp.toMSecsSinceEpoch() < m_dataBuffer.lastMsecs()) {
+            dropped++;
+            continue;
+        }
+        
+        // Carry the other series forward, like the merge of polled data does
+        if (sample.measurement == m_speedMeasurement) {
+            addDataPoint(sample.timestamp, sample.value, m_charge);
+            m_speedWatermark = sample.timestamp.toMSecsSinceEpoch();
+        } else {
+            addDataPoint(sample.timestamp, m_speed, sample.value);
+            m_chargeWatermark = sample.timestamp.toMSecsSinceEpoch();
+        }
+        if (m_bufferAnalyzed) {
+            m_tripDetector->processPoint(m_dataBuffer.last());
+        }
+    }
+    
+    if (dropped > 0) {
+        qDebug() << "InfluxDBClient: Dropped" << dropped << "out-of-order pushed samples";
+    }
+    
+    if (!m_bufferAnalyzed) {
+        // Stored history not analyzed yet (no backfill so far): catch up at once
+        analyzeBuffer();
+    } else {
+        handleDetectorEvents();
+    }
+    trimDataBuffer();
+    m_segmentStore.setSeriesWatermarks(m_speedWatermark, m_chargeWatermark);
+    m_segmentStore.flush();
+    saveDetectorCheckpoint();
+}
+
+void InfluxDBClient::onTimeoutCheck()
+{
+    if (m_tripDetector->checkTimeout(QDateTime::currentDateTime())) {
+        handleDetectorEvents();
+    }
+}
+
+void InfluxDBClient::trimDataBuffer()
+{
+    if (m_dataBuffer.isEmpty()) return;
+    
+    // Whole blocks only, up to one block more than the retention stays
+    const qint64 retentionMsecs = qint64(DATA_RETENTION_DAYS) * 24 * 60 * 60 * 1000;
+    m_dataBuffer.removeBefore(m_dataBuffer.lastMsecs() - retentionMsecs);
+    // Whole segments on disk, the load on the next start trims the rest
+    m_segmentStore.removeBefore(m_dataBuffer.lastMsecs() - retentionMsecs);
+}
+
+void InfluxDBClient::loadStoredTelemetry()
+{
+    const qint64 watermark = m_segmentStore.highWatermark();
+    if (watermark < 0) return;
+    
+    const qint64 retentionMsecs = qint64(DATA_RETENTION_DAYS) * 24 * 60 * 60 * 1000;
+    m_dataBuffer.clear();
+    m_segmentStore.load(m_dataBuffer, watermark - retentionMsecs);
+    if (m_dataBuffer.isEmpty()) return;
+    
+    // Carried forward into the first incremental query
+    const VehicleDataPoint newest = m_dataBuffer.last();
+    m_speed = newest.speed;
+    m_charge = newest.batteryCharge;
+    m_speedWatermark = m_segmentStore.speedWatermark();
+    m_chargeWatermark = m_segmentStore.chargeWatermark();
+    m_bufferAnalyzed = false;
+    
+    qDebug() << "InfluxDBClient: Loaded" << m_dataBuffer.size() << "stored points up to"
+             << newest.timestamp.toString() << "(speed up to" << m_speedWatermark
+             << "ms, charge up to" << m_chargeWatermark << "ms)";
+}
+
+void InfluxDBClient::setArrowQueryUrl(const QString& url)
+{
+#ifdef HAVE_ARROW
+    m_arrowQueryUrl = url;
+#else
+    if (!url.isEmpty()) {
+        qDebug() << "InfluxDBClient: Built without Arrow, ignoring Arrow query URL" << url;
+    }
+#endif
+}
+
+void InfluxDBClient::makeInfluxDBRequest()
+{
     QNetworkRequest request;
-    request.setUrl(QUrl(m_url + "/api/v2/query?org=" + m_org));
+    QByteArray body;
+    
+    // With history in hand each series is only asked for after its own newest
+    // sample, never more than the retention; a series that lags the other
+    // still gets the points it is missing
+    m_querySinceMsecs = -1;
+    QString speedSince;
+    QString chargeSince;
+    if (!m_dataBuffer.isEmpty()) {
+        const qint64 retentionMsecs = qint64(DATA_RETENTION_DAYS) * 24 * 60 * 60 * 1000;
+        const qint64 oldestMsecs = QDateTime::currentMSecsSinceEpoch() - retentionMsecs;
+        const qint64 speedFrom = qMax(m_speedWatermark + 1, oldestMsecs);
+        const qint64 chargeFrom = qMax(m_chargeWatermark + 1, oldestMsecs);
+        m_querySinceMsecs = qMin(speedFrom, chargeFrom);
+        speedSince = QDateTime::fromMSecsSinceEpoch(speedFrom, QTimeZone::UTC).toString(Qt::ISODateWithMs);
+        chargeSince = QDateTime::fromMSecsSinceEpoch(chargeFrom, QTimeZone::UTC).toString(Qt::ISODateWithMs);
+    }
+    
+    if (m_arrowQueryUrl.isEmpty()) {
+        // Flux query to get both vehicle speed and battery charge data for comprehensive trip analysis
+        const QString fullRange = QString("-%1d").arg(DATA_RETENTION_DAYS);
+        QString fluxQuery = QString(
+            "speed = from(bucket: \"%1\")"
+            " |> range(start: %2)"
+            " |> filter(fn: (r) => r[\"_measurement\"] == \"%3\")\n"
+            "charge = from(bucket: \"%1\")"
+            " |> range(start: %4)"
+            " |> filter(fn: (r) => r[\"_measurement\"] == \"%5\")\n"
+            "union(tables: [speed, charge])"
+            " |> sort(columns: [\"_time\"])"  // Sort by time to ensure chronological order
+            " |> yield(name: \"vehicle_data\")"
+        ).arg(m_bucket, speedSince.isEmpty() ? fullRange : speedSince, m_speedMeasurement,
+              chargeSince.isEmpty() ? fullRange : chargeSince, m_chargeMeasurement);
+
+        qDebug() << "InfluxDBClient: Fetching" << m_speedMeasurement << "and" << m_chargeMeasurement
+                 << "data for trip analysis (since" << (speedSince.isEmpty() ? QString("%1 days").arg(DATA_RETENTION_DAYS)
+                                                                             : speedSince + " / " + chargeSince)
+                 << "):" << fluxQuery;
+
+        request.setUrl(QUrl(m_url + "/api/v2/query?org=" + m_org));
+        request.setRawHeader("Content-Type", "application/vnd.flux");
+        request.setRawHeader("Accept", "application/csv");
+        body = fluxQuery.toUtf8();
+    } else {
+        // SQL against the v3 engine; each measurement is a table, tagged with its
+        // TelemetryColumns::Series id and ordered so every series arrives as one run
+        const QString fullRange = QString("now() - INTERVAL '%1 days'").arg(DATA_RETENTION_DAYS);
+        QString sqlQuery = QString(
+            "SELECT %1 AS series, time, value FROM \"%3\" WHERE time >= %5"
+            " UNION ALL "
+            "SELECT %2 AS series, time, value FROM \"%4\" WHERE time >= %6"
+            " ORDER BY series, time"
+        ).arg(int(TelemetryColumns::Speed)).arg(int(TelemetryColumns::Charge))
+         .arg(m_speedMeasurement, m_chargeMeasurement,
+              speedSince.isEmpty() ? fullRange : QString("'%1'").arg(speedSince),
+              chargeSince.isEmpty() ? fullRange : QString("'%1'").arg(chargeSince));
+
+        qDebug() << "InfluxDBClient: Fetching Arrow record batches from" << m_arrowQueryUrl << ":" << sqlQuery;
+
+        QJsonObject query;
+        query["db"] = m_bucket;
+        query["q"] = sqlQuery;
+        request.setUrl(QUrl(m_arrowQueryUrl));
+        request.setRawHeader("Content-Type", "application/json");
+        request.setRawHeader("Accept", "application/vnd.apache.arrow.stream");
+        body = QJsonDocument(query).toJson(QJsonDocument::Compact);
+    }
+    
     request.setRawHeader("Authorization", QString("Token %1").arg(m_token).toUtf8());
-    request.setRawHeader("Content-Type", "application/vnd.flux");
-    request.setRawHeader("Accept", "application/csv");
+    request.setTransferTimeout(REQUEST_TIMEOUT_MS);
 
-    QNetworkReply *reply = m_networkManager->post(request, fluxQuery.toUtf8());
+    QNetworkReply *reply = m_networkManager->post(request, body);
+    reply->setProperty(REQUEST_SEQUENCE_PROPERTY, ++m_requestSequence);
+    m_activeReply = reply;
+    m_requestTimer.start();
     
     connect(reply, &QNetworkReply::finished, this, &InfluxDBClient::onDataReceived);
     connect(reply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::errorOccurred),
@@ -88,22 +451,130 @@ void InfluxDBClient::onDataReceived()
 {
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
     if (!reply) return;
+    
+    if (reply == m_activeReply) {
+        m_activeReply = nullptr;
+    }
+    
+    // Drop replies that were superseded or cancelled while in flight
+    quint64 sequence = reply->property(REQUEST_SEQUENCE_PROPERTY).toULongLong();
+    if (sequence != m_requestSequence) {
+        qDebug() << "InfluxDBClient: Discarding stale response for request" << sequence
+                 << "(latest is" << m_requestSequence << ")";
+        reply->deleteLater();
+        return;
+    }
+
+    m_lastResponseLatencyMs = m_requestTimer.elapsed();
 
     QByteArray data = reply->readAll();
-    qDebug() << "InfluxDBClient: Received" << data.size() << "bytes";
-    qDebug() << "InfluxDBClient: Full response data:" << QString(data);
+    qDebug() << "InfluxDBClient: Received" << data.size() << "bytes in" << m_lastResponseLatencyMs << "ms";
     
+    bool receivedNewData = false;
     if (reply->error() == QNetworkReply::NoError) {
         // Check HTTP status code
         int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
         qDebug() << "InfluxDBClient: HTTP status code:" << statusCode;
         
-        parseInfluxDBResponse(data);
+        if (m_arrowQueryUrl.isEmpty()) {
+            qDebug() << "InfluxDBClient: Full response data:" << QString(data);
+            parseInfluxDBResponse(data);
+        } else {
+            parseArrowResponse(data);
+        }
+        
+        // Track whether the newest sample moved forward since the last poll
+        if (!m_dataBuffer.isEmpty() && m_dataBuffer.last().timestamp > m_newestDataTime) {
+            receivedNewData = true;
+            updateDataArrivalInterval(m_newestDataTime);
+            m_newestDataTime = m_dataBuffer.last().timestamp;
+        }
+        // An incremental query with nothing new still has to end stale trips
+        if (!receivedNewData) {
+            onTimeoutCheck();
+        }
     } else {
         qDebug() << "InfluxDBClient: HTTP Error:" << reply->errorString();
     }
 
     reply->deleteLater();
+    
+    // Run the single follow-up for any ticks that arrived while this request was active
+    if (m_pollPending) {
+        m_pollPending = false;
+        fetchLatestData();
+        return;
+    }
+    
+    scheduleNextPoll(receivedNewData);
+}
+
+bool InfluxDBClient::hasPendingTripActivity() const
+{
+    return m_tripDetector->inTrip()
+        || !m_tripDetector->potentialTripStart().isNull()
+        || !m_tripDetector->potentialTripEnd().isNull();
+}
+
+void InfluxDBClient::scheduleNextPoll(bool receivedNewData)
+{
+    if (!m_collecting || m_pushIngestEnabled) return;
+    
+    qint64 interval;
+    if (hasPendingTripActivity()) {
+        // Driving, or a start/end is being confirmed: poll fast and restart the idle back-off
+        interval = POLL_ACTIVE_INTERVAL_MS;
+        m_idlePollIntervalMs = POLL_IDLE_MIN_INTERVAL_MS;
+    } else if (receivedNewData) {
+        // Parked but data is still flowing, the vehicle may start moving soon
+        interval = POLL_IDLE_MIN_INTERVAL_MS;
+        m_idlePollIntervalMs = POLL_IDLE_MIN_INTERVAL_MS;
+    } else {
+        // Nothing new: back off exponentially up to the cap
+        interval = m_idlePollIntervalMs;
+        m_idlePollIntervalMs = qMin(m_idlePollIntervalMs * 2, int(POLL_IDLE_MAX_INTERVAL_MS));
+    }
+    
+    // Polling much faster than samples are produced only returns empty replies;
+    // during trip activity the fast interval always wins
+    if (m_dataArrivalIntervalMs > 0 && !hasPendingTripActivity()) {
+        interval = qMax(interval, m_dataArrivalIntervalMs / 2);
+    }
+    // Leave the backend room to answer when it is slow
+    interval = qMax(interval, m_lastResponseLatencyMs * POLL_LATENCY_FACTOR);
+    interval = qMin(interval, qint64(POLL_IDLE_MAX_INTERVAL_MS));
+    
+    qDebug() << "InfluxDBClient: Next poll in" << interval << "ms"
+             << "(trip activity:" << hasPendingTripActivity()
+             << "new data:" << receivedNewData
+             << "latency:" << m_lastResponseLatencyMs << "ms"
+             << "arrival interval:" << m_dataArrivalIntervalMs << "ms)";
+    m_timer->start(int(interval));
+}
+
+void InfluxDBClient::updateDataArrivalInterval(const QDateTime& since)
+{
+    // Sample times, not poll times: those would feed the poll interval back
+    // into the estimate. The median gap ignores the pauses while parked; only
+    // the last few minutes are decoded
+    const qint64 newest = m_dataBuffer.lastMsecs();
+    qint64 from = newest - POLL_IDLE_MAX_INTERVAL_MS;
+    if (!since.isNull()) {
+        from = qMax(from, since.toMSecsSinceEpoch() + 1);
+    }
+    const QList<VehicleDataPoint> points = m_dataBuffer.pointsBetween(from, newest);
+    const qsizetype first = qMax(qsizetype(0), points.size() - ARRIVAL_SAMPLE_POINTS);
+    QList<qint64> gaps;
+    for (qsizetype i = first + 1; i < points.size(); ++i) {
+        gaps.append(points[i - 1].timestamp.msecsTo(points[i].timestamp));
+    }
+    if (gaps.isEmpty()) return;
+    
+    std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+    const qint64 gap = gaps[gaps.size() / 2];
+    m_dataArrivalIntervalMs = m_dataArrivalIntervalMs == 0
+        ? gap
+        : (3 * m_dataArrivalIntervalMs + gap) / 4;
 }
 
 void InfluxDBClient::onNetworkError(QNetworkReply::NetworkError error)
@@ -149,14 +620,9 @@ void InfluxDBClient::parseInfluxDBResponse(const QByteArray &data)
         return;
     }
     
-    // Clear existing buffer
-    m_dataBuffer.clear();
-    
-    // Separate parsing: Speed and battery measurements have different timestamps
-    QMap<QDateTime, double> speedData;
-    QMap<QDateTime, double> batteryData;
+    // Speed and battery measurements have different timestamps, collect them column-wise
+    TelemetryColumns columns;
     
-    // First pass: Parse all data and separate speed/battery by timestamp
     for (int i = 1; i < lines.size(); i++) {
         QStringList fields = lines[i].split(',');
         if (fields.size() <= qMax(qMax(valueIndex, timeIndex), measurementIndex)) continue;
@@ -173,74 +639,76 @@ void InfluxDBClient::parseInfluxDBResponse(const QByteArray &data)
             QDateTime timestamp = QDateTime::fromString(timeStr, Qt::ISODate);
             if (timestamp.isValid()) {
                 // Debug: Show first few raw measurements
-                if (speedData.size() + batteryData.size() < 5) {
+                if (columns.speed.size() + columns.charge.size() < 5) {
                     qDebug() << "Raw measurement:" << measurement << "Value:" << value << "Time:" << timeStr;
                 }
                 
                 // Store values separately by measurement type
-                if (measurement == "Vehicle/1/qt/speed") {
-                    speedData[timestamp] = value;
-                    if (speedData.size() <= 3) {
-                        qDebug() << "Speed data:" << timestamp.toString() << "=" << value;
-                    }
-                } else if (measurement == "Vehicle/1/qt/charge") {
-                    batteryData[timestamp] = value;
-                    if (batteryData.size() <= 3) {
-                        qDebug() << "Battery data:" << timestamp.toString() << "=" << value;
-                    }
+                if (measurement == m_speedMeasurement) {
+                    columns.speed.append(timestamp.toMSecsSinceEpoch(), value);
+                } else if (measurement == m_chargeMeasurement) {
+                    columns.charge.append(timestamp.toMSecsSinceEpoch(), value);
                 }
             } else {
                 // Debug: Show invalid timestamps
-                if (speedData.size() + batteryData.size() < 3) {
+                if (columns.speed.size() + columns.charge.size() < 3) {
                     qDebug() << "Invalid timestamp:" << timeStr << "for measurement:" << measurement;
                 }
             }
         } else {
             // Debug: Show invalid values
-            if (speedData.size() + batteryData.size() < 3) {
+            if (columns.speed.size() + columns.charge.size() < 3) {
                 qDebug() << "Invalid value:" << valueStr << "for measurement:" << measurement;
             }
         }
     }
     
-    qDebug() << "Parsed" << speedData.size() << "speed points and" << batteryData.size() << "battery points";
+    processColumns(columns);
+}
+
+void InfluxDBClient::parseArrowResponse(const QByteArray &data)
+{
+#ifdef HAVE_ARROW
+    qDebug() << "=== TRIP ANALYSIS - PROCESSING ARROW DATA ===";
     
-    // Second pass: Create combined timeline with interpolated values
-    QSet<QDateTime> allTimestamps;
-    for (auto it = speedData.begin(); it != speedData.end(); ++it) {
-        allTimestamps.insert(it.key());
-    }
-    for (auto it = batteryData.begin(); it != batteryData.end(); ++it) {
-        allTimestamps.insert(it.key());
+    // Time and value buffers are copied column-wise, nothing is parsed from text
+    TelemetryColumns columns;
+    if (!ArrowTelemetryReader::read(data, columns)) {
+        qDebug() << "No vehicle data decoded for trip analysis";
+        return;
     }
+    processColumns(columns);
+#else
+    Q_UNUSED(data);
+#endif
+}
+
+void InfluxDBClient::processColumns(TelemetryColumns& columns)
+{
+    qDebug() << "Parsed" << columns.speed.size() << "speed points and" << columns.charge.size() << "battery points";
     
-    // Convert to list and sort chronologically
-    QList<QDateTime> sortedTimestamps = allTimestamps.values();
-    std::sort(sortedTimestamps.begin(), sortedTimestamps.end());
-    
-    // Third pass: Create data points with interpolated values
-    double lastKnownSpeed = 0.0;
-    double lastKnownBattery = 0.0;
+    const bool incremental = m_querySinceMsecs >= 0 && !m_dataBuffer.isEmpty();
+    if (!incremental) {
+        m_speedWatermark = -1;
+        m_chargeWatermark = -1;
+    }
+    columns.alignSeries(m_speedWatermark, m_chargeWatermark, SERIES_LAG_GRACE_MS);
+    if (incremental) {
+        appendColumns(columns);
+        return;
+    }
     
-    for (const QDateTime& timestamp : sortedTimestamps) {
-        double currentSpeed = lastKnownSpeed;  // Default to last known
-        double currentBattery = lastKnownBattery;  // Default to last known
-        
-        // Use actual values if available at this timestamp
-        if (speedData.contains(timestamp)) {
-            currentSpeed = speedData[timestamp];
-            lastKnownSpeed = currentSpeed;
-        }
-        if (batteryData.contains(timestamp)) {
-            currentBattery = batteryData[timestamp];
-            lastKnownBattery = currentBattery;
-        }
-        
-        // Add the data point with both values
-        addDataPoint(timestamp, currentSpeed, currentBattery);
+    // Merge both series onto one timeline, carrying the last known value of each forward
+    m_dataBuffer.clear();
+    m_segmentStore.clear();
+    const QList<VehicleDataPoint> points = columns.toDataPoints();
+    for (const VehicleDataPoint& point : points) {
+        addDataPoint(point.timestamp, point.speed, point.batteryCharge);
     }
+    advanceSeriesWatermarks(columns);
     
-    qDebug() << "Processed" << m_dataBuffer.size() << "data points for trip analysis";
+    qDebug() << "Processed" << m_dataBuffer.size() << "data points for trip analysis,"
+             << m_dataBuffer.compressedBytes() / 1024 << "KiB compressed";
     
     // Debug: Show first and last timestamps to confirm chronological order
     if (!m_dataBuffer.isEmpty()) {
@@ -254,253 +722,307 @@ void InfluxDBClient::parseInfluxDBResponse(const QByteArray &data)
     }
     
     // Clear previous trip state for fresh analysis
-    m_detectedTrips.clear();
-    m_inTrip = false;
-    m_nextTripId = 1;
-    m_potentialTripStart = QDateTime();
-    m_potentialTripEnd = QDateTime();
+    resetTripDetector();
     
     // Analyze for trips
     analyzeForTrips();
+    m_segmentStore.flush();
+    saveDetectorCheckpoint(true);
     
     // Print current trip summary
     printTripSummary();
 }
 
+void InfluxDBClient::appendColumns(TelemetryColumns& columns)
+{
+    // Continues the buffered timeline: the detector keeps its state and only
+    // sees the new points, unless it still has to analyze the buffer
+    const qint64 lastMsecs = m_dataBuffer.lastMsecs();
+    const QList<VehicleDataPoint> points = columns.toDataPoints(m_speed, m_charge);
+    QList<VehicleDataPoint> newPoints;
+    newPoints.reserve(points.size());
+    int late = 0;
+    for (const VehicleDataPoint& point : points) {
+        // Samples of a series that lagged longer than the grace; their values
+        // are still carried into the next point
+        if (point.timestamp.toMSecsSinceEpoch() <= lastMsecs) {
+            late++;
+            continue;
+        }
+        addDataPoint(point.timestamp, point.speed, point.batteryCharge);
+        newPoints.append(point);
+    }
+    advanceSeriesWatermarks(columns);
+    
+    qDebug() << "Appended" << newPoints.size() << "new data points," << m_dataBuffer.size() << "buffered,"
+             << m_dataBuffer.compressedBytes() / 1024 << "KiB compressed";
+    if (late > 0) {
+        qDebug() << "InfluxDBClient: Dropped" << late << "samples older than the buffered timeline";
+    }
+    
+    if (!m_bufferAnalyzed) {
+        analyzeBuffer();
+    } else {
+        if (!newPoints.isEmpty()) {
+            m_tripDetector->processPoints(newPoints);
+        }
+        m_tripDetector->checkTimeout(QDateTime::currentDateTime());
+        handleDetectorEvents();
+    }
+    trimDataBuffer();
+    m_segmentStore.flush();
+    saveDetectorCheckpoint();
+    
+    printTripSummary();
+}
+
+void InfluxDBClient::advanceSeriesWatermarks(const TelemetryColumns& columns)
+{
+    if (!columns.speed.isEmpty()) {
+        m_speedWatermark = qMax(m_speedWatermark, columns.speed.timestamps.last());
+    }
+    if (!columns.charge.isEmpty()) {
+        m_chargeWatermark = qMax(m_chargeWatermark, columns.charge.timestamps.last());
+    }
+    m_segmentStore.setSeriesWatermarks(m_speedWatermark, m_chargeWatermark);
+}
+
 void InfluxDBClient::addDataPoint(const QDateTime& timestamp, double speed, double batteryCharge)
 {
-    m_dataBuffer.append(VehicleDataPoint(timestamp, speed, batteryCharge));
+    m_dataBuffer.append(timestamp.toMSecsSinceEpoch(), speed, batteryCharge);
+    m_segmentStore.append(timestamp.toMSecsSinceEpoch(), speed, batteryCharge);
     m_speed = speed; // Update current speed
     m_charge = batteryCharge; // Update current battery charge
 }
 
-void InfluxDBClient::analyzeForTrips()
+void InfluxDBClient::analyzeForTrips(qint64 afterMsecs)
 {
-    if (m_dataBuffer.size() < 2) return;
+    // Callers reset or restore the detector first
+    m_bufferAnalyzed = true;
+    if (m_dataBuffer.isEmpty() || (afterMsecs < 0 && m_dataBuffer.size() < 2)) return;
     
     qDebug() << "=== ANALYZING FOR TRIPS ===";
+    qDebug() << "Processing data from oldest to newest:";
     
-    // Check for trip timeout first (show debug info always)
-    if (!m_dataBuffer.isEmpty()) {
-        QDateTime currentTime = QDateTime::currentDateTime();
-        QDateTime lastDataTime = m_dataBuffer.last().timestamp;
-        qint64 timeSinceLastData = lastDataTime.secsTo(currentTime);
-        
-        qDebug() << "=== TIMEOUT CHECK ===";
-        qDebug() << "Current time:" << currentTime.toString();
-        qDebug() << "Last data time:" << lastDataTime.toString();
-        qDebug() << "Time since last data:" << timeSinceLastData << "seconds (" << (timeSinceLastData/60.0) << "minutes)";
-        qDebug() << "Timeout threshold:" << TRIP_TIMEOUT_SECONDS << "seconds (" << (TRIP_TIMEOUT_SECONDS/60.0) << "minutes)";
-        qDebug() << "Currently in trip:" << m_inTrip;
-        
-        if (timeSinceLastData >= TRIP_TIMEOUT_SECONDS) {
-            // Check if we should force a trip end due to timeout
-            bool shouldForceEnd = false;
-            
-            if (m_inTrip) {
-                // Currently in trip - definitely timeout
-                shouldForceEnd = true;
-                qDebug() << "Timeout condition: Currently in trip, forcing end";
-            } else if (!m_detectedTrips.isEmpty()) {
-                const TripInfo& lastTrip = m_detectedTrips.last();
-                if (lastTrip.endTime.isNull()) {
-                    // Last trip has no end time - should be ongoing
-                    shouldForceEnd = true;
-                    qDebug() << "Timeout condition: Last trip has no end time, forcing end";
-                }
-            }
-            
-            if (shouldForceEnd) {
-                // Force trip end due to timeout
-                if (!m_detectedTrips.isEmpty()) {
-                    TripInfo& currentTrip = m_detectedTrips.last();
-                    currentTrip.endTime = lastDataTime; // Use last data time as trip end
-                    currentTrip.calculateStatistics();
-                    
-                    qDebug() << "*** TRIP" << currentTrip.tripId << "FORCE ENDED due to 5-minute timeout ***";
-                    qDebug() << "Last data received at:" << lastDataTime.toString();
-                    qDebug() << "Trip duration:" << currentTrip.getFormattedDuration();
-                    qDebug() << "Max speed:" << currentTrip.maxSpeed << "m/s";
-                    qDebug() << "Average speed:" << currentTrip.averageSpeed << "m/s";
-                    qDebug() << "Distance traveled:" << currentTrip.getFormattedDistance();
-                    
-                    // Save trip to database
-                    saveTripToDatabase(currentTrip);
-                    
-                    emit tripEnded(currentTrip.tripId, currentTrip.endTime, currentTrip.maxSpeed, 
-                                 currentTrip.averageSpeed, currentTrip.distanceTraveled, currentTrip.durationSeconds);
-                    emit tripsUpdated(); // Notify QML of new trip
-                }
-                
-                m_inTrip = false;
-                m_potentialTripEnd = QDateTime();
-                return; // Exit early since we've ended the trip
-            }
+    // Debug: Show the processing range
+    const VehicleDataPoint oldest = m_dataBuffer.first();
+    const VehicleDataPoint newest = m_dataBuffer.last();
+    qDebug() << "Processing" << m_dataBuffer.size() << "points from" << oldest.timestamp.toString()
+             << "Speed:" << oldest.speed << "Battery:" << oldest.batteryCharge << "%"
+             << "to" << newest.timestamp.toString()
+             << "Speed:" << newest.speed << "Battery:" << newest.batteryCharge << "%";
+    
+    // Decoded a run of blocks at a time, the detector carries its state over
+    // between batches; each batch is still large enough to split across threads
+    const int blockCount = m_dataBuffer.blockCount();
+    int firstBlock = 0;
+    while (firstBlock < blockCount && m_dataBuffer.summary(firstBlock).lastMsecs <= afterMsecs) {
+        ++firstBlock;
+    }
+    for (int block = firstBlock; block < blockCount; block += ANALYSIS_BATCH_BLOCKS) {
+        const int endBlock = qMin(blockCount, block + int(ANALYSIS_BATCH_BLOCKS));
+        QList<VehicleDataPoint> points = m_dataBuffer.toDataPoints(block, endBlock);
+        if (block == firstBlock && afterMsecs >= 0) {
+            // The first block may straddle the checkpoint
+            const auto firstNew = std::find_if(points.begin(), points.end(), [afterMsecs](const VehicleDataPoint& point) {
+                return point.timestamp.toMSecsSinceEpoch() > afterMsecs;
+            });
+            points.erase(points.begin(), firstNew);
+        }
+        if (!points.isEmpty()) {
+            m_tripDetector->processPoints(points);
         }
     }
     
-    qDebug() << "Processing data from oldest to newest:";
+    // Force-end a trip that is still open if data stopped arriving
+    m_tripDetector->checkTimeout(QDateTime::currentDateTime());
     
-    for (int i = 0; i < m_dataBuffer.size(); i++) {
-        const VehicleDataPoint& point = m_dataBuffer[i];
-        
-        // Debug: Show processing order for first few and last few points
-        if (i < 3 || i >= m_dataBuffer.size() - 3) {
-            qDebug() << "Processing point" << i << ":" << point.timestamp.toString() 
-                     << "Speed:" << point.speed << "Battery:" << point.batteryCharge << "%";
+    handleDetectorEvents();
+}
+
+void InfluxDBClient::analyzeBuffer()
+{
+    const qint64 resumeAfterMsecs = restoreDetectorCheckpoint();
+    if (resumeAfterMsecs < 0) {
+        resetTripDetector();
+    } else {
+        qDebug() << "InfluxDBClient: Resuming trip detection after"
+                 << QDateTime::fromMSecsSinceEpoch(resumeAfterMsecs, QTimeZone::UTC).toString();
+    }
+    analyzeForTrips(resumeAfterMsecs);
+}
+
+void InfluxDBClient::resetTripDetector()
+{
+    // TripDetector::reset() restarts the sessions too, seed them after it
+    m_tripDetector->reset(m_storedTrips.id + 1);
+    m_tripDetector->sessions().reset(m_storedChargingSessions.id + 1, m_storedParkingSessions.id + 1);
+}
+
+void InfluxDBClient::loadStoredHeads()
+{
+    // IDs only grow, so the highest one is also the newest row
+    const auto load = [this](const QString& table, const QString& idColumn, StoredHead& head) {
+        QSqlQuery query(m_database);
+        if (!query.exec(QString("SELECT %1, end_time FROM %2 ORDER BY %1 DESC LIMIT 1").arg(idColumn, table))) {
+            qDebug() << "Failed to read the newest row of" << table << ":" << query.lastError().text();
+            return;
         }
-        
-        if (!m_inTrip) {
-            // Looking for trip start
-            if (isMoving(point.speed)) {
-                if (m_potentialTripStart.isNull()) {
-                    m_potentialTripStart = point.timestamp;
-                    qDebug() << "Potential trip start detected at:" << m_potentialTripStart.toString();
-                } else {
-                    // Check if we've been moving for at least 1 minute
-                    qint64 movingDuration = m_potentialTripStart.secsTo(point.timestamp);
-                    if (movingDuration >= TRIP_START_DURATION_SECONDS) {
-                        // Trip confirmed!
-                        m_inTrip = true;
-                        
-                        TripInfo newTrip;
-                        newTrip.tripId = m_nextTripId++;
-                        newTrip.startTime = m_potentialTripStart;
-                        
-                        // Find battery charge at trip start time
-                        newTrip.startBatteryCharge = getBatteryChargeAtTime(m_potentialTripStart);
-                        
-                        m_detectedTrips.append(newTrip);
-                        
-                        qDebug() << "*** TRIP" << newTrip.tripId << "STARTED at" << newTrip.startTime.toString() << "***";
-                        qDebug() << "Driver:" << newTrip.driverName;
-                        qDebug() << "Notes:" << newTrip.notes;
-                        qDebug() << "Start battery charge:" << newTrip.startBatteryCharge << "%";
-                        emit tripStarted(newTrip.tripId, newTrip.startTime);
-                        
-                        m_potentialTripStart = QDateTime();
-                    }
-                }
-                m_lastMovementTime = point.timestamp;
-            } else {
-                // Reset potential trip start if speed goes to zero
-                m_potentialTripStart = QDateTime();
-            }
-        } else {
-            // We're in a trip - add data points and check for trip end
-            if (!m_detectedTrips.isEmpty()) {
-                m_detectedTrips.last().dataPoints.append(point);
-            }
-            
-            if (isMoving(point.speed)) {
-                m_lastMovementTime = point.timestamp;
-                m_potentialTripEnd = QDateTime(); // Reset potential end
-            } else {
-                // Vehicle stopped
-                if (m_potentialTripEnd.isNull()) {
-                    m_potentialTripEnd = point.timestamp;
-                } else {
-                    // Check if stopped for more than 3 minutes
-                    qint64 stoppedDuration = m_potentialTripEnd.secsTo(point.timestamp);
-                    if (stoppedDuration >= TRIP_END_DURATION_SECONDS) {
-                        // Trip ended!
-                        if (!m_detectedTrips.isEmpty()) {
-                            TripInfo& currentTrip = m_detectedTrips.last();
-                            currentTrip.endTime = m_potentialTripEnd;
-                            
-                            // Find battery charge at trip end time
-                            currentTrip.endBatteryCharge = getBatteryChargeAtTime(m_potentialTripEnd);
-                            
-                            currentTrip.calculateStatistics();
-                            
-                            qDebug() << "*** TRIP" << currentTrip.tripId << "ENDED at" << currentTrip.endTime.toString() << "***";
-                            qDebug() << "Driver:" << currentTrip.driverName;
-                            qDebug() << "Notes:" << currentTrip.notes;
-                            qDebug() << "Images:" << currentTrip.imagePaths;
-                            qDebug() << "End battery charge:" << currentTrip.endBatteryCharge << "%";
-                            qDebug() << "Battery used:" << currentTrip.batteryUsedPercent << "%";
-                            qDebug() << "Energy consumed:" << currentTrip.energyConsumedWh << "Wh";
-                            qDebug() << "Energy efficiency:" << currentTrip.energyEfficiencyWhKm << "Wh/km";
-                            qDebug() << "Trip duration:" << currentTrip.getFormattedDuration();
-                            qDebug() << "Max speed:" << currentTrip.maxSpeed << "m/s";
-                            qDebug() << "Average speed:" << currentTrip.averageSpeed << "m/s";
-                            qDebug() << "Distance traveled:" << currentTrip.getFormattedDistance();
-                            
-                            // Save trip to database
-                            saveTripToDatabase(currentTrip);
-                            
-                            emit tripEnded(currentTrip.tripId, currentTrip.endTime, currentTrip.maxSpeed, 
-                                         currentTrip.averageSpeed, currentTrip.distanceTraveled, currentTrip.durationSeconds);
-                            emit tripsUpdated(); // Notify QML of new trip
-                        }
-                        
-                        m_inTrip = false;
-                        m_potentialTripEnd = QDateTime();
-                    }
-                }
-            }
+        if (query.next()) {
+            head.advance(query.value(0).toInt(), QDateTime::fromString(query.value(1).toString(), Qt::ISODate));
         }
+    };
+    load("trips", "trip_id", m_storedTrips);
+    load("charging_sessions", "session_id", m_storedChargingSessions);
+    load("parking_sessions", "session_id", m_storedParkingSessions);
+}
+
+void InfluxDBClient::saveDetectorCheckpoint(bool force)
+{
+    // Only a detector that has seen exactly the buffer matches its watermark
+    if (!m_segmentStore.isOpen() || !m_bufferAnalyzed || m_dataBuffer.isEmpty()) return;
+    if (!force && m_checkpointTimer.isValid() && m_checkpointTimer.elapsed() < CHECKPOINT_INTERVAL_MS) return;
+    m_checkpointTimer.start();
+    
+    // Written aside and renamed into place, a crash keeps the previous one
+    QSaveFile file(QDir(m_segmentStore.directory()).filePath(CHECKPOINT_FILE_NAME));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "InfluxDBClient: Cannot write detector checkpoint:" << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CHECKPOINT_MAGIC << CHECKPOINT_VERSION << m_dataBuffer.lastMsecs();
+    m_tripDetector->saveState(out);
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qDebug() << "InfluxDBClient: Cannot write detector checkpoint:" << file.errorString();
+    }
+}
+
+qint64 InfluxDBClient::restoreDetectorCheckpoint()
+{
+    if (!m_segmentStore.isOpen() || m_dataBuffer.isEmpty()) return -1;
+    
+    QFile file(QDir(m_segmentStore.directory()).filePath(CHECKPOINT_FILE_NAME));
+    if (!file.open(QIODevice::ReadOnly)) return -1;
+    
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 watermark = -1;
+    in >> magic >> version >> watermark;
+    if (magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+        qDebug() << "InfluxDBClient: Ignoring unknown detector checkpoint";
+        return -1;
+    }
+    // Points up to the watermark must still be in the buffer's past, the ones
+    // after it are replayed
+    if (watermark < 0 || watermark > m_dataBuffer.lastMsecs()) {
+        qDebug() << "InfluxDBClient: Detector checkpoint is ahead of the stored telemetry, ignoring it";
+        return -1;
     }
+    if (!m_tripDetector->restoreState(in)) {
+        qDebug() << "InfluxDBClient: Detector checkpoint not usable, analyzing from scratch";
+        return -1;
+    }
+    return watermark;
+}
+
+void InfluxDBClient::handleDetectorEvents()
+{
+    // The saves of one cycle are queued back to back, so the writer thread
+    // commits them together in one transaction
+    handleTripEvents();
+    handleSessionEvents();
+}
+
+void InfluxDBClient::handleTripEvents()
+{
+    const QList<TripEvent> events = m_tripDetector->takeEvents();
     
-    // === POST-PROCESSING TIMEOUT CHECK ===
-    // Check if we need to force-end a trip due to timeout after processing all data
-    if (!m_dataBuffer.isEmpty()) {
-        QDateTime currentTime = QDateTime::currentDateTime();
-        QDateTime lastDataTime = m_dataBuffer.last().timestamp;
-        qint64 timeSinceLastData = lastDataTime.secsTo(currentTime);
+    for (const TripEvent& event : events) {
+        const TripInfo& trip = m_tripDetector->trips().at(event.tripIndex);
+        if (m_storedTrips.covers(trip.startTime)) {
+            continue; // stored before, detected again by a full analysis
+        }
         
-        qDebug() << "\n=== POST-PROCESSING TIMEOUT CHECK ===";
-        qDebug() << "Current time:" << currentTime.toString();
-        qDebug() << "Last data time:" << lastDataTime.toString();
-        qDebug() << "Time since last data:" << timeSinceLastData << "seconds (" << (timeSinceLastData / 60.0) << "minutes)";
-        qDebug() << "Timeout threshold:" << TRIP_TIMEOUT_SECONDS << "seconds (" << (TRIP_TIMEOUT_SECONDS / 60.0) << "minutes)";
-        qDebug() << "Currently in trip:" << m_inTrip;
+        if (event.type == TripEvent::Started) {
+            qDebug() << "*** TRIP" << trip.tripId << "STARTED at" << trip.startTime.toString() << "***";
+            qDebug() << "Driver:" << trip.driverName;
+            qDebug() << "Notes:" << trip.notes;
+            qDebug() << "Start battery charge:" << trip.startBatteryCharge << "%";
+            // The sampling rate while driving has nothing to do with the parked one
+            m_dataArrivalIntervalMs = 0;
+            emit tripStarted(trip.tripId, trip.startTime);
+            continue;
+        }
         
-        bool hasOngoingTrip = m_inTrip || (!m_detectedTrips.isEmpty() && m_detectedTrips.last().endTime.isNull());
-        qDebug() << "Has ongoing trip:" << hasOngoingTrip;
+        qDebug() << "*** TRIP" << trip.tripId
+                 << (event.type == TripEvent::TimedOut ? "FORCE-ENDED at" : "ENDED at")
+                 << trip.endTime.toString()
+                 << (event.type == TripEvent::TimedOut ? "(TIMEOUT) ***" : "***");
+        qDebug() << "Driver:" << trip.driverName;
+        qDebug() << "Notes:" << trip.notes;
+        qDebug() << "Images:" << trip.imagePaths;
+        qDebug() << "End battery charge:" << trip.endBatteryCharge << "%";
+        qDebug() << "Battery used:" << trip.batteryUsedPercent << "%";
+        qDebug() << "Energy consumed:" << trip.energyConsumedWh << "±" << trip.energyConfidenceWh << "Wh";
+        qDebug() << "Energy efficiency:" << trip.energyEfficiencyWhKm << "Wh/km";
+        qDebug() << "Trip duration:" << trip.getFormattedDuration();
+        qDebug() << "Max speed:" << trip.maxSpeed << "m/s";
+        qDebug() << "Average speed:" << trip.averageSpeed << "m/s";
+        qDebug() << "Distance traveled:" << trip.getFormattedDistance();
         
-        bool shouldForceEnd = timeSinceLastData >= TRIP_TIMEOUT_SECONDS && hasOngoingTrip;
-        qDebug() << "Should force end trip:" << shouldForceEnd;
+        // Save trip and its telemetry to database and publish it for dashboards
+        saveTripToDatabase(trip, bufferedPointsBetween(trip.startTime, trip.endTime));
+        m_storedTrips.advance(trip.tripId, trip.endTime);
+        publishTrip(trip);
         
-        if (shouldForceEnd) {
-            qDebug() << "\n🕐 FORCING TRIP END DUE TO TIMEOUT";
-            
-            if (!m_detectedTrips.isEmpty()) {
-                TripInfo& currentTrip = m_detectedTrips.last();
-                if (currentTrip.endTime.isNull()) {
-                    // End the trip at the time of the last data point
-                    currentTrip.endTime = lastDataTime;
-                    
-                    // Find battery charge at trip end time
-                    currentTrip.endBatteryCharge = getBatteryChargeAtTime(lastDataTime);
-                    
-                    currentTrip.calculateStatistics();
-                    
-                    qDebug() << "*** TRIP" << currentTrip.tripId << "FORCE-ENDED at" << currentTrip.endTime.toString() << "(TIMEOUT) ***";
-                    qDebug() << "Driver:" << currentTrip.driverName;
-                    qDebug() << "Notes:" << currentTrip.notes;
-                    qDebug() << "Images:" << currentTrip.imagePaths;
-                    qDebug() << "End battery charge:" << currentTrip.endBatteryCharge << "%";
-                    qDebug() << "Battery used:" << currentTrip.batteryUsedPercent << "%";
-                    qDebug() << "Energy consumed:" << currentTrip.energyConsumedWh << "Wh";
-                    qDebug() << "Energy efficiency:" << currentTrip.energyEfficiencyWhKm << "Wh/km";
-                    qDebug() << "Trip duration:" << currentTrip.getFormattedDuration();
-                    qDebug() << "Max speed:" << currentTrip.maxSpeed << "m/s";
-                    qDebug() << "Average speed:" << currentTrip.averageSpeed << "m/s";
-                    qDebug() << "Distance traveled:" << currentTrip.getFormattedDistance();
-                    
-                    // Save trip to database
-                    saveTripToDatabase(currentTrip);
-                    
-                    emit tripEnded(currentTrip.tripId, currentTrip.endTime, currentTrip.maxSpeed, 
-                                 currentTrip.averageSpeed, currentTrip.distanceTraveled, currentTrip.durationSeconds);
-                    emit tripsUpdated(); // Notify QML of new trip
-                }
+        emit tripEnded(trip.tripId, trip.endTime, trip.maxSpeed, 
+                     trip.averageSpeed, trip.distanceTraveled, trip.durationSeconds);
+    }
+}
+
+void InfluxDBClient::handleSessionEvents()
+{
+    const QList<SessionEvent> events = m_tripDetector->sessions().takeEvents();
+    
+    for (const SessionEvent& event : events) {
+        const bool charging = event.machine == SessionEvent::Charging;
+        const SessionInfo& session = charging
+            ? m_tripDetector->sessions().charging().sessions().at(event.sessionIndex)
+            : m_tripDetector->sessions().parking().sessions().at(event.sessionIndex);
+        const char *name = charging ? "CHARGING SESSION" : "PARKING SESSION";
+        StoredHead& stored = charging ? m_storedChargingSessions : m_storedParkingSessions;
+        if (stored.covers(session.startTime)) {
+            continue; // stored before, detected again by a full analysis
+        }
+        
+        if (event.type == SessionEvent::Started) {
+            qDebug() << "***" << name << session.sessionId << "STARTED at" << session.startTime.toString()
+                     << "battery:" << session.startCharge << "% ***";
+            if (charging) {
+                emit chargingSessionStarted(session.sessionId, session.startTime);
+            } else {
+                emit parkingSessionStarted(session.sessionId, session.startTime);
             }
-            
-            m_inTrip = false;
-            m_potentialTripEnd = QDateTime();
-            m_potentialTripStart = QDateTime();
+            continue;
+        }
+        
+        qDebug() << "***" << name << session.sessionId
+                 << (event.type == SessionEvent::TimedOut ? "FORCE-ENDED at" : "ENDED at")
+                 << session.endTime.toString() << "after" << session.durationSeconds << "seconds, battery"
+                 << session.startCharge << "% →" << session.endCharge << "% ***";
+        
+        saveSessionToDatabase(event.machine, session, event.type == SessionEvent::TimedOut);
+        stored.advance(session.sessionId, session.endTime);
+        
+        if (charging) {
+            emit chargingSessionEnded(session.sessionId, session.endTime, session.chargeAddedPercent(),
+                                      session.durationSeconds);
+        } else {
+            emit parkingSessionEnded(session.sessionId, session.endTime, session.durationSeconds);
         }
     }
 }
@@ -508,11 +1030,11 @@ void InfluxDBClient::analyzeForTrips()
 void InfluxDBClient::printTripSummary()
 {
     std::cout << "\n=== TRIP DETECTION SUMMARY ===" << std::endl;
-    std::cout << "Total trips detected: " << m_detectedTrips.size() << std::endl;
-    std::cout << "Currently in trip: " << (m_inTrip ? "YES" : "NO") << std::endl;
+    std::cout << "Total trips detected: " << m_tripDetector->trips().size() << std::endl;
+    std::cout << "Currently in trip: " << (m_tripDetector->inTrip() ? "YES" : "NO") << std::endl;
     std::cout << "Data points analyzed: " << m_dataBuffer.size() << std::endl;
     
-    for (const TripInfo& trip : m_detectedTrips) {
+    for (const TripInfo& trip : m_tripDetector->trips()) {
         std::cout << "\n--- TRIP " << trip.tripId << " ---" << std::endl;
         std::cout << "Start: " << trip.getFormattedStartTime().toStdString() << std::endl;
         if (!trip.endTime.isNull()) {
@@ -523,9 +1045,12 @@ void InfluxDBClient::printTripSummary()
             std::cout << "Distance: " << trip.getFormattedDistance().toStdString() << std::endl;
             std::cout << "Battery Usage: " << trip.getFormattedBatteryUsage().toStdString() << std::endl;
             std::cout << "Energy Consumed: " << trip.getFormattedEnergyConsumption().toStdString() << std::endl;
-            std::cout << "Data Points: " << trip.dataPoints.size() << std::endl;
+            std::cout << "Data Points: " << trip.dataPointCount() << std::endl;
         } else {
             std::cout << "Status: ONGOING" << std::endl;
+            std::cout << "So far: " << trip.stats.count << " points, max " << trip.stats.maxSpeed
+                      << " m/s, avg " << trip.stats.averageSpeed() << " m/s, "
+                      << QString::number(trip.stats.trapezoidalDistanceKm(), 'f', 2).toStdString() << " km" << std::endl;
         }
     }
     std::cout << "=============================" << std::endl;
@@ -535,13 +1060,13 @@ void InfluxDBClient::printDetailedTripInfo()
 {
     std::cout << "\n=== DETAILED TRIP ANALYSIS ===" << std::endl;
     
-    if (m_detectedTrips.isEmpty()) {
+    if (m_tripDetector->trips().isEmpty()) {
         std::cout << "No trips detected yet." << std::endl;
         std::cout << "===============================" << std::endl;
         return;
     }
     
-    for (const TripInfo& trip : m_detectedTrips) {
+    for (const TripInfo& trip : m_tripDetector->trips()) {
         std::cout << "\n🚗 TRIP " << trip.tripId << " DETAILS:" << std::endl;
         std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << std::endl;
         
@@ -558,10 +1083,14 @@ void InfluxDBClient::printDetailedTripInfo()
             std::cout << "� Battery Usage:        " << trip.getFormattedBatteryUsage().toStdString() << std::endl;
             std::cout << "⚡ Energy Consumed:      " << trip.getFormattedEnergyConsumption().toStdString() << std::endl;
             std::cout << "📈 Energy Efficiency:    " << trip.getFormattedEnergyEfficiency().toStdString() << std::endl;
-            std::cout << "�📊 Data Points Recorded: " << trip.dataPoints.size() << std::endl;
+            std::cout << "�📊 Data Points Recorded: " << trip.dataPointCount() << std::endl;
         } else {
             std::cout << "🔄 Status: TRIP IN PROGRESS" << std::endl;
-            std::cout << "📊 Data Points So Far:   " << trip.dataPoints.size() << std::endl;
+            std::cout << "📊 Data Points So Far:   " << trip.dataPointCount() << std::endl;
+            std::cout << "🏃 Average Speed So Far: " << QString::number(trip.stats.averageSpeed(), 'f', 2).toStdString()
+                      << " m/s (σ " << QString::number(std::sqrt(trip.stats.speedVariance()), 'f', 2).toStdString() << ")" << std::endl;
+            std::cout << "🚀 Maximum Speed So Far: " << QString::number(trip.stats.maxSpeed, 'f', 2).toStdString() << " m/s" << std::endl;
+            std::cout << "📏 Distance So Far:      " << QString::number(trip.stats.trapezoidalDistanceKm(), 'f', 2).toStdString() << " km" << std::endl;
         }
         
         std::cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << std::endl;
@@ -573,7 +1102,7 @@ void InfluxDBClient::printDetailedTripInfo()
     double totalMaxSpeed = 0.0;
     int completedTrips = 0;
     
-    for (const TripInfo& trip : m_detectedTrips) {
+    for (const TripInfo& trip : m_tripDetector->trips()) {
         if (!trip.endTime.isNull()) {
             totalDistance += trip.distanceTraveled;
             totalDuration += trip.durationSeconds;
@@ -599,35 +1128,6 @@ void InfluxDBClient::printDetailedTripInfo()
     std::cout << "===============================" << std::endl;
 }
 
-double InfluxDBClient::getBatteryChargeAtTime(const QDateTime& targetTime) const
-{
-    if (m_dataBuffer.isEmpty()) {
-        return 0.0;
-    }
-    
-    // Find the data point with timestamp closest to the target time
-    double closestCharge = 0.0;
-    qint64 minTimeDiff = std::numeric_limits<qint64>::max();
-    bool foundValidData = false;
-    
-    for (const VehicleDataPoint& point : m_dataBuffer) {
-        qint64 timeDiff = qAbs(point.timestamp.secsTo(targetTime));
-        
-        // Always consider the closest timestamp, regardless of whether battery charge is > 0
-        // since 0 might be a valid battery reading or placeholder
-        if (timeDiff < minTimeDiff) {
-            minTimeDiff = timeDiff;
-            closestCharge = point.batteryCharge;
-            foundValidData = true;
-        }
-    }
-    
-    qDebug() << "getBatteryChargeAtTime: Target time:" << targetTime.toString() 
-             << "Closest charge:" << closestCharge << "% Time diff:" << minTimeDiff << "seconds";
-    
-    return foundValidData ? closestCharge : 0.0;
-}
-
 bool InfluxDBClient::initializeDatabase()
 {
     // Create database file in application data directory
@@ -645,6 +1145,16 @@ bool InfluxDBClient::initializeDatabase()
     
     qDebug() << "Database opened successfully at:" << dbPath;
     
+    // WAL lets readers run alongside the writer thread's transactions, each on
+    // its own snapshot, and with it synchronous=NORMAL stays crash safe
+    QSqlQuery pragma(m_database);
+    for (const char *statement : { "PRAGMA journal_mode=WAL", "PRAGMA synchronous=NORMAL",
+                                   "PRAGMA cache_size=-8192", "PRAGMA temp_store=MEMORY" }) {
+        if (!pragma.exec(QLatin1String(statement))) {
+            qDebug() << "Failed to apply" << statement << ":" << pragma.lastError().text();
+        }
+    }
+    
     // Create trips table with comprehensive schema
     QSqlQuery query(m_database);
     QString createTableSql = R"(
@@ -661,6 +1171,7 @@ bool InfluxDBClient::initializeDatabase()
             battery_used_percent REAL DEFAULT 0.0,
             energy_consumed_wh REAL DEFAULT 0.0,
             energy_efficiency_whkm REAL DEFAULT 0.0,
+            energy_confidence_wh REAL DEFAULT 0.0,
             trip_name TEXT DEFAULT '',
             driver_name TEXT DEFAULT '',
             notes TEXT DEFAULT '',
@@ -678,82 +1189,174 @@ bool InfluxDBClient::initializeDatabase()
     // Add trip_name column if it doesn't exist (for backward compatibility)
     QString addColumnSql = "ALTER TABLE trips ADD COLUMN trip_name TEXT DEFAULT ''";
     query.exec(addColumnSql); // This will fail silently if column already exists
+    query.exec("ALTER TABLE trips ADD COLUMN energy_confidence_wh REAL DEFAULT 0.0");
+    
+    if (!createTripQueryIndexes(m_database)) {
+        return false;
+    }
     
     qDebug() << "Database table 'trips' ready";
+    
+    // One table per session machine, same shape
+    for (const char *table : { "charging_sessions", "parking_sessions" }) {
+        const QString createSessionsSql = QString(R"(
+            CREATE TABLE IF NOT EXISTS %1 (
+                session_id INTEGER PRIMARY KEY,
+                start_time TEXT NOT NULL,
+                end_time TEXT,
+                duration_seconds INTEGER DEFAULT 0,
+                start_charge REAL DEFAULT 0.0,
+                end_charge REAL DEFAULT 0.0,
+                charge_added_percent REAL DEFAULT 0.0,
+                energy_added_wh REAL DEFAULT 0.0,
+                timed_out INTEGER DEFAULT 0,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP
+            )
+        )").arg(QLatin1String(table));
+        
+        if (!query.exec(createSessionsSql)) {
+            qDebug() << "Failed to create" << table << "table:" << query.lastError().text();
+            return false;
+        }
+    }
+    
+    qDebug() << "Database tables 'charging_sessions' and 'parking_sessions' ready";
+    
+    // Points of each trip as one compressed blob, kept out of 'trips' so that
+    // listing trips never reads them
+    QString createTelemetrySql = R"(
+        CREATE TABLE IF NOT EXISTS trip_telemetry (
+            trip_id INTEGER PRIMARY KEY,
+            point_count INTEGER DEFAULT 0,
+            encoding INTEGER NOT NULL,
+            data BLOB NOT NULL
+        )
+    )";
+    
+    if (!query.exec(createTelemetrySql)) {
+        qDebug() << "Failed to create trip_telemetry table:" << query.lastError().text();
+        return false;
+    }
+    
+    // All writes go through their own connection on the writer thread, reads
+    // through read-only connections of the reading thread
+    m_databaseReaders = std::make_unique<TripDatabaseReaders>(dbPath);
+    m_databaseWriter = new TripDatabaseWriter(dbPath, this);
+    connect(m_databaseWriter, &TripDatabaseWriter::batchWritten, this,
+            [this](int commands, int failed, qint64 elapsedMs) {
+        qDebug() << "Trip database: committed" << (commands - failed) << "of" << commands
+                 << "writes in" << elapsedMs << "ms";
+        if (commands > failed) {
+            emit tripsUpdated(); // Notify QML once the rows are visible
+        }
+    });
+    // Cached rows are dropped when a write is queued and again once it is
+    // committed, so a read in between cannot keep the old row
+    connect(m_databaseWriter, &TripDatabaseWriter::tripsWritten, this,
+            [this](const QList<int>& changedTripIds, const QList<int>& deletedTripIds) {
+        for (int tripId : changedTripIds) {
+            m_tripCache.remove(tripId);
+            emit tripChanged(tripId);
+        }
+        for (int tripId : deletedTripIds) {
+            m_tripCache.remove(tripId);
+            emit tripRemoved(tripId);
+        }
+    });
+    m_databaseWriter->start();
+    
+    loadStoredHeads();
     return true;
 }
 
-bool InfluxDBClient::saveTripToDatabase(const TripInfo& trip)
+QFuture<bool> InfluxDBClient::saveSessionToDatabase(SessionEvent::Machine machine, const SessionInfo& session, bool timedOut)
 {
-    if (!m_database.isOpen()) {
+    if (!m_databaseWriter) {
+        qDebug() << "Database not open - cannot save session";
+        return QtFuture::makeReadyValueFuture(false);
+    }
+    return m_databaseWriter->saveSession(machine, session, timedOut);
+}
+
+QFuture<bool> InfluxDBClient::saveTripToDatabase(const TripInfo& trip, const QList<VehicleDataPoint>& telemetry)
+{
+    if (!m_databaseWriter) {
         qDebug() << "Database not open - cannot save trip";
+        return QtFuture::makeReadyValueFuture(false);
+    }
+    m_tripCache.remove(trip.tripId);
+    return m_databaseWriter->saveTrip(trip, telemetry);
+}
+
+// Raw points of the buffer within [from, to]
+QList<VehicleDataPoint> InfluxDBClient::bufferedPointsBetween(const QDateTime& from, const QDateTime& to) const
+{
+    return m_dataBuffer.pointsBetween(from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch());
+}
+
+// Runs on whichever thread owns 'database'
+static bool loadTelemetry(const QSqlDatabase& database, int tripId, QList<VehicleDataPoint>& points)
+{
+    points.clear();
+    
+    if (!database.isOpen()) {
+        qDebug() << "Database not open - cannot load trip telemetry";
         return false;
     }
     
-    QSqlQuery query(m_database);
-    query.prepare(R"(
-        INSERT OR REPLACE INTO trips (
-            trip_id, start_time, end_time, max_speed, average_speed, 
-            distance_traveled, duration_seconds, start_battery_charge, 
-            end_battery_charge, battery_used_percent, energy_consumed_wh, 
-            energy_efficiency_whkm, trip_name, driver_name, notes, image_paths, 
-            data_points_count
-        ) VALUES (
-            :trip_id, :start_time, :end_time, :max_speed, :average_speed,
-            :distance_traveled, :duration_seconds, :start_battery_charge,
-            :end_battery_charge, :battery_used_percent, :energy_consumed_wh,
-            :energy_efficiency_whkm, :trip_name, :driver_name, :notes, :image_paths,
-            :data_points_count
-        )
-    )");
-    
-    // Bind all the comprehensive trip data
-    query.bindValue(":trip_id", trip.tripId);
-    query.bindValue(":start_time", trip.startTime.toString(Qt::ISODate));
-    query.bindValue(":end_time", trip.endTime.isNull() ? QVariant() : trip.endTime.toString(Qt::ISODate));
-    query.bindValue(":max_speed", trip.maxSpeed);
-    query.bindValue(":average_speed", trip.averageSpeed);
-    query.bindValue(":distance_traveled", trip.distanceTraveled);
-    query.bindValue(":duration_seconds", trip.durationSeconds);
-    query.bindValue(":start_battery_charge", trip.startBatteryCharge);
-    query.bindValue(":end_battery_charge", trip.endBatteryCharge);
-    query.bindValue(":battery_used_percent", trip.batteryUsedPercent);
-    query.bindValue(":energy_consumed_wh", trip.energyConsumedWh);
-    query.bindValue(":energy_efficiency_whkm", trip.energyEfficiencyWhKm);
-    query.bindValue(":trip_name", trip.tripName);
-    query.bindValue(":driver_name", trip.driverName);
-    query.bindValue(":notes", trip.notes);
-    query.bindValue(":image_paths", trip.imagePaths);
-    query.bindValue(":data_points_count", trip.dataPoints.size());
+    QSqlQuery query(database);
+    query.prepare("SELECT encoding, data FROM trip_telemetry WHERE trip_id = :trip_id");
+    query.bindValue(":trip_id", tripId);
     
     if (!query.exec()) {
-        qDebug() << "Failed to save trip to database:" << query.lastError().text();
+        qDebug() << "Failed to load telemetry of trip" << tripId << ":" << query.lastError().text();
+        return false;
+    }
+    if (!query.next()) {
+        return false; // Saved before telemetry was stored, or without points
+    }
+    if (!TripTelemetryCodec::decode(query.value("data").toByteArray(), points, query.value("encoding").toInt())) {
+        qDebug() << "Unreadable telemetry for trip" << tripId;
         return false;
     }
-    
-    qDebug() << "🗄️ TRIP" << trip.tripId << "SAVED TO DATABASE";
-    qDebug() << "   Database record created with all comprehensive data";
-    qDebug() << "   Driver:" << trip.driverName;
-    qDebug() << "   Notes:" << trip.notes;
-    qDebug() << "   Images:" << trip.imagePaths;
-    qDebug() << "   Duration:" << trip.durationSeconds << "seconds";
-    qDebug() << "   Distance:" << trip.distanceTraveled << "km";
-    qDebug() << "   Energy consumed:" << trip.energyConsumedWh << "Wh";
-    qDebug() << "   Data points:" << trip.dataPoints.size();
-    
     return true;
 }
 
-QList<TripInfo> InfluxDBClient::loadTripsFromDatabase()
+bool InfluxDBClient::loadTripTelemetry(int tripId, QList<VehicleDataPoint>& points)
+{
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot load trip telemetry";
+        points.clear();
+        return false;
+    }
+    return loadTelemetry(m_databaseReaders->connection(), tripId, points);
+}
+
+QFuture<QList<VehicleDataPoint>> InfluxDBClient::loadTripTelemetryAsync(int tripId)
+{
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot load trip telemetry";
+        return QtFuture::makeReadyValueFuture(QList<VehicleDataPoint>());
+    }
+    return m_databaseReaders->run([tripId](QSqlDatabase& database) {
+        QList<VehicleDataPoint> points;
+        loadTelemetry(database, tripId, points);
+        return points;
+    });
+}
+
+// Runs on whichever thread owns 'database'
+static QList<TripInfo> loadTrips(const QSqlDatabase& database)
 {
     QList<TripInfo> trips;
     
-    if (!m_database.isOpen()) {
+    if (!database.isOpen()) {
         qDebug() << "Database not open - cannot load trips";
         return trips;
     }
     
-    QSqlQuery query(m_database);
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
     query.prepare("SELECT * FROM trips ORDER BY start_time DESC");
     
     if (!query.exec()) {
@@ -762,56 +1365,103 @@ QList<TripInfo> InfluxDBClient::loadTripsFromDatabase()
     }
     
     while (query.next()) {
-        TripInfo trip;
-        trip.tripId = query.value("trip_id").toInt();
-        trip.startTime = QDateTime::fromString(query.value("start_time").toString(), Qt::ISODate);
-        
-        QString endTimeStr = query.value("end_time").toString();
-        if (!endTimeStr.isEmpty()) {
-            trip.endTime = QDateTime::fromString(endTimeStr, Qt::ISODate);
-        }
-        
-        trip.maxSpeed = query.value("max_speed").toDouble();
-        trip.averageSpeed = query.value("average_speed").toDouble();
-        trip.distanceTraveled = query.value("distance_traveled").toDouble();
-        trip.durationSeconds = query.value("duration_seconds").toLongLong();
-        trip.startBatteryCharge = query.value("start_battery_charge").toDouble();
-        trip.endBatteryCharge = query.value("end_battery_charge").toDouble();
-        trip.batteryUsedPercent = query.value("battery_used_percent").toDouble();
-        trip.energyConsumedWh = query.value("energy_consumed_wh").toDouble();
-        trip.energyEfficiencyWhKm = query.value("energy_efficiency_whkm").toDouble();
-        trip.tripName = query.value("trip_name").toString();
-        trip.driverName = query.value("driver_name").toString();
-        trip.notes = query.value("notes").toString();
-        trip.imagePaths = query.value("image_paths").toString();
-        
-        trips.append(trip);
+        trips.append(tripFromQuery(query));
     }
     
     qDebug() << "📚 Loaded" << trips.size() << "trips from database";
     return trips;
 }
 
-bool InfluxDBClient::deleteTripFromDatabase(int tripId)
+QList<TripInfo> InfluxDBClient::loadTripsFromDatabase()
+{
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot load trips";
+        return QList<TripInfo>();
+    }
+    return loadTrips(m_databaseReaders->connection());
+}
+
+QFuture<QList<TripInfo>> InfluxDBClient::loadTripsFromDatabaseAsync()
+{
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot load trips";
+        return QtFuture::makeReadyValueFuture(QList<TripInfo>());
+    }
+    return m_databaseReaders->run([](QSqlDatabase& database) {
+        return loadTrips(database);
+    });
+}
+
+QFuture<bool> InfluxDBClient::deleteTripFromDatabase(int tripId)
 {
-    if (!m_database.isOpen()) {
+    if (!m_databaseWriter) {
         qDebug() << "Database not open - cannot delete trip";
+        return QtFuture::makeReadyValueFuture(false);
+    }
+    m_tripCache.remove(tripId);
+    return m_databaseWriter->deleteTrip(tripId);
+}
+
+bool InfluxDBClient::loadTripFromDatabase(int tripId, TripInfo& trip)
+{
+    if (const TripInfo *cached = m_tripCache.object(tripId)) {
+        trip = *cached;
+        return true;
+    }
+    
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot load trip";
         return false;
     }
     
-    QSqlQuery query(m_database);
-    query.prepare("DELETE FROM trips WHERE trip_id = :trip_id");
+    // trip_id is the rowid, this is a single b-tree lookup
+    QSqlQuery query(m_databaseReaders->connection());
+    query.prepare("SELECT * FROM trips WHERE trip_id = :trip_id");
     query.bindValue(":trip_id", tripId);
     
     if (!query.exec()) {
-        qDebug() << "Failed to delete trip from database:" << query.lastError().text();
+        qDebug() << "Failed to load trip" << tripId << "from database:" << query.lastError().text();
+        return false;
+    }
+    if (!query.next()) {
         return false;
     }
     
-    qDebug() << "🗑️ TRIP" << tripId << "DELETED FROM DATABASE";
+    trip = tripFromQuery(query);
+    m_tripCache.insert(tripId, new TripInfo(trip));
     return true;
 }
 
+static QVariantMap tripToVariantMap(const TripInfo& trip)
+{
+    QVariantMap tripMap;
+    tripMap["tripId"] = trip.tripId;
+    tripMap["startTime"] = trip.startTime;
+    tripMap["endTime"] = trip.endTime;
+    tripMap["tripName"] = trip.getFormattedTripName();
+    tripMap["driverName"] = trip.driverName;
+    tripMap["formattedStartTime"] = trip.getFormattedStartTime();
+    tripMap["formattedEndTime"] = trip.endTime.isNull() ? "Ongoing" : trip.getFormattedEndTime();
+    tripMap["formattedDuration"] = trip.getFormattedDuration();
+    tripMap["formattedDistance"] = trip.getFormattedDistance();
+    tripMap["maxSpeed"] = trip.maxSpeed;
+    tripMap["averageSpeed"] = trip.averageSpeed;
+    tripMap["distanceTraveled"] = trip.distanceTraveled;
+    tripMap["durationSeconds"] = trip.durationSeconds;
+    tripMap["startBatteryCharge"] = trip.startBatteryCharge;
+    tripMap["endBatteryCharge"] = trip.endBatteryCharge;
+    tripMap["batteryUsedPercent"] = trip.batteryUsedPercent;
+    tripMap["energyConsumedWh"] = trip.energyConsumedWh;
+    tripMap["energyEfficiencyWhKm"] = trip.energyEfficiencyWhKm;
+    tripMap["energyConfidenceWh"] = trip.energyConfidenceWh;
+    tripMap["notes"] = trip.notes;
+    tripMap["imagePaths"] = trip.imagePaths;
+    tripMap["formattedBatteryUsage"] = trip.getFormattedBatteryUsage();
+    tripMap["formattedEnergyConsumption"] = trip.getFormattedEnergyConsumption();
+    tripMap["formattedEnergyEfficiency"] = trip.getFormattedEnergyEfficiency();
+    return tripMap;
+}
+
 // QML-accessible methods
 QVariantList InfluxDBClient::getAllTripsFromDatabase()
 {
@@ -819,82 +1469,99 @@ QVariantList InfluxDBClient::getAllTripsFromDatabase()
     QList<TripInfo> trips = loadTripsFromDatabase();
     
     for (const TripInfo& trip : trips) {
-        QVariantMap tripMap;
-        tripMap["tripId"] = trip.tripId;
-        tripMap["startTime"] = trip.startTime;
-        tripMap["endTime"] = trip.endTime;
-        tripMap["tripName"] = trip.getFormattedTripName();
-        tripMap["driverName"] = trip.driverName;
-        tripMap["formattedStartTime"] = trip.getFormattedStartTime();
-        tripMap["formattedEndTime"] = trip.endTime.isNull() ? "Ongoing" : trip.getFormattedEndTime();
-        tripMap["formattedDuration"] = trip.getFormattedDuration();
-        tripMap["formattedDistance"] = trip.getFormattedDistance();
-        tripMap["maxSpeed"] = trip.maxSpeed;
-        tripMap["averageSpeed"] = trip.averageSpeed;
-        tripMap["distanceTraveled"] = trip.distanceTraveled;
-        tripMap["durationSeconds"] = trip.durationSeconds;
-        tripMap["startBatteryCharge"] = trip.startBatteryCharge;
-        tripMap["endBatteryCharge"] = trip.endBatteryCharge;
-        tripMap["batteryUsedPercent"] = trip.batteryUsedPercent;
-        tripMap["energyConsumedWh"] = trip.energyConsumedWh;
-        tripMap["energyEfficiencyWhKm"] = trip.energyEfficiencyWhKm;
-        tripMap["notes"] = trip.notes;
-        tripMap["imagePaths"] = trip.imagePaths;
-        tripMap["formattedBatteryUsage"] = trip.getFormattedBatteryUsage();
-        tripMap["formattedEnergyConsumption"] = trip.getFormattedEnergyConsumption();
-        tripMap["formattedEnergyEfficiency"] = trip.getFormattedEnergyEfficiency();
-        
-        tripList.append(tripMap);
+        tripList.append(tripToVariantMap(trip));
     }
     
     return tripList;
 }
 
-QVariantMap InfluxDBClient::getTripDetails(int tripId)
+bool InfluxDBClient::queryTripsFromDatabase(const TripQuery& query, TripPage& page)
 {
-    QList<TripInfo> trips = loadTripsFromDatabase();
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot query trips";
+        return false;
+    }
+    return ::queryTrips(m_databaseReaders->connection(), query, page);
+}
+
+QFuture<TripPage> InfluxDBClient::queryTripsFromDatabaseAsync(const TripQuery& query)
+{
+    if (!m_databaseReaders) {
+        qDebug() << "Database not open - cannot query trips";
+        return QtFuture::makeReadyValueFuture(TripPage());
+    }
+    return m_databaseReaders->run([query](QSqlDatabase& database) {
+        TripPage page;
+        ::queryTrips(database, query, page);
+        return page;
+    });
+}
+
+QVariantMap InfluxDBClient::queryTrips(const QVariantMap& options)
+{
+    TripPage page;
+    queryTripsFromDatabase(TripQuery::fromVariantMap(options), page);
     
-    for (const TripInfo& trip : trips) {
-        if (trip.tripId == tripId) {
-            QVariantMap tripMap;
-            tripMap["tripId"] = trip.tripId;
-            tripMap["startTime"] = trip.startTime;
-            tripMap["endTime"] = trip.endTime;
-            tripMap["tripName"] = trip.getFormattedTripName();
-            tripMap["driverName"] = trip.driverName;
-            tripMap["formattedStartTime"] = trip.getFormattedStartTime();
-            tripMap["formattedEndTime"] = trip.endTime.isNull() ? "Ongoing" : trip.getFormattedEndTime();
-            tripMap["formattedDuration"] = trip.getFormattedDuration();
-            tripMap["formattedDistance"] = trip.getFormattedDistance();
-            tripMap["maxSpeed"] = trip.maxSpeed;
-            tripMap["averageSpeed"] = trip.averageSpeed;
-            tripMap["distanceTraveled"] = trip.distanceTraveled;
-            tripMap["durationSeconds"] = trip.durationSeconds;
-            tripMap["startBatteryCharge"] = trip.startBatteryCharge;
-            tripMap["endBatteryCharge"] = trip.endBatteryCharge;
-            tripMap["batteryUsedPercent"] = trip.batteryUsedPercent;
-            tripMap["energyConsumedWh"] = trip.energyConsumedWh;
-            tripMap["energyEfficiencyWhKm"] = trip.energyEfficiencyWhKm;
-            tripMap["notes"] = trip.notes;
-            tripMap["imagePaths"] = trip.imagePaths;
-            tripMap["formattedBatteryUsage"] = trip.getFormattedBatteryUsage();
-            tripMap["formattedEnergyConsumption"] = trip.getFormattedEnergyConsumption();
-            tripMap["formattedEnergyEfficiency"] = trip.getFormattedEnergyEfficiency();
-            
-            return tripMap;
-        }
-    }
-    
-    return QVariantMap(); // Return empty map if trip not found
+    QVariantList tripList;
+    for (const TripInfo& trip : page.trips) {
+        tripList.append(tripToVariantMap(trip));
+    }
+    
+    QVariantMap result;
+    result["trips"] = tripList;
+    result["hasMore"] = page.hasMore;
+    if (page.hasMore) {
+        result["nextKey"] = page.nextKey;
+        result["nextTripId"] = page.nextTripId;
+    }
+    return result;
 }
 
-bool InfluxDBClient::deleteTrip(int tripId)
+QVariantMap InfluxDBClient::getTripTelemetry(int tripId)
 {
-    bool success = deleteTripFromDatabase(tripId);
-    if (success) {
-        emit tripsUpdated();
+    QList<VehicleDataPoint> points;
+    loadTripTelemetry(tripId, points);
+    
+    // Column-wise, which is what chart series take
+    QVariantList timestamps;
+    QVariantList speeds;
+    QVariantList charges;
+    timestamps.reserve(points.size());
+    speeds.reserve(points.size());
+    charges.reserve(points.size());
+    for (const VehicleDataPoint& point : points) {
+        timestamps.append(point.timestamp.toMSecsSinceEpoch());
+        speeds.append(point.speed);
+        charges.append(point.batteryCharge);
     }
-    return success;
+    
+    QVariantMap telemetry;
+    telemetry["tripId"] = tripId;
+    telemetry["timestamps"] = timestamps;
+    telemetry["speeds"] = speeds;
+    telemetry["charges"] = charges;
+    return telemetry;
+}
+
+QVariantMap InfluxDBClient::getTripDetails(int tripId)
+{
+    TripInfo trip;
+    if (!loadTripFromDatabase(tripId, trip)) {
+        return QVariantMap(); // Return empty map if trip not found
+    }
+    return tripToVariantMap(trip);
+}
+
+// Writes from QML are queued to the writer thread: true means accepted, and
+// tripsUpdated() follows once the change is committed
+static bool isAccepted(const QFuture<bool>& result)
+{
+    return !result.isFinished() || result.result();
+}
+
+bool InfluxDBClient::deleteTrip(int tripId)
+{
+    return isAccepted(deleteTripFromDatabase(tripId));
 }
 
 void InfluxDBClient::refreshTrips()
@@ -904,38 +1571,25 @@ void InfluxDBClient::refreshTrips()
 
 bool InfluxDBClient::updateTripName(int tripId, const QString& tripName)
 {
-    return updateTripInDatabase(tripId, "trip_name", tripName);
+    return isAccepted(updateTripInDatabase(tripId, "trip_name", tripName));
 }
 
 bool InfluxDBClient::updateTripDriver(int tripId, const QString& driverName)
 {
-    return updateTripInDatabase(tripId, "driver_name", driverName);
+    return isAccepted(updateTripInDatabase(tripId, "driver_name", driverName));
 }
 
 bool InfluxDBClient::updateTripNotes(int tripId, const QString& notes)
 {
-    return updateTripInDatabase(tripId, "notes", notes);
+    return isAccepted(updateTripInDatabase(tripId, "notes", notes));
 }
 
-bool InfluxDBClient::updateTripInDatabase(int tripId, const QString& field, const QString& value)
+QFuture<bool> InfluxDBClient::updateTripInDatabase(int tripId, const QString& field, const QString& value)
 {
-    if (!m_database.isOpen()) {
+    if (!m_databaseWriter) {
         qDebug() << "Database not open - cannot update trip";
-        return false;
+        return QtFuture::makeReadyValueFuture(false);
     }
-    
-    QSqlQuery query(m_database);
-    QString sql = QString("UPDATE trips SET %1 = :value WHERE trip_id = :trip_id").arg(field);
-    query.prepare(sql);
-    query.bindValue(":value", value);
-    query.bindValue(":trip_id", tripId);
-    
-    if (!query.exec()) {
-        qDebug() << "Failed to update trip in database:" << query.lastError().text();
-        return false;
-    }
-    
-    emit tripsUpdated();
-    qDebug() << "✏️ TRIP" << tripId << field << "UPDATED TO:" << value;
-    return true;
+    m_tripCache.remove(tripId);
+    return m_databaseWriter->updateTripField(tripId, field, value);
 }
@@ -6,6 +6,8 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QTimer>
+#include <QPointer>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -19,228 +21,245 @@
 #include <QDir>
 #include <QVariantList>
 #include <QVariantMap>
+#include <QCache>
+#include <QSet>
 
-// Battery configuration constants
-const double BATTERY_CAPACITY_MAH = 6 * 3200; // Six 3200 mAh batteries = 19200 mAh total
-const double BATTERY_VOLTAGE = 12.0; // Typical 12V system
-const double BATTERY_CAPACITY_WH = (BATTERY_CAPACITY_MAH / 1000.0) * BATTERY_VOLTAGE; // Watt-hours
-
-// Structure to hold individual data points (speed + battery)
-struct VehicleDataPoint {
-    QDateTime timestamp;
-    double speed;        // m/s
-    double batteryCharge; // percentage (0-100)
-    
-    VehicleDataPoint() : speed(0.0), batteryCharge(0.0) {}
-    VehicleDataPoint(const QDateTime& time, double spd, double charge = 0.0) 
-        : timestamp(time), speed(spd), batteryCharge(charge) {}
-};
-
-// Legacy alias for backward compatibility
-using SpeedDataPoint = VehicleDataPoint;
-
-// Enhanced structure to hold comprehensive trip information with battery data
-struct TripInfo {
-    int tripId;
-    QDateTime startTime;
-    QDateTime endTime;
-    double maxSpeed;
-    double averageSpeed;
-    double distanceTraveled;
-    qint64 durationSeconds;
-    
-    // Battery and energy data
-    double startBatteryCharge;    // % at trip start
-    double endBatteryCharge;      // % at trip end
-    double batteryUsedPercent;    // % consumed during trip
-    double energyConsumedWh;      // Watt-hours consumed
-    double energyEfficiencyWhKm;  // Wh per km
-    
-    // Trip metadata
-    QString tripName;
-    QString driverName;
-    QString notes;
-    QString imagePaths;
-    
-    QList<VehicleDataPoint> dataPoints;
-    
-    TripInfo() : tripId(-1), maxSpeed(0.0), averageSpeed(0.0), distanceTraveled(0.0), 
-                durationSeconds(0), startBatteryCharge(0.0), endBatteryCharge(0.0),
-                batteryUsedPercent(0.0), energyConsumedWh(0.0), energyEfficiencyWhKm(0.0),
-                tripName(""), driverName(""), notes(""), imagePaths("") {}
-    
-    void calculateStatistics() {
-        if (dataPoints.isEmpty()) return;
-        
-        double totalSpeed = 0.0;
-        maxSpeed = 0.0;
-        distanceTraveled = 0.0;
-        
-        // Get battery data from first and last data points
-        startBatteryCharge = dataPoints.first().batteryCharge;
-        endBatteryCharge = dataPoints.last().batteryCharge;
-        batteryUsedPercent = startBatteryCharge - endBatteryCharge;
-        
-        // Calculate speed statistics
-        for (const auto& point : dataPoints) {
-            totalSpeed += point.speed;
-            if (point.speed > maxSpeed) {
-                maxSpeed = point.speed;
-            }
-        }
-        
-        averageSpeed = totalSpeed / dataPoints.size();
-        
-        // Calculate duration
-        if (!startTime.isNull() && !endTime.isNull()) {
-            durationSeconds = startTime.secsTo(endTime);
-        }
-        
-        // Calculate distance (using average speed * time)
-        // Convert average speed from m/s to km/h for distance calculation
-        double avgSpeedKmh = averageSpeed * 3.6;
-        double durationHours = durationSeconds / 3600.0;
-        distanceTraveled = avgSpeedKmh * durationHours; // km
-        
-        // Calculate energy consumption
-        if (batteryUsedPercent > 0) {
-            energyConsumedWh = (batteryUsedPercent / 100.0) * BATTERY_CAPACITY_WH;
-            
-            // Calculate energy efficiency (Wh per km)
-            if (distanceTraveled > 0) {
-                energyEfficiencyWhKm = energyConsumedWh / distanceTraveled;
-            }
-        }
-    }
-    
-    QString getFormattedDuration() const {
-        int minutes = durationSeconds / 60;
-        int seconds = durationSeconds % 60;
-        return QString("%1 min %2 sec").arg(minutes).arg(seconds);
-    }
-    
-    QString getFormattedDistance() const {
-        return QString("%1 km").arg(distanceTraveled, 0, 'f', 2);
-    }
-    
-    QString getFormattedStartTime() const {
-        return startTime.toString("yyyy-MM-dd hh:mm:ss");
-    }
-    
-    QString getFormattedEndTime() const {
-        return endTime.toString("yyyy-MM-dd hh:mm:ss");
-    }
-    
-    QString getFormattedBatteryUsage() const {
-        return QString("%1% → %2% (-%3%)")
-            .arg(startBatteryCharge, 0, 'f', 1)
-            .arg(endBatteryCharge, 0, 'f', 1)
-            .arg(batteryUsedPercent, 0, 'f', 1);
-    }
-    
-    QString getFormattedEnergyConsumption() const {
-        return QString("%1 Wh").arg(energyConsumedWh, 0, 'f', 1);
-    }
-    
-    QString getFormattedEnergyEfficiency() const {
-        if (energyEfficiencyWhKm > 0) {
-            return QString("%1 Wh/km").arg(energyEfficiencyWhKm, 0, 'f', 1);
-        }
-        return "N/A";
-    }
-    
-    QString getFormattedTripName() const {
-        if (tripName.isEmpty()) {
-            return QString("Trip %1").arg(tripId);
-        }
-        return tripName;
-    }
-};
+#include "tripdata.h"
+#include "tripdetector.h"
+#include "lineprotocolwriter.h"
+#include "tripdatabasewriter.h"
+#include "tripdatabasereaders.h"
+#include "tripquery.h"
+#include "telemetrycolumns.h"
+#include "compressedtelemetry.h"
+#include "telemetrysegmentstore.h"
 
 class InfluxDBClient : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit InfluxDBClient(QObject *parent = nullptr);
+    // The detector config is needed up front: the stored telemetry and the
+    // detector checkpoint are loaded for it while constructing
+    explicit InfluxDBClient(const TripDetectorConfig& detectorConfig = TripDetectorConfig(),
+                            QObject *parent = nullptr);
     void startDataCollection();
     void stopDataCollection();
     void fetchLatestData();
     
     // Trip detection methods
-    QList<TripInfo> getDetectedTrips() const { return m_detectedTrips; }
+    QList<TripInfo> getDetectedTrips() const { return m_tripDetector->trips(); }
     void printTripSummary();
     void printDetailedTripInfo();
     
     // Database methods
     bool initializeDatabase();
-    bool saveTripToDatabase(const TripInfo& trip);
+    // Writes are queued to the writer thread, the futures finish once committed
+    QFuture<bool> saveTripToDatabase(const TripInfo& trip,
+                                     const QList<VehicleDataPoint>& telemetry = QList<VehicleDataPoint>());
     QList<TripInfo> loadTripsFromDatabase();
-    bool deleteTripFromDatabase(int tripId);
+    // Same, on a reader thread, for reports that should not block the caller
+    QFuture<QList<TripInfo>> loadTripsFromDatabaseAsync();
+    // Single trip by id, served from a small cache of recently viewed trips
+    bool loadTripFromDatabase(int tripId, TripInfo& trip);
+    // Points stored with a trip, read only when a view or export asks for them
+    bool loadTripTelemetry(int tripId, QList<VehicleDataPoint>& points);
+    QFuture<QList<VehicleDataPoint>> loadTripTelemetryAsync(int tripId);
+    // One filtered, sorted page, see TripQuery
+    bool queryTripsFromDatabase(const TripQuery& query, TripPage& page);
+    QFuture<TripPage> queryTripsFromDatabaseAsync(const TripQuery& query);
+    QFuture<bool> deleteTripFromDatabase(int tripId);
+    QFuture<bool> saveSessionToDatabase(SessionEvent::Machine machine, const SessionInfo& session, bool timedOut);
     
     // QML-accessible methods
     Q_INVOKABLE QVariantList getAllTripsFromDatabase();
     Q_INVOKABLE QVariantMap getTripDetails(int tripId);
+    // { tripId, timestamps (ms), speeds (m/s), charges (%) }, empty lists when
+    // the trip has no stored telemetry
+    Q_INVOKABLE QVariantMap getTripTelemetry(int tripId);
+    // { trips, hasMore, nextKey, nextTripId }; pass nextKey and nextTripId back
+    // as afterKey and afterTripId for the following page
+    Q_INVOKABLE QVariantMap queryTrips(const QVariantMap& options);
     Q_INVOKABLE bool deleteTrip(int tripId);
     Q_INVOKABLE void refreshTrips();
     Q_INVOKABLE bool updateTripName(int tripId, const QString& tripName);
     Q_INVOKABLE bool updateTripDriver(int tripId, const QString& driverName);
     Q_INVOKABLE bool updateTripNotes(int tripId, const QString& notes);
 
+public slots:
+    // Push ingest: feed samples straight into the detector without polling
+    void ingestSamples(const QList<TelemetrySample>& samples);
+    void setPushIngestEnabled(bool enabled);
+    void setTripPublishingEnabled(bool enabled);
+    void setTripDetectorConfig(const TripDetectorConfig& config);
+    // Query via SQL and receive Arrow IPC instead of Flux CSV (needs HAVE_ARROW)
+    void setArrowQueryUrl(const QString& url);
+
 signals:
     void tripStarted(int tripId, const QDateTime& startTime);
     void tripEnded(int tripId, const QDateTime& endTime, double maxSpeed, double avgSpeed, double distance, qint64 duration);
     void tripsUpdated();
+    // A trip row was committed: saved or edited, or deleted
+    void tripChanged(int tripId);
+    void tripRemoved(int tripId);
+    void chargingSessionStarted(int sessionId, const QDateTime& startTime);
+    void chargingSessionEnded(int sessionId, const QDateTime& endTime, double chargeAddedPercent, qint64 duration);
+    void parkingSessionStarted(int sessionId, const QDateTime& startTime);
+    void parkingSessionEnded(int sessionId, const QDateTime& endTime, qint64 duration);
 
 private slots:
     void onDataReceived();
     void onNetworkError(QNetworkReply::NetworkError error);
     void onTimerTimeout();
+    void onTimeoutCheck();
+    void republishTrips();
 
 private:
     void makeInfluxDBRequest();
     void parseInfluxDBResponse(const QByteArray &data);
+    void parseArrowResponse(const QByteArray &data);
+    void processColumns(TelemetryColumns& columns);
+    // Incremental variant, for a query that continued m_dataBuffer
+    void appendColumns(TelemetryColumns& columns);
+    void advanceSeriesWatermarks(const TelemetryColumns& columns);
     void addDataPoint(const QDateTime& timestamp, double speed, double batteryCharge = 0.0);
-    void analyzeForTrips();
-    bool isMoving(double speed) const { return speed > 0.0; }
-    double getBatteryChargeAtTime(const QDateTime& targetTime) const;
-    
-    // Trip detection logic
-    void checkTripStart();
-    void checkTripEnd();
-    void finalizeTripIfComplete();
-    bool updateTripInDatabase(int tripId, const QString& field, const QString& value);
+    // Feeds m_dataBuffer to the detector, only the points after 'afterMsecs' if set
+    void analyzeForTrips(qint64 afterMsecs = -1);
+    // Brings the detector up to the end of m_dataBuffer: from the checkpoint
+    // when one matches, else from scratch
+    void analyzeBuffer();
+    // Clears the detector for a full analysis; IDs continue after the stored
+    // rows, so re-detected history cannot overwrite them
+    void resetTripDetector();
+    // Newest stored trip and sessions, see StoredHead
+    void loadStoredHeads();
+    // Snapshot of the detector with the ingest watermark it matches, at most
+    // every CHECKPOINT_INTERVAL_MS unless forced
+    void saveDetectorCheckpoint(bool force = false);
+    // Watermark of the restored checkpoint, -1 when there is none to resume from
+    qint64 restoreDetectorCheckpoint();
+    void handleTripEvents();
+    void handleSessionEvents();
+    // Both of the above, after each detection cycle
+    void handleDetectorEvents();
+    void trimDataBuffer();
+    // Fills m_dataBuffer from the segment store, within the retention
+    void loadStoredTelemetry();
+    QList<VehicleDataPoint> bufferedPointsBetween(const QDateTime& from, const QDateTime& to) const;
+    void publishTrip(const TripInfo& trip);
+    QFuture<bool> updateTripInDatabase(int tripId, const QString& field, const QString& value);
+    
+    // Adaptive polling
+    bool hasPendingTripActivity() const;
+    void scheduleNextPoll(bool receivedNewData);
+    // Folds the spacing of the samples newer than 'since' into m_dataArrivalIntervalMs
+    void updateDataArrivalInterval(const QDateTime& since);
 
     QNetworkAccessManager *m_networkManager;
     QTimer *m_timer;
+    
+    // Poll scheduling: only one query is outstanding at a time (it covers both
+    // the speed and charge series), ticks arriving meanwhile collapse into a
+    // single follow-up, and replies from superseded requests are dropped.
+    QPointer<QNetworkReply> m_activeReply;
+    quint64 m_requestSequence;
+    bool m_pollPending;
+    
+    // Adaptive poll interval state
+    bool m_collecting;
+    int m_idlePollIntervalMs;        // current idle back-off step
+    qint64 m_lastResponseLatencyMs;
+    qint64 m_dataArrivalIntervalMs;  // smoothed sample spacing of the newly received data
+    QElapsedTimer m_requestTimer;
+    QDateTime m_newestDataTime;
+    
+    // Push ingest mode: one backfill query, then samples arrive via ingestSamples()
+    bool m_pushIngestEnabled;
+    QTimer *m_timeoutTimer;
+    
     QString m_url;
     QString m_token;
     QString m_org;
     QString m_bucket;
+    QString m_speedMeasurement;
+    QString m_chargeMeasurement;
+    QString m_arrowQueryUrl; // empty = Flux CSV via /api/v2/query
     
-    // Database
+    // Database: this connection only creates the schema, reads go through the
+    // per-thread read-only connections and all writes through the writer thread
     QSqlDatabase m_database;
+    TripDatabaseWriter *m_databaseWriter;
+    std::unique_ptr<TripDatabaseReaders> m_databaseReaders;
+    QCache<int, TripInfo> m_tripCache; // trip id -> row, for detail lookups
+    
+    // Finished trips are also written to InfluxDB as the "trips" measurement
+    LineProtocolWriter *m_tripWriter;
+    QHash<int, QDateTime> m_publishedTripEnds; // trip id -> end time last published
+    // Trips whose write was dropped, written again by m_republishTimer
+    QSet<int> m_unpublishedTripIds;
+    QTimer *m_republishTimer;
     
     // Latest values
     double m_speed;
     double m_charge;
     double m_autonomyLevel;
     
-    // Data storage and trip detection
-    QList<VehicleDataPoint> m_dataBuffer;
-    QList<TripInfo> m_detectedTrips;
-    
-    // Trip detection state
-    bool m_inTrip;
-    int m_nextTripId;
-    QDateTime m_potentialTripStart;
-    QDateTime m_lastMovementTime;
-    QDateTime m_potentialTripEnd;
-    
-    // Trip detection parameters
-    static const int TRIP_START_DURATION_SECONDS = 60;    // 1 minute of movement to start trip
-    static const int TRIP_END_DURATION_SECONDS = 60;      // 1 minute of no movement to end trip
-    static const int TRIP_TIMEOUT_SECONDS = 300;          // 5 minutes without data to force trip end
+    // Data storage and trip detection; the history is kept compressed and
+    // decoded in batches for analysis
+    CompressedTelemetry m_dataBuffer;
+    std::unique_ptr<TripDetector> m_tripDetector;
+    // False until the detector has seen all of m_dataBuffer, e.g. after a
+    // restart or a config change; the next cycle then runs a full analysis
+    bool m_bufferAnalyzed;
+    
+    // On-disk copy of m_dataBuffer; once it has data, queries only ask for
+    // what is newer than its high watermark
+    TelemetrySegmentStore m_segmentStore;
+    qint64 m_querySinceMsecs; // start of the outstanding query, -1 = full range
+    // Newest sample received of each series, each is queried from its own
+    qint64 m_speedWatermark;
+    qint64 m_chargeWatermark;
+    QElapsedTimer m_checkpointTimer;
+    
+    // Newest row saved of a table. A full analysis detects the stored history
+    // again; whatever starts before 'end' is already stored and not saved twice
+    struct StoredHead {
+        int id = 0;
+        QDateTime end;
+        void advance(int newId, const QDateTime& newEnd) {
+            id = qMax(id, newId);
+            if (!end.isValid() || newEnd > end) end = newEnd;
+        }
+        bool covers(const QDateTime& start) const { return end.isValid() && start < end; }
+    };
+    StoredHead m_storedTrips;
+    StoredHead m_storedChargingSessions;
+    StoredHead m_storedParkingSessions;
+    
+    // Amount of history kept in m_dataBuffer, matches the query range
+    static const int DATA_RETENTION_DAYS = 10;
+    // Blocks of m_dataBuffer decoded per detector batch, about 260k points
+    static const int ANALYSIS_BATCH_BLOCKS = 256;
+    // Detector checkpoints while data flows
+    static const int CHECKPOINT_INTERVAL_MS = 60000;
+    // How long the newer series waits for the other one before it is merged anyway
+    static const int SERIES_LAG_GRACE_MS = 60000;
+    // Trips kept in m_tripCache
+    static const int TRIP_CACHE_SIZE = 64;
+    // How often open trips are checked for timeout while in push ingest mode
+    static const int PUSH_TIMEOUT_CHECK_MS = 30000;
+    // Delay before trips from a failed publish are written again
+    static const int TRIP_REPUBLISH_DELAY_MS = 60000;
+    
+    // Adaptive polling parameters
+    static const int POLL_ACTIVE_INTERVAL_MS = 5000;      // trip running or start/end pending
+    static const int POLL_IDLE_MIN_INTERVAL_MS = 15000;   // first idle step, also used while data keeps arriving
+    static const int POLL_IDLE_MAX_INTERVAL_MS = 300000;  // back-off cap when parked
+    static const int POLL_LATENCY_FACTOR = 2;             // never poll faster than 2x the last response time
+    static const int ARRIVAL_SAMPLE_POINTS = 256;         // newest points the sample spacing is taken from
+    
+    // Upper bound on a single query so a hung reply cannot block polling forever
+    static const int REQUEST_TIMEOUT_MS = 120000;
 };
 
 #endif // INFLUXDBCLIENT_H
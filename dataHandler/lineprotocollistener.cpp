@@ -0,0 +1,326 @@
+#include "lineprotocollistener.h"
+#include <QNetworkDatagram>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QTimeZone>
+#include <QDebug>
+#include <zlib.h>
+
+LineProtocolListener::LineProtocolListener(QObject *parent)
+    : QObject(parent)
+    , m_httpServer(new QTcpServer(this))
+    , m_udpSocket(new QUdpSocket(this))
+{
+    connect(m_httpServer, &QTcpServer::newConnection, this, &LineProtocolListener::onNewConnection);
+    connect(m_udpSocket, &QUdpSocket::readyRead, this, &LineProtocolListener::onUdpReadyRead);
+}
+
+bool LineProtocolListener::listenHttp(quint16 port, const QHostAddress& address)
+{
+    if (!m_httpServer->listen(address, port)) {
+        qDebug() << "LineProtocolListener: Failed to listen for HTTP on port" << port << ":" << m_httpServer->errorString();
+        return false;
+    }
+    qDebug() << "LineProtocolListener: Accepting line protocol on http://" << address.toString() << ":" << port << "/api/v2/write";
+    return true;
+}
+
+bool LineProtocolListener::listenUdp(quint16 port, const QHostAddress& address)
+{
+    if (!m_udpSocket->bind(address, port)) {
+        qDebug() << "LineProtocolListener: Failed to bind UDP port" << port << ":" << m_udpSocket->errorString();
+        return false;
+    }
+    qDebug() << "LineProtocolListener: Accepting line protocol on udp://" << address.toString() << ":" << port;
+    return true;
+}
+
+void LineProtocolListener::close()
+{
+    m_httpServer->close();
+    m_udpSocket->close();
+    // Disconnecting may re-enter onSocketDisconnected(), so iterate over a copy
+    const QList<QTcpSocket*> sockets = m_pendingRequests.keys();
+    for (QTcpSocket *socket : sockets) {
+        socket->disconnectFromHost();
+    }
+}
+
+QList<TelemetrySample> LineProtocolListener::parsePayload(QByteArrayView payload, LineProtocolPrecision precision,
+                                                          int *rejectedLines)
+{
+    QList<TelemetrySample> samples;
+    LineProtocolParser parser(payload);
+    LineProtocolLine line;
+    int rejected = 0;
+    const qint64 receivedAt = QDateTime::currentMSecsSinceEpoch();
+
+    while (parser.next(line)) {
+        // Only the treated per-vehicle series are of interest here
+        if (!line.measurement.startsWith("Vehicle/") || line.measurement.indexOf("/qt/") < 0) {
+            continue;
+        }
+
+        QByteArrayView rawValue;
+        double value = 0.0;
+        if (!LineProtocolParser::findField(line.fields, "value", rawValue)
+            || !LineProtocolParser::parseNumber(rawValue, value)) {
+            ++rejected;
+            continue;
+        }
+
+        qint64 msecs = receivedAt;
+        if (!line.timestamp.isEmpty()
+            && !LineProtocolParser::parseTimestamp(line.timestamp, precision, msecs)) {
+            ++rejected;
+            continue;
+        }
+
+        QString measurement = QString::fromUtf8(line.measurement);
+        if (measurement.contains('\\')) {
+            measurement.replace("\\ ", " ").replace("\\,", ",");
+        }
+
+        samples.append(TelemetrySample(measurement, QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::UTC), value));
+    }
+
+    if (rejectedLines) {
+        *rejectedLines = rejected + parser.errorCount();
+    }
+    return samples;
+}
+
+void LineProtocolListener::onNewConnection()
+{
+    while (QTcpSocket *socket = m_httpServer->nextPendingConnection()) {
+        m_pendingRequests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &LineProtocolListener::onSocketReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &LineProtocolListener::onSocketDisconnected);
+    }
+}
+
+void LineProtocolListener::onSocketReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !m_pendingRequests.contains(socket)) return;
+
+    QByteArray& buffer = m_pendingRequests[socket];
+    buffer.append(socket->readAll());
+
+    // Keep-alive clients may pipeline several writes on one connection
+    while (processHttpRequest(socket, buffer)) {
+    }
+}
+
+void LineProtocolListener::onSocketDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    m_pendingRequests.remove(socket);
+    socket->deleteLater();
+}
+
+bool LineProtocolListener::processHttpRequest(QTcpSocket *socket, QByteArray& buffer)
+{
+    qsizetype headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (buffer.size() > MAX_HEADER_BYTES) {
+            sendHttpResponse(socket, 431, "Request Header Fields Too Large");
+            buffer.clear();
+            socket->disconnectFromHost();
+        }
+        return false;
+    }
+
+    const QList<QByteArray> headerLines = buffer.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = headerLines.first().trimmed().split(' ');
+    if (requestLine.size() < 2) {
+        sendHttpResponse(socket, 400, "Bad Request");
+        buffer.clear();
+        socket->disconnectFromHost();
+        return false;
+    }
+
+    const QByteArray method = requestLine[0];
+    const QUrl target(QString::fromLatin1(requestLine[1]));
+
+    qint64 contentLength = 0;
+    bool closeAfterResponse = false;
+    QByteArray contentEncoding;
+    QByteArray authorization;
+    for (int i = 1; i < headerLines.size(); ++i) {
+        const QByteArray& headerLine = headerLines[i];
+        qsizetype colon = headerLine.indexOf(':');
+        if (colon < 0) continue;
+
+        const QByteArray name = headerLine.left(colon).trimmed().toLower();
+        const QByteArray value = headerLine.mid(colon + 1).trimmed();
+        if (name == "content-length") {
+            contentLength = value.toLongLong();
+        } else if (name == "content-encoding") {
+            contentEncoding = value.toLower();
+        } else if (name == "authorization") {
+            authorization = value;
+        } else if (name == "connection") {
+            closeAfterResponse = value.toLower() == "close";
+        } else if (name == "transfer-encoding" && value.toLower() != "identity") {
+            sendHttpResponse(socket, 411, "Length Required");
+            buffer.clear();
+            socket->disconnectFromHost();
+            return false;
+        }
+    }
+
+    if (contentLength < 0 || contentLength > MAX_BODY_BYTES) {
+        sendHttpResponse(socket, 413, "Payload Too Large");
+        buffer.clear();
+        socket->disconnectFromHost();
+        return false;
+    }
+
+    const qint64 requestSize = headerEnd + 4 + contentLength;
+    if (buffer.size() < requestSize) {
+        return false; // wait for the rest of the body
+    }
+
+    const QByteArrayView body(buffer.constData() + headerEnd + 4, contentLength);
+    const QString path = target.path();
+
+    if (method == "POST" && (path == "/api/v2/write" || path == "/write")) {
+        if (!isAuthorized(authorization)) {
+            qDebug() << "LineProtocolListener: Rejected unauthorized write from" << socket->peerAddress().toString();
+            sendHttpResponse(socket, 401, "Unauthorized",
+                             R"({"code":"unauthorized","message":"unauthorized access"})");
+        } else if (!contentEncoding.isEmpty() && contentEncoding != "identity" && contentEncoding != "gzip") {
+            sendHttpResponse(socket, 415, "Unsupported Media Type",
+                             R"({"code":"unsupported","message":"only gzip and identity encodings are supported"})");
+        } else {
+            QByteArray inflated;
+            QByteArrayView payload = body;
+            bool decoded = true;
+            if (contentEncoding == "gzip") {
+                decoded = gunzip(body, MAX_BODY_BYTES, inflated);
+                payload = inflated;
+            }
+
+            QUrlQuery query(target);
+            LineProtocolPrecision precision =
+                LineProtocolParser::precisionFromString(query.queryItemValue("precision").toLatin1());
+
+            int rejected = 0;
+            const QList<TelemetrySample> samples = decoded ? parsePayload(payload, precision, &rejected)
+                                                           : QList<TelemetrySample>();
+            if (!decoded) {
+                qDebug() << "LineProtocolListener: Rejected a gzip body that does not inflate";
+                sendHttpResponse(socket, 400, "Bad Request",
+                                 R"({"code":"invalid","message":"gzip body is corrupt or too large"})");
+            } else if (rejected > 0) {
+                // Nothing of the write is kept, the writer learns which request failed
+                qDebug() << "LineProtocolListener: Rejected a write with" << rejected << "malformed lines";
+                sendHttpResponse(socket, 400, "Bad Request",
+                                 QByteArray(R"({"code":"invalid","message":"unable to parse )")
+                                 + QByteArray::number(rejected) + R"( lines"})");
+            } else {
+                if (!samples.isEmpty()) {
+                    emit samplesReceived(samples);
+                }
+                sendHttpResponse(socket, 204, "No Content");
+            }
+        }
+    } else if ((method == "GET" || method == "HEAD") && (path == "/ping" || path == "/health")) {
+        sendHttpResponse(socket, 204, "No Content");
+    } else {
+        sendHttpResponse(socket, 404, "Not Found");
+    }
+
+    buffer.remove(0, requestSize);
+
+    if (closeAfterResponse) {
+        socket->disconnectFromHost();
+        return false;
+    }
+    return true;
+}
+
+bool LineProtocolListener::gunzip(QByteArrayView data, qsizetype maxBytes, QByteArray& result)
+{
+    z_stream stream = {};
+    // windowBits 15 + 16 accepts the gzip wrapper only
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        return false;
+    }
+
+    result.clear();
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = uInt(data.size());
+
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (result.size() >= maxBytes) break;
+        const qsizetype written = result.size();
+        result.resize(qMin(maxBytes, qMax(written * 2, qsizetype(64 * 1024))));
+        stream.next_out = reinterpret_cast<Bytef*>(result.data() + written);
+        stream.avail_out = uInt(result.size() - written);
+        status = inflate(&stream, Z_NO_FLUSH);
+        result.resize(qsizetype(stream.total_out));
+        // Out of input before the end of the stream: truncated
+        if (status == Z_BUF_ERROR || (status == Z_OK && stream.avail_in == 0 && stream.avail_out > 0)) {
+            status = Z_DATA_ERROR;
+        }
+    }
+    inflateEnd(&stream);
+
+    if (status != Z_STREAM_END) {
+        result.clear();
+        return false;
+    }
+    return true;
+}
+
+bool LineProtocolListener::isAuthorized(const QByteArray& authorization) const
+{
+    if (m_authToken.isEmpty()) return true;
+
+    const QByteArray scheme = "Token ";
+    if (!authorization.startsWith(scheme)) return false;
+    const QByteArray token = authorization.mid(scheme.size()).trimmed();
+    if (token.size() != m_authToken.size()) return false;
+
+    // Every byte is compared, the time taken does not give away a prefix
+    char difference = 0;
+    for (qsizetype i = 0; i < token.size(); ++i) {
+        difference |= token[i] ^ m_authToken[i];
+    }
+    return difference == 0;
+}
+
+void LineProtocolListener::sendHttpResponse(QTcpSocket *socket, int statusCode, const QByteArray& reason,
+                                            const QByteArray& body)
+{
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(statusCode) + ' ' + reason + "\r\n";
+    if (!body.isEmpty()) {
+        response += "Content-Type: application/json\r\n";
+    }
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n";
+    response += body;
+    socket->write(response);
+}
+
+void LineProtocolListener::onUdpReadyRead()
+{
+    while (m_udpSocket->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = m_udpSocket->receiveDatagram();
+        const QByteArray payload = datagram.data();
+
+        int rejected = 0;
+        QList<TelemetrySample> samples = parsePayload(payload, LineProtocolPrecision::Nanoseconds, &rejected);
+        if (rejected > 0) {
+            qDebug() << "LineProtocolListener: Rejected" << rejected << "malformed UDP lines from"
+                     << datagram.senderAddress().toString();
+        }
+        if (!samples.isEmpty()) {
+            emit samplesReceived(samples);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef LINEPROTOCOLLISTENER_H
+#define LINEPROTOCOLLISTENER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QHash>
+#include <QList>
+
+#include "tripdata.h"
+#include "lineprotocolparser.h"
+
+// Local push ingest endpoint. Accepts InfluxDB line protocol either as
+// HTTP POST /api/v2/write (the same call a vehicle or the ETL would make to
+// InfluxDB) or as plain UDP datagrams, and forwards every numeric "value"
+// field of Vehicle/<id>/qt/* measurements as telemetry samples. HTTP bodies
+// may be gzipped (Content-Encoding: gzip, as LineProtocolWriter sends them);
+// like InfluxDB an HTTP write with malformed lines is refused with a 400 as a
+// whole, while UDP forwards the lines that parse.
+//
+// Anything it accepts ends up in trip detection, so it binds to localhost
+// unless told otherwise. With an auth token set, HTTP writes must carry it
+// as "Authorization: Token <token>" like InfluxDB expects; UDP has no way to
+// authenticate and should only be bound to trusted networks.
+class LineProtocolListener : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LineProtocolListener(QObject *parent = nullptr);
+
+    bool listenHttp(quint16 port, const QHostAddress& address = QHostAddress::LocalHost);
+    bool listenUdp(quint16 port, const QHostAddress& address = QHostAddress::LocalHost);
+    void close();
+
+    // Empty accepts HTTP writes without credentials
+    void setAuthToken(const QByteArray& token) { m_authToken = token; }
+
+    // Parse a line protocol payload and return the accepted samples
+    static QList<TelemetrySample> parsePayload(QByteArrayView payload, LineProtocolPrecision precision,
+                                               int *rejectedLines = nullptr);
+
+    // Inflates a gzip body, false when it is corrupt or inflates beyond 'maxBytes'
+    static bool gunzip(QByteArrayView data, qsizetype maxBytes, QByteArray& result);
+
+signals:
+    void samplesReceived(const QList<TelemetrySample>& samples);
+
+private slots:
+    void onNewConnection();
+    void onSocketReadyRead();
+    void onSocketDisconnected();
+    void onUdpReadyRead();
+
+private:
+    bool processHttpRequest(QTcpSocket *socket, QByteArray& buffer);
+    bool isAuthorized(const QByteArray& authorization) const;
+    void sendHttpResponse(QTcpSocket *socket, int statusCode, const QByteArray& reason,
+                          const QByteArray& body = QByteArray());
+
+    QTcpServer *m_httpServer;
+    QUdpSocket *m_udpSocket;
+    QHash<QTcpSocket*, QByteArray> m_pendingRequests;
+    QByteArray m_authToken;
+
+    static const int MAX_HEADER_BYTES = 16 * 1024;
+    static const int MAX_BODY_BYTES = 16 * 1024 * 1024;
+};
+
+#endif // LINEPROTOCOLLISTENER_H
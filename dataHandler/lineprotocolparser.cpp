@@ -0,0 +1,172 @@
+#include "lineprotocolparser.h"
+
+LineProtocolParser::LineProtocolParser(QByteArrayView data)
+    : m_data(data)
+    , m_pos(0)
+    , m_errorCount(0)
+{
+}
+
+bool LineProtocolParser::next(LineProtocolLine& line)
+{
+    const qsizetype size = m_data.size();
+
+    while (m_pos < size) {
+        // Skip leading whitespace, including blank lines
+        qsizetype start = m_pos;
+        while (start < size && (m_data[start] == ' ' || m_data[start] == '\t'
+                                || m_data[start] == '\r' || m_data[start] == '\n')) {
+            ++start;
+        }
+        if (start >= size) {
+            m_pos = size;
+            return false;
+        }
+
+        // Single pass: find the end of the line and the unescaped separators
+        qsizetype measurementEnd = -1; // first comma of the key section
+        qsizetype keyEnd = -1;         // space between key and field set
+        qsizetype fieldsEnd = -1;      // space between field set and timestamp
+        bool inQuotes = false;
+        qsizetype i = start;
+        for (; i < size; ++i) {
+            const char c = m_data[i];
+            if (c == '\\' && i + 1 < size) {
+                ++i;
+                continue;
+            }
+            if (inQuotes) {
+                if (c == '"') inQuotes = false;
+                continue;
+            }
+            if (c == '\n') break;
+            if (c == '"' && keyEnd >= 0) {
+                inQuotes = true;
+            } else if (c == ',' && keyEnd < 0 && measurementEnd < 0) {
+                measurementEnd = i;
+            } else if (c == ' ') {
+                if (keyEnd < 0) {
+                    keyEnd = i;
+                } else if (fieldsEnd < 0) {
+                    fieldsEnd = i;
+                }
+            }
+        }
+
+        m_pos = i + 1;
+
+        qsizetype lineEnd = i;
+        if (lineEnd > start && m_data[lineEnd - 1] == '\r') --lineEnd;
+
+        if (m_data[start] == '#') continue; // comment
+
+        if (keyEnd < 0 || keyEnd + 1 >= lineEnd) {
+            ++m_errorCount;
+            continue;
+        }
+        if (measurementEnd < 0) measurementEnd = keyEnd;
+        if (fieldsEnd < 0 || fieldsEnd > lineEnd) fieldsEnd = lineEnd;
+
+        line.measurement = m_data.sliced(start, measurementEnd - start);
+        line.tags = measurementEnd < keyEnd
+            ? m_data.sliced(measurementEnd + 1, keyEnd - measurementEnd - 1)
+            : QByteArrayView();
+        line.fields = m_data.sliced(keyEnd + 1, fieldsEnd - keyEnd - 1);
+        line.timestamp = fieldsEnd < lineEnd
+            ? m_data.sliced(fieldsEnd + 1, lineEnd - fieldsEnd - 1).trimmed()
+            : QByteArrayView();
+
+        if (line.measurement.isEmpty() || line.fields.isEmpty()) {
+            ++m_errorCount;
+            continue;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool LineProtocolParser::findField(QByteArrayView fields, QByteArrayView key, QByteArrayView& value)
+{
+    const qsizetype size = fields.size();
+    qsizetype pairStart = 0;
+
+    while (pairStart < size) {
+        // Locate the '=' and the end of this key=value pair
+        qsizetype equals = -1;
+        qsizetype pairEnd = pairStart;
+        bool inQuotes = false;
+        for (; pairEnd < size; ++pairEnd) {
+            const char c = fields[pairEnd];
+            if (c == '\\' && pairEnd + 1 < size) {
+                ++pairEnd;
+                continue;
+            }
+            if (inQuotes) {
+                if (c == '"') inQuotes = false;
+                continue;
+            }
+            if (c == '"' && equals >= 0) {
+                inQuotes = true;
+            } else if (c == '=' && equals < 0) {
+                equals = pairEnd;
+            } else if (c == ',') {
+                break;
+            }
+        }
+
+        if (equals > pairStart && fields.sliced(pairStart, equals - pairStart) == key) {
+            value = fields.sliced(equals + 1, pairEnd - equals - 1);
+            return true;
+        }
+        pairStart = pairEnd + 1;
+    }
+
+    return false;
+}
+
+bool LineProtocolParser::parseNumber(QByteArrayView value, double& result)
+{
+    if (value.isEmpty() || value.front() == '"') return false;
+
+    if (value == "t" || value == "T" || value == "true" || value == "True" || value == "TRUE") {
+        result = 1.0;
+        return true;
+    }
+    if (value == "f" || value == "F" || value == "false" || value == "False" || value == "FALSE") {
+        result = 0.0;
+        return true;
+    }
+
+    // Integer and unsigned fields carry an 'i' / 'u' suffix
+    if (value.back() == 'i' || value.back() == 'u') {
+        value.chop(1);
+    }
+
+    bool ok = false;
+    result = value.toDouble(&ok);
+    return ok;
+}
+
+bool LineProtocolParser::parseTimestamp(QByteArrayView value, LineProtocolPrecision precision, qint64& msecs)
+{
+    bool ok = false;
+    qint64 raw = value.toLongLong(&ok);
+    if (!ok) return false;
+
+    switch (precision) {
+    case LineProtocolPrecision::Nanoseconds:  msecs = raw / 1000000; break;
+    case LineProtocolPrecision::Microseconds: msecs = raw / 1000; break;
+    case LineProtocolPrecision::Milliseconds: msecs = raw; break;
+    case LineProtocolPrecision::Seconds:      msecs = raw * 1000; break;
+    }
+    return true;
+}
+
+LineProtocolPrecision LineProtocolParser::precisionFromString(QByteArrayView precision)
+{
+    if (precision == "s") return LineProtocolPrecision::Seconds;
+    if (precision == "ms") return LineProtocolPrecision::Milliseconds;
+    if (precision == "us" || precision == "u") return LineProtocolPrecision::Microseconds;
+    return LineProtocolPrecision::Nanoseconds;
+}
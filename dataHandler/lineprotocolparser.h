@@ -0,0 +1,54 @@
+#ifndef LINEPROTOCOLPARSER_H
+#define LINEPROTOCOLPARSER_H
+
+#include <QByteArrayView>
+
+// One line of InfluxDB line protocol, split into its sections. All views point
+// into the buffer given to the parser and stay valid only as long as it does;
+// escape sequences are left in place.
+struct LineProtocolLine {
+    QByteArrayView measurement;
+    QByteArrayView tags;       // raw tag set without the leading comma, may be empty
+    QByteArrayView fields;     // raw field set
+    QByteArrayView timestamp;  // may be empty, the writer's clock is used then
+};
+
+// Timestamp precision as passed in the ?precision= query parameter
+enum class LineProtocolPrecision {
+    Nanoseconds,
+    Microseconds,
+    Milliseconds,
+    Seconds
+};
+
+// Zero-copy line protocol tokenizer: a single scan per line finds the section
+// boundaries while honouring backslash escapes and quoted string fields.
+class LineProtocolParser
+{
+public:
+    explicit LineProtocolParser(QByteArrayView data);
+
+    // Advance to the next non-empty, non-comment line. Malformed lines are
+    // counted and skipped. Returns false once the input is exhausted.
+    bool next(LineProtocolLine& line);
+
+    int errorCount() const { return m_errorCount; }
+
+    // Find a field by key in a raw field set
+    static bool findField(QByteArrayView fields, QByteArrayView key, QByteArrayView& value);
+
+    // Numeric field value: floats, integers (1i), unsigned (1u) and booleans
+    static bool parseNumber(QByteArrayView value, double& result);
+
+    // Convert a timestamp in the given precision to milliseconds since epoch
+    static bool parseTimestamp(QByteArrayView value, LineProtocolPrecision precision, qint64& msecs);
+
+    static LineProtocolPrecision precisionFromString(QByteArrayView precision);
+
+private:
+    QByteArrayView m_data;
+    qsizetype m_pos;
+    int m_errorCount;
+};
+
+#endif // LINEPROTOCOLPARSER_H
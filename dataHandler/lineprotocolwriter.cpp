@@ -0,0 +1,272 @@
+#include "lineprotocolwriter.h"
+#include <QNetworkRequest>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QDebug>
+#include <zlib.h>
+
+static QByteArray escapeKey(const QString& key)
+{
+    QByteArray escaped = key.toUtf8();
+    escaped.replace(",", "\\,").replace("=", "\\=").replace(" ", "\\ ");
+    return escaped;
+}
+
+QByteArray LineProtocolPoint::toLineProtocol() const
+{
+    QByteArray line = measurement.toUtf8();
+    line.replace(",", "\\,").replace(" ", "\\ ");
+
+    for (const auto& tag : tags) {
+        if (tag.second.isEmpty()) continue; // empty tag values are not allowed
+        line += ',';
+        line += escapeKey(tag.first);
+        line += '=';
+        line += escapeKey(tag.second);
+    }
+
+    bool firstField = true;
+    for (const auto& field : fields) {
+        QByteArray value;
+        switch (field.second.typeId()) {
+        case QMetaType::Double:
+        case QMetaType::Float:
+            // Line protocol has no NaN or infinity, the server rejects the whole batch
+            if (!qIsFinite(field.second.toDouble())) continue;
+            value = QByteArray::number(field.second.toDouble(), 'g', 15);
+            break;
+        case QMetaType::Int:
+        case QMetaType::LongLong:
+        case QMetaType::UInt:
+        case QMetaType::ULongLong:
+            value = QByteArray::number(field.second.toLongLong()) + 'i';
+            break;
+        case QMetaType::Bool:
+            value = field.second.toBool() ? "true" : "false";
+            break;
+        default: {
+            QByteArray text = field.second.toString().toUtf8();
+            text.replace("\\", "\\\\").replace("\"", "\\\"");
+            value = '"' + text + '"';
+            break;
+        }
+        }
+
+        line += firstField ? ' ' : ',';
+        line += escapeKey(field.first);
+        line += '=';
+        line += value;
+        firstField = false;
+    }
+    if (firstField && !fields.isEmpty()) return QByteArray(); // no field left to write
+
+    if (timestamp != 0) {
+        line += ' ';
+        line += QByteArray::number(timestamp);
+    }
+    return line;
+}
+
+LineProtocolWriter::LineProtocolWriter(const Config& config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_networkManager(new QNetworkAccessManager(this))
+    , m_flushTimer(new QTimer(this))
+    , m_batchLines(0)
+    , m_inFlight(0)
+    , m_backPressured(false)
+    , m_linesWritten(0)
+    , m_linesFailed(0)
+    , m_linesDropped(0)
+{
+    if (m_config.maxInFlight < 1) m_config.maxInFlight = 1;
+    if (m_config.maxQueuedBatches < 1) m_config.maxQueuedBatches = 1;
+
+    // Age bound: a partially filled batch is sent at the latest after flushIntervalMs
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(m_config.flushIntervalMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &LineProtocolWriter::flush);
+}
+
+bool LineProtocolWriter::write(const LineProtocolPoint& point, qint64 key)
+{
+    // A line needs at least one field, with a finite value if it is a number
+    const QByteArray line = point.toLineProtocol();
+    if (point.fields.isEmpty() || line.isEmpty()) return false;
+    return writeLine(line, key);
+}
+
+bool LineProtocolWriter::writeLine(const QByteArray& line, qint64 key)
+{
+    if (line.isEmpty()) return true;
+
+    // Hard bound: the queue is full and the open batch cannot take another line
+    const bool batchFull = m_batchLines >= m_config.maxBatchLines
+                           || m_batch.size() + line.size() + 1 > m_config.maxBatchBytes;
+    if (m_queuedBatches.size() >= m_config.maxQueuedBatches && batchFull) {
+        m_linesDropped++;
+        return false;
+    }
+
+    if (!m_batch.isEmpty() && m_batch.size() + line.size() + 1 > m_config.maxBatchBytes) {
+        closeBatch();
+    }
+
+    m_batch += line;
+    if (!line.endsWith('\n')) m_batch += '\n';
+    m_batchLines++;
+    if (key >= 0) m_batchKeys.append(key);
+
+    if (m_batchLines >= m_config.maxBatchLines) {
+        closeBatch();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+    return true;
+}
+
+void LineProtocolWriter::flush()
+{
+    closeBatch();
+    if (isIdle()) {
+        emit drained();
+    }
+}
+
+void LineProtocolWriter::closeBatch()
+{
+    m_flushTimer->stop();
+    if (m_batch.isEmpty()) return;
+
+    Batch batch;
+    batch.lines = m_batchLines;
+    batch.keys.swap(m_batchKeys);
+    if (m_config.gzip) {
+        batch.payload = gzipCompress(m_batch);
+        batch.gzipped = !batch.payload.isEmpty();
+    }
+    if (!batch.gzipped) {
+        batch.payload = m_batch;
+    }
+
+    m_batch.clear();
+    m_batchLines = 0;
+    m_queuedBatches.append(batch);
+    pump();
+}
+
+void LineProtocolWriter::pump()
+{
+    while (m_inFlight < m_config.maxInFlight && !m_queuedBatches.isEmpty()) {
+        send(m_queuedBatches.takeFirst());
+    }
+    updateBackPressure();
+}
+
+void LineProtocolWriter::send(const Batch& batch)
+{
+    QUrl url(m_config.url + "/api/v2/write");
+    QUrlQuery query;
+    query.addQueryItem("org", m_config.org);
+    query.addQueryItem("bucket", m_config.bucket);
+    query.addQueryItem("precision", m_config.precision);
+    url.setQuery(query);
+
+    QNetworkRequest request(url);
+    request.setRawHeader("Authorization", QString("Token %1").arg(m_config.token).toUtf8());
+    request.setRawHeader("Content-Type", "text/plain; charset=utf-8");
+    if (batch.gzipped) {
+        request.setRawHeader("Content-Encoding", "gzip");
+    }
+
+    QNetworkReply *reply = m_networkManager->post(request, batch.payload);
+    m_pendingReplies.insert(reply, batch);
+    m_inFlight++;
+    connect(reply, &QNetworkReply::finished, this, &LineProtocolWriter::onReplyFinished);
+}
+
+void LineProtocolWriter::onReplyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+
+    Batch batch = m_pendingReplies.take(reply);
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (reply->error() == QNetworkReply::NoError) {
+        m_linesWritten += batch.lines;
+    } else {
+        const bool retryable = statusCode == 429 || statusCode >= 500 || statusCode == 0;
+        batch.attempts++;
+
+        if (retryable && batch.attempts <= m_config.maxRetries) {
+            // Honour Retry-After when the server sends one, otherwise back off exponentially
+            int delayMs = 500 << batch.attempts;
+            bool ok = false;
+            int retryAfter = reply->rawHeader("Retry-After").toInt(&ok);
+            if (ok && retryAfter > 0) delayMs = retryAfter * 1000;
+
+            qDebug() << "LineProtocolWriter: Write failed (" << statusCode << reply->errorString()
+                     << "), retry" << batch.attempts << "in" << delayMs << "ms";
+
+            // The batch keeps its in-flight slot while it waits
+            QTimer::singleShot(delayMs, this, [this, batch]() {
+                m_inFlight--;
+                m_queuedBatches.prepend(batch);
+                pump();
+            });
+            reply->deleteLater();
+            return;
+        }
+
+        const QString error = QString("HTTP %1: %2 %3").arg(statusCode).arg(reply->errorString(),
+                                                                           QString::fromUtf8(reply->readAll()));
+        qDebug() << "LineProtocolWriter: Dropping batch of" << batch.lines << "lines -" << error;
+        m_linesFailed += batch.lines;
+        emit batchFailed(error, batch.lines, batch.keys);
+    }
+
+    reply->deleteLater();
+    m_inFlight--;
+    pump();
+
+    if (isIdle()) {
+        emit drained();
+    }
+}
+
+void LineProtocolWriter::updateBackPressure()
+{
+    const bool backPressured = isBackPressured();
+    if (backPressured != m_backPressured) {
+        m_backPressured = backPressured;
+        emit backPressureChanged(backPressured);
+    }
+}
+
+QByteArray LineProtocolWriter::gzipCompress(const QByteArray& data, int level)
+{
+    z_stream stream = {};
+    // windowBits 15 + 16 selects the gzip wrapper
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return QByteArray();
+    }
+
+    QByteArray compressed;
+    compressed.resize(qsizetype(deflateBound(&stream, uLong(data.size()))));
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = uInt(compressed.size());
+
+    const int result = deflate(&stream, Z_FINISH);
+    const uLong written = stream.total_out;
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END) {
+        return QByteArray();
+    }
+    compressed.resize(qsizetype(written));
+    return compressed;
+}
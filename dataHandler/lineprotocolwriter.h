@@ -0,0 +1,114 @@
+#ifndef LINEPROTOCOLWRITER_H
+#define LINEPROTOCOLWRITER_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QList>
+#include <QHash>
+#include <QPair>
+#include <QVariant>
+
+// A single point to be written, formatted by toLineProtocol()
+struct LineProtocolPoint {
+    QString measurement;
+    QList<QPair<QString, QString>> tags;
+    QList<QPair<QString, QVariant>> fields; // double, integer, bool or string
+    qint64 timestamp; // in the writer's precision, 0 = let the server assign it
+
+    LineProtocolPoint() : timestamp(0) {}
+    explicit LineProtocolPoint(const QString& name, qint64 time = 0) : measurement(name), timestamp(time) {}
+
+    LineProtocolPoint& tag(const QString& key, const QString& value) { tags.append({key, value}); return *this; }
+    LineProtocolPoint& field(const QString& key, const QVariant& value) { fields.append({key, value}); return *this; }
+
+    // Non-finite numbers are left out, empty if that leaves no field
+    QByteArray toLineProtocol() const;
+};
+
+// Asynchronous batched writer for POST /api/v2/write. Lines are collected into
+// batches bounded by line count, size and age, gzipped, and posted with a
+// bounded number of requests in flight. When too many batches are queued the
+// writer reports back-pressure; callers that can wait (the ETL) pause their
+// input until it clears, others simply get write() == false. Lines written
+// with a key report it back through batchFailed() when their batch is dropped.
+class LineProtocolWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Config {
+        QString url;
+        QString token;
+        QString org;
+        QString bucket;
+        QString precision = "s";
+        int maxBatchLines = 5000;
+        int maxBatchBytes = 1024 * 1024;
+        int flushIntervalMs = 1000;
+        int maxInFlight = 4;
+        int maxQueuedBatches = 16;
+        int maxRetries = 3;
+        bool gzip = true;
+    };
+
+    explicit LineProtocolWriter(const Config& config, QObject *parent = nullptr);
+
+    bool write(const LineProtocolPoint& point, qint64 key = -1);
+    bool writeLine(const QByteArray& line, qint64 key = -1);
+
+    // Close the current batch and start sending it
+    void flush();
+
+    bool isBackPressured() const { return m_queuedBatches.size() >= m_config.maxQueuedBatches; }
+    bool isIdle() const { return m_batch.isEmpty() && m_queuedBatches.isEmpty() && m_inFlight == 0; }
+
+    qint64 linesWritten() const { return m_linesWritten; }
+    qint64 linesFailed() const { return m_linesFailed; }
+    qint64 linesDropped() const { return m_linesDropped; }
+
+    static QByteArray gzipCompress(const QByteArray& data, int level = 6);
+
+signals:
+    void backPressureChanged(bool backPressured);
+    // keys holds the keys of the dropped lines that were written with one
+    void batchFailed(const QString& error, int lines, const QList<qint64>& keys);
+    // Everything accepted so far has been sent (successfully or not)
+    void drained();
+
+private slots:
+    void onReplyFinished();
+
+private:
+    struct Batch {
+        QByteArray payload;
+        QList<qint64> keys;
+        int lines = 0;
+        int attempts = 0;
+        bool gzipped = false;
+    };
+
+    void closeBatch();
+    void pump();
+    void send(const Batch& batch);
+    void updateBackPressure();
+
+    Config m_config;
+    QNetworkAccessManager *m_networkManager;
+    QTimer *m_flushTimer;
+
+    QByteArray m_batch;
+    int m_batchLines;
+    QList<qint64> m_batchKeys;
+    QList<Batch> m_queuedBatches;
+    QHash<QNetworkReply*, Batch> m_pendingReplies;
+    int m_inFlight; // requests on the wire plus batches waiting to be retried
+    bool m_backPressured;
+
+    qint64 m_linesWritten;
+    qint64 m_linesFailed;
+    qint64 m_linesDropped;
+};
+
+#endif // LINEPROTOCOLWRITER_H
@@ -1,24 +1,43 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
+#include <QQmlContext>
 #include <QDebug>
 #include <QTimer>
 #include "influxdbclient.h"
+#include "triplistmodel.h"
+#include "lineprotocollistener.h"
+#ifdef HAVE_QT_MQTT
+#include "mqttingest.h"
+#endif
 
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
 
+    const TripDetectorConfig detectorConfig = TripDetectorConfig::fromEnvironment();
+
     qDebug() << "=== Trip Detection System Starting ===";
     qDebug() << "This application will analyze InfluxDB vehicle data to detect trips";
     qDebug() << "Trip Detection Rules:";
-    qDebug() << "- Trip Start: Speed > 0 for at least 1 minute";
-    qDebug() << "- Trip End: Speed = 0 for more than 1 minute";
-    qDebug() << "- Trip Timeout: Force end after 5 minutes without data";
-    qDebug() << "Analysis runs every 30 seconds";
+    qDebug() << "- Trip Start: Speed >" << detectorConfig.speedThreshold + detectorConfig.speedDeadband
+             << "m/s for at least" << detectorConfig.startSeconds << "seconds";
+    qDebug() << "- Trip End: Speed <=" << detectorConfig.speedThreshold - detectorConfig.speedDeadband
+             << "m/s for more than" << detectorConfig.endSeconds << "seconds";
+    qDebug() << "- Trip Timeout: Force end after" << detectorConfig.timeoutSeconds << "seconds without data";
+    qDebug() << "- Parking: standing for at least" << detectorConfig.sessions.parkingMinSeconds << "seconds";
+    qDebug() << "- Charging: battery rising" << detectorConfig.sessions.chargingMinRisePercent
+             << "% while standing, ends" << detectorConfig.sessions.chargingEndSeconds << "seconds after the last rise";
+    qDebug() << "Analysis polls every 5 seconds while driving, backing off to 5 minutes when parked";
     qDebug() << "=====================================";
 
-    // Create InfluxDB client
-    InfluxDBClient *influxClient = new InfluxDBClient(&app);
+    // Create InfluxDB client; it loads the stored telemetry for this config right away
+    InfluxDBClient *influxClient = new InfluxDBClient(detectorConfig, &app);
+    // Writes the final detector checkpoint, however the event loop is ended
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, influxClient, &InfluxDBClient::stopDataCollection);
+    if (qEnvironmentVariable("PUBLISH_TRIPS") == "0") {
+        influxClient->setTripPublishingEnabled(false);
+    }
+    influxClient->setArrowQueryUrl(qEnvironmentVariable("ARROW_QUERY_URL"));
     
     // Connect signals for trip events
     QObject::connect(influxClient, &InfluxDBClient::tripStarted, [](int tripId, const QDateTime& startTime) {
@@ -37,6 +56,67 @@ int main(int argc, char *argv[])
         influxClient->printDetailedTripInfo();
     });
     
+    QObject::connect(influxClient, &InfluxDBClient::chargingSessionEnded,
+        [](int sessionId, const QDateTime& endTime, double chargeAddedPercent, qint64 duration) {
+        qDebug() << "🔌 CHARGING SESSION" << sessionId << "ENDED at" << endTime.toString()
+                 << "+" << chargeAddedPercent << "% in" << (duration / 60) << "min";
+    });
+    
+    QObject::connect(influxClient, &InfluxDBClient::parkingSessionEnded,
+        [](int sessionId, const QDateTime& endTime, qint64 duration) {
+        qDebug() << "🅿️ PARKING SESSION" << sessionId << "ENDED at" << endTime.toString()
+                 << "after" << (duration / 60) << "min";
+    });
+    
+    // Optional push ingest: accept line protocol writes locally instead of polling
+    quint16 ingestHttpPort = qEnvironmentVariableIntValue("INGEST_HTTP_PORT");
+    quint16 ingestUdpPort = qEnvironmentVariableIntValue("INGEST_UDP_PORT");
+    if (ingestHttpPort > 0 || ingestUdpPort > 0) {
+        // Localhost only unless another address is asked for
+        const QHostAddress ingestAddress(qEnvironmentVariable("INGEST_BIND_ADDRESS", "127.0.0.1"));
+        const QByteArray ingestToken = qgetenv("INGEST_TOKEN");
+        LineProtocolListener *listener = new LineProtocolListener(&app);
+        listener->setAuthToken(ingestToken);
+        bool listening = false;
+        if (ingestAddress.isNull()) {
+            qDebug() << "Push ingest: INGEST_BIND_ADDRESS" << qEnvironmentVariable("INGEST_BIND_ADDRESS")
+                     << "is not an IP address, not listening";
+        } else if (ingestHttpPort > 0) {
+            if (!ingestAddress.isLoopback() && ingestToken.isEmpty()) {
+                qDebug() << "Push ingest: INGEST_TOKEN is required to accept HTTP writes on" << ingestAddress.toString();
+            } else {
+                listening |= listener->listenHttp(ingestHttpPort, ingestAddress);
+            }
+        }
+        if (!ingestAddress.isNull() && ingestUdpPort > 0) {
+            if (!ingestAddress.isLoopback()) {
+                qDebug() << "Push ingest: UDP writes on" << ingestAddress.toString() << "are not authenticated";
+            }
+            listening |= listener->listenUdp(ingestUdpPort, ingestAddress);
+        }
+        if (listening) {
+            QObject::connect(listener, &LineProtocolListener::samplesReceived,
+                             influxClient, &InfluxDBClient::ingestSamples);
+            influxClient->setPushIngestEnabled(true);
+        }
+    }
+    
+#ifdef HAVE_QT_MQTT
+    // Optional MQTT ingest: subscribe to the raw vehicle topics on a broker
+    QString mqttHost = qEnvironmentVariable("MQTT_HOST");
+    if (!mqttHost.isEmpty()) {
+        MqttIngest *mqttIngest = new MqttIngest(&app);
+        quint16 mqttPort = qEnvironmentVariableIntValue("MQTT_PORT");
+        mqttIngest->setBroker(mqttHost, mqttPort > 0 ? mqttPort : 1883);
+        mqttIngest->setCredentials(qEnvironmentVariable("MQTT_USERNAME"), qEnvironmentVariable("MQTT_PASSWORD"));
+        mqttIngest->setVehicleId(qEnvironmentVariable("MQTT_VEHICLE_ID", "1"));
+        QObject::connect(mqttIngest, &MqttIngest::samplesReceived,
+                         influxClient, &InfluxDBClient::ingestSamples);
+        influxClient->setPushIngestEnabled(true);
+        mqttIngest->start();
+    }
+#endif
+    
     // Start trip analysis
     influxClient->startDataCollection();
     
@@ -67,6 +147,11 @@ int main(int argc, char *argv[])
         []() { QCoreApplication::exit(-1); },
         Qt::QueuedConnection);
     
+    // Trip list for views, rows are paged in as they scroll
+    TripListModel *tripListModel = new TripListModel(influxClient, &app);
+    engine.rootContext()->setContextProperty("influxClient", influxClient);
+    engine.rootContext()->setContextProperty("tripListModel", tripListModel);
+    
     // For now, we'll run without loading QML since we're focusing on terminal output
     // engine.loadFromModule("dataHandler", "Main");
 
@@ -0,0 +1,112 @@
+#include "motionsegmentation.h"
+#include <QtAlgorithms>
+
+#include "cpufeatures.h"
+
+namespace {
+
+const int BLOCK_SIZE = 64; // one bit per point in a quint64
+
+using MaskFunction = quint64 (*)(const double *speeds, double threshold);
+
+// Bit i is set when speeds[i] > threshold, for a partial block at the end
+quint64 aboveMaskScalar(const double *speeds, int count, double threshold)
+{
+    quint64 mask = 0;
+    for (int i = 0; i < count; ++i) {
+        mask |= quint64(speeds[i] > threshold) << i;
+    }
+    return mask;
+}
+
+quint64 aboveMaskBlockScalar(const double *speeds, double threshold)
+{
+    return aboveMaskScalar(speeds, BLOCK_SIZE, threshold);
+}
+
+#ifdef CPU_FEATURES_AVX2
+// Built for AVX2 regardless of the compiler flags, only called after a CPU check
+CPU_FEATURES_TARGET_AVX2
+quint64 aboveMaskBlockAvx2(const double *speeds, double threshold)
+{
+    const __m256d limit = _mm256_set1_pd(threshold);
+    quint64 mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 4) {
+        // Ordered compare, NaN never counts as moving
+        const __m256d above = _mm256_cmp_pd(_mm256_loadu_pd(speeds + i), limit, _CMP_GT_OQ);
+        mask |= quint64(_mm256_movemask_pd(above)) << i;
+    }
+    return mask;
+}
+#endif
+
+#ifdef CPU_FEATURES_NEON
+quint64 aboveMaskBlockNeon(const double *speeds, double threshold)
+{
+    const float64x2_t limit = vdupq_n_f64(threshold);
+    quint64 mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 2) {
+        const uint64x2_t above = vcgtq_f64(vld1q_f64(speeds + i), limit);
+        mask |= (vgetq_lane_u64(above, 0) & 1) << i;
+        mask |= (vgetq_lane_u64(above, 1) & 1) << (i + 1);
+    }
+    return mask;
+}
+#endif
+
+const CpuFeatures::Kernel<MaskFunction> &kernel()
+{
+    static const CpuFeatures::Kernel<MaskFunction> selected = CpuFeatures::select<MaskFunction>(
+        CPU_FEATURES_IF_AVX2(aboveMaskBlockAvx2), CPU_FEATURES_IF_NEON(aboveMaskBlockNeon), aboveMaskBlockScalar);
+    return selected;
+}
+
+} // namespace
+
+QList<MotionSegment> MotionSegmentation::segment(const double *speeds, qsizetype count,
+                                                 double enterAbove, double stayAbove, bool& moving)
+{
+    QList<MotionSegment> segments;
+    if (count <= 0) return segments;
+
+    const MaskFunction maskOf = kernel().function;
+    const bool deadband = enterAbove != stayAbove;
+    qsizetype runStart = 0;
+
+    for (qsizetype block = 0; block < count; block += BLOCK_SIZE) {
+        const int size = int(qMin(qsizetype(BLOCK_SIZE), count - block));
+        const quint64 valid = size == BLOCK_SIZE ? ~quint64(0) : (quint64(1) << size) - 1;
+        const quint64 enter = size == BLOCK_SIZE ? maskOf(speeds + block, enterAbove)
+                                                 : aboveMaskScalar(speeds + block, size, enterAbove);
+        const quint64 stay = !deadband ? enter
+                             : size == BLOCK_SIZE ? maskOf(speeds + block, stayAbove)
+                                                  : aboveMaskScalar(speeds + block, size, stayAbove);
+
+        // Walk the flips: a stopped run ends at the next 'enter' bit, a moving
+        // run at the next cleared 'stay' bit; whole-block runs cost one test
+        quint64 remaining = valid;
+        while (true) {
+            const quint64 flips = (moving ? ~stay : enter) & remaining;
+            if (!flips) break;
+
+            const int bit = qCountTrailingZeroBits(flips);
+            const qsizetype index = block + bit;
+            if (index > runStart) {
+                segments.append({ runStart, index, moving });
+            }
+            runStart = index;
+            moving = !moving;
+            remaining = valid & (~quint64(0) << bit);
+            // The flipped point itself belongs to the new run and is consumed by it
+            remaining &= ~(quint64(1) << bit);
+        }
+    }
+
+    segments.append({ runStart, count, moving });
+    return segments;
+}
+
+const char *MotionSegmentation::implementation()
+{
+    return kernel().name;
+}
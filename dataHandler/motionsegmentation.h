@@ -0,0 +1,34 @@
+#ifndef MOTIONSEGMENTATION_H
+#define MOTIONSEGMENTATION_H
+
+#include <QList>
+
+// A maximal run of points that are all moving or all stopped, [begin, end)
+struct MotionSegment {
+    qsizetype begin;
+    qsizetype end;
+    bool moving;
+
+    qsizetype size() const { return end - begin; }
+};
+
+// Vectorized pre-pass for trip detection: turns a speed column into run-length
+// segments of moving and stopped points. Speeds are compared 64 at a time into
+// bit masks (AVX2 or NEON when available, scalar otherwise) and only the bits
+// where the state flips produce work, so long parked or driving stretches cost
+// little more than reading them.
+namespace MotionSegmentation {
+
+// A stopped point starts moving when its speed is above enterAbove, a moving one
+// keeps moving while its speed is above stayAbove (enterAbove >= stayAbove gives
+// a deadband, equal values a plain threshold). 'moving' is the state before the
+// first point and is updated to the state after the last one.
+QList<MotionSegment> segment(const double *speeds, qsizetype count,
+                             double enterAbove, double stayAbove, bool& moving);
+
+// Name of the kernel selected for this CPU, for logging
+const char *implementation();
+
+} // namespace MotionSegmentation
+
+#endif // MOTIONSEGMENTATION_H
@@ -0,0 +1,124 @@
+#include "mqttingest.h"
+#include "telemetryconversion.h"
+#include <QDebug>
+
+using namespace TelemetryConversion;
+
+MqttIngest::MqttIngest(QObject *parent)
+    : QObject(parent)
+    , m_client(new QMqttClient(this))
+    , m_reconnectTimer(new QTimer(this))
+    , m_flushTimer(new QTimer(this))
+    , m_vehicleId("1")
+    , m_running(false)
+    , m_reconnectDelayMs(RECONNECT_MIN_DELAY_MS)
+{
+    m_client->setHostname("localhost");
+    m_client->setPort(1883);
+
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, m_client, [this]() { m_client->connectToHost(); });
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(0);
+    connect(m_flushTimer, &QTimer::timeout, this, &MqttIngest::flushSamples);
+
+    connect(m_client, &QMqttClient::connected, this, &MqttIngest::onConnected);
+    connect(m_client, &QMqttClient::disconnected, this, &MqttIngest::onDisconnected);
+    connect(m_client, &QMqttClient::messageReceived, this, &MqttIngest::onMessageReceived);
+}
+
+void MqttIngest::setBroker(const QString& hostname, quint16 port)
+{
+    m_client->setHostname(hostname);
+    m_client->setPort(port);
+}
+
+void MqttIngest::setCredentials(const QString& username, const QString& password)
+{
+    m_client->setUsername(username);
+    m_client->setPassword(password);
+}
+
+bool MqttIngest::setVehicleId(const QString& vehicleId)
+{
+    if (vehicleId.isEmpty() || vehicleId.contains('+') || vehicleId.contains('#') || vehicleId.contains('/')) {
+        qDebug() << "MqttIngest: Invalid vehicle id" << vehicleId << "- keeping" << m_vehicleId;
+        return false;
+    }
+    m_vehicleId = vehicleId;
+    return true;
+}
+
+void MqttIngest::start()
+{
+    m_running = true;
+    m_reconnectDelayMs = RECONNECT_MIN_DELAY_MS;
+    qDebug() << "MqttIngest: Connecting to" << m_client->hostname() << ":" << m_client->port();
+    m_client->connectToHost();
+}
+
+void MqttIngest::stop()
+{
+    m_running = false;
+    m_reconnectTimer->stop();
+    m_client->disconnectFromHost();
+    flushSamples();
+}
+
+void MqttIngest::onConnected()
+{
+    qDebug() << "MqttIngest: Connected, subscribing to vehicle" << m_vehicleId;
+    m_reconnectDelayMs = RECONNECT_MIN_DELAY_MS;
+
+    const RawTopic kinds[] = { RawTopic::Speed, RawTopic::StateOfCharge, RawTopic::AutonomyLevel };
+    for (RawTopic kind : kinds) {
+        const QString topic = rawTopicName(kind, m_vehicleId);
+        if (!m_client->subscribe(QMqttTopicFilter(topic), 0)) {
+            qDebug() << "MqttIngest: Failed to subscribe to" << topic;
+        }
+    }
+
+    emit connectionChanged(true);
+}
+
+void MqttIngest::onDisconnected()
+{
+    qDebug() << "MqttIngest: Disconnected from broker, error:" << m_client->error();
+    emit connectionChanged(false);
+
+    if (!m_running) return;
+
+    // Reconnect with exponential back-off
+    qDebug() << "MqttIngest: Reconnecting in" << m_reconnectDelayMs << "ms";
+    m_reconnectTimer->start(m_reconnectDelayMs);
+    m_reconnectDelayMs = qMin(m_reconnectDelayMs * 2, int(RECONNECT_MAX_DELAY_MS));
+}
+
+void MqttIngest::onMessageReceived(const QByteArray& message, const QMqttTopicName& topic)
+{
+    const QString topicName = topic.name();
+    const RawTopic kind = rawTopicKind(topicName);
+
+    double value = 0.0;
+    if (!convertRawValue(kind, message, value)) {
+        qDebug() << "MqttIngest: Ignoring payload" << message << "on" << topicName;
+        return;
+    }
+
+    // MQTT carries no timestamp, the broker delivers in real time
+    m_pendingSamples.append(TelemetrySample(treatedMeasurement(topicName),
+                                            QDateTime::currentDateTimeUtc(), value));
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void MqttIngest::flushSamples()
+{
+    if (m_pendingSamples.isEmpty()) return;
+
+    QList<TelemetrySample> samples;
+    samples.swap(m_pendingSamples);
+    emit samplesReceived(samples);
+}
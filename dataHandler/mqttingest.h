@@ -0,0 +1,57 @@
+#ifndef MQTTINGEST_H
+#define MQTTINGEST_H
+
+#include <QObject>
+#include <QTimer>
+#include <QList>
+#include <QtMqtt/QMqttClient>
+
+#include "tripdata.h"
+
+// Subscribes to the raw Vehicle/<id>/... topics on an MQTT broker and converts
+// the payloads in-process (RPM -> m/s, SoC clipping), so samples reach the trip
+// detector without the broker -> InfluxDB bridge and the ETL in between.
+class MqttIngest : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MqttIngest(QObject *parent = nullptr);
+
+    void setBroker(const QString& hostname, quint16 port);
+    void setCredentials(const QString& username, const QString& password);
+    // Vehicle id to subscribe to. The samples go to a single vehicle's trips,
+    // so topic wildcards ("+", "#") and empty ids are refused, keeping the old id
+    bool setVehicleId(const QString& vehicleId);
+
+    void start();
+    void stop();
+
+    bool isConnected() const { return m_client->state() == QMqttClient::Connected; }
+
+signals:
+    void samplesReceived(const QList<TelemetrySample>& samples);
+    void connectionChanged(bool connected);
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onMessageReceived(const QByteArray& message, const QMqttTopicName& topic);
+    void flushSamples();
+
+private:
+    QMqttClient *m_client;
+    QTimer *m_reconnectTimer;
+    QTimer *m_flushTimer;
+    QString m_vehicleId;
+    bool m_running;
+    int m_reconnectDelayMs;
+
+    // Messages arriving in one event loop pass are handed over as one batch
+    QList<TelemetrySample> m_pendingSamples;
+
+    static const int RECONNECT_MIN_DELAY_MS = 1000;
+    static const int RECONNECT_MAX_DELAY_MS = 60000;
+};
+
+#endif // MQTTINGEST_H
@@ -0,0 +1,465 @@
+#include "resamplingetl.h"
+#include <QNetworkRequest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QTimeZone>
+#include <QDebug>
+
+using namespace TelemetryConversion;
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static qint64 daysFromCivil(qint64 year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = unsigned(year - era * 400);
+    const unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + qint64(dayOfEra) - 719468;
+}
+
+static bool parseDigits(QByteArrayView text, qsizetype pos, int count, int& value)
+{
+    value = 0;
+    for (int i = 0; i < count; ++i) {
+        const char c = text[pos + i];
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// RFC 3339 timestamps as returned by the query API, without going through QDateTime
+static bool parseRfc3339(QByteArrayView text, qint64& msecs)
+{
+    if (text.size() < 20 || text[4] != '-' || text[7] != '-' || text[10] != 'T'
+        || text[13] != ':' || text[16] != ':') {
+        return false;
+    }
+
+    int year, month, day, hour, minute, second;
+    if (!parseDigits(text, 0, 4, year) || !parseDigits(text, 5, 2, month) || !parseDigits(text, 8, 2, day)
+        || !parseDigits(text, 11, 2, hour) || !parseDigits(text, 14, 2, minute)
+        || !parseDigits(text, 17, 2, second)) {
+        return false;
+    }
+
+    qsizetype pos = 19;
+    int millis = 0;
+    if (text[pos] == '.') {
+        ++pos;
+        int digits = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            if (digits < 3) millis = millis * 10 + (text[pos] - '0');
+            ++digits;
+            ++pos;
+        }
+        for (; digits < 3; ++digits) millis *= 10;
+    }
+
+    qint64 offsetSecs = 0;
+    if (pos >= text.size()) return false;
+    if (text[pos] == '+' || text[pos] == '-') {
+        int offsetHours, offsetMinutes;
+        if (pos + 6 > text.size() || !parseDigits(text, pos + 1, 2, offsetHours)
+            || !parseDigits(text, pos + 4, 2, offsetMinutes)) {
+            return false;
+        }
+        offsetSecs = (offsetHours * 3600 + offsetMinutes * 60) * (text[pos] == '+' ? 1 : -1);
+    } else if (text[pos] != 'Z' && text[pos] != 'z') {
+        return false;
+    }
+
+    const qint64 days = daysFromCivil(year, unsigned(month), unsigned(day));
+    msecs = ((days * 86400 + hour * 3600 + minute * 60 + second) - offsetSecs) * 1000 + millis;
+    return true;
+}
+
+ResamplingEtl::ResamplingEtl(const Config& config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_networkManager(new QNetworkAccessManager(this))
+    , m_topicIndex(-1)
+    , m_success(true)
+    , m_timeIndex(-1)
+    , m_valueIndex(-1)
+    , m_queryStartedSecs(0)
+    , m_rowsRead(0)
+    , m_rowsRejected(0)
+    , m_windowStart(-1)
+    , m_windowSum(0.0)
+    , m_windowCount(0)
+    , m_nextWatermark(0)
+    , m_writer(nullptr)
+    , m_pointsWritten(0)
+    , m_lostLinesAtTopicStart(0)
+    , m_queryFailed(false)
+    , m_queryFinished(false)
+    , m_queryDone(false)
+{
+    // Topic mapping: raw -> treated, as in DataTreatment/main.py
+    const RawTopic kinds[] = { RawTopic::Speed, RawTopic::StateOfCharge, RawTopic::AutonomyLevel };
+    for (RawTopic kind : kinds) {
+        EtlTopic topic;
+        topic.source = rawTopicName(kind, m_config.vehicleId);
+        topic.target = treatedMeasurement(topic.source);
+        topic.kind = kind;
+        m_topics.append(topic);
+    }
+
+    if (m_config.windowSeconds < 1) m_config.windowSeconds = 1;
+
+    LineProtocolWriter::Config writerConfig;
+    writerConfig.url = m_config.url;
+    writerConfig.token = m_config.token;
+    writerConfig.org = m_config.org;
+    writerConfig.bucket = m_config.bucket;
+    writerConfig.precision = "s";
+    writerConfig.maxBatchLines = m_config.batchLines;
+    writerConfig.maxInFlight = m_config.maxWritesInFlight;
+    m_writer = new LineProtocolWriter(writerConfig, this);
+    connect(m_writer, &LineProtocolWriter::backPressureChanged, this, &ResamplingEtl::onBackPressureChanged);
+    connect(m_writer, &LineProtocolWriter::drained, this, &ResamplingEtl::onWriterDrained);
+}
+
+void ResamplingEtl::run()
+{
+    loadWatermarks();
+    m_topicIndex = -1;
+    m_success = true;
+    startNextTopic();
+}
+
+void ResamplingEtl::startNextTopic()
+{
+    ++m_topicIndex;
+    if (m_topicIndex >= m_topics.size()) {
+        finishRun();
+        return;
+    }
+
+    const EtlTopic& topic = m_topics[m_topicIndex];
+
+    // Reset per-topic state
+    m_lineBuffer.clear();
+    m_timeIndex = -1;
+    m_valueIndex = -1;
+    m_rowsRead = 0;
+    m_rowsRejected = 0;
+    m_windowStart = -1;
+    m_windowSum = 0.0;
+    m_windowCount = 0;
+    m_queryFailed = false;
+    m_queryFinished = false;
+    m_queryDone = false;
+    m_pointsWritten = 0;
+    m_lostLinesAtTopicStart = m_writer->linesFailed() + m_writer->linesDropped();
+    m_targetMeasurement = LineProtocolPoint(topic.target).toLineProtocol();
+
+    // Resume from the watermark, but never look further back than the lookback window
+    m_queryStartedSecs = QDateTime::currentSecsSinceEpoch();
+    qint64 startSecs = m_queryStartedSecs - qint64(m_config.lookbackDays) * 86400;
+    if (m_watermarks.contains(topic.target)) {
+        startSecs = qMax(startSecs, m_watermarks.value(topic.target));
+    }
+    startSecs -= startSecs % m_config.windowSeconds;
+    m_nextWatermark = startSecs;
+
+    const QString startTime = QDateTime::fromSecsSinceEpoch(startSecs, QTimeZone::UTC).toString(Qt::ISODate);
+    QString fluxQuery = QString(
+        "from(bucket: \"%1\")"
+        " |> range(start: %2)"
+        " |> filter(fn: (r) => r[\"_measurement\"] == \"%3\" and r[\"_field\"] == \"value\")"
+        " |> keep(columns: [\"_time\", \"_value\"])"
+        " |> sort(columns: [\"_time\"])"
+    ).arg(m_config.bucket, startTime, topic.source);
+
+    qDebug() << "ResamplingEtl: Processing topic:" << topic.source << "→" << topic.target << "from" << startTime;
+
+    QNetworkRequest request;
+    request.setUrl(QUrl(m_config.url + "/api/v2/query?org=" + m_config.org));
+    request.setRawHeader("Authorization", QString("Token %1").arg(m_config.token).toUtf8());
+    request.setRawHeader("Content-Type", "application/vnd.flux");
+    request.setRawHeader("Accept", "application/csv");
+
+    m_queryReply = m_networkManager->post(request, fluxQuery.toUtf8());
+    m_queryReply->setReadBufferSize(QUERY_READ_BUFFER_BYTES);
+    connect(m_queryReply, &QNetworkReply::readyRead, this, &ResamplingEtl::onQueryReadyRead);
+    connect(m_queryReply, &QNetworkReply::finished, this, &ResamplingEtl::onQueryFinished);
+}
+
+void ResamplingEtl::onQueryReadyRead()
+{
+    // While the writer is back-pressured the data stays in the reply's bounded
+    // read buffer, which in turn throttles the download
+    if (!m_queryReply || m_writer->isBackPressured()) return;
+
+    m_lineBuffer.append(m_queryReply->readAll());
+    consumeLines(false);
+}
+
+bool ResamplingEtl::consumeLines(bool atEnd)
+{
+    qsizetype lineStart = 0;
+    for (;;) {
+        if (m_writer->isBackPressured()) {
+            m_lineBuffer.remove(0, lineStart);
+            return false;
+        }
+
+        qsizetype lineEnd = m_lineBuffer.indexOf('\n', lineStart);
+        if (lineEnd < 0) break;
+
+        qsizetype end = lineEnd;
+        if (end > lineStart && m_lineBuffer[end - 1] == '\r') --end;
+        consumeLine(QByteArrayView(m_lineBuffer.constData() + lineStart, end - lineStart));
+        lineStart = lineEnd + 1;
+    }
+
+    // Keep the incomplete tail for the next chunk
+    m_lineBuffer.remove(0, lineStart);
+
+    if (atEnd && !m_lineBuffer.isEmpty()) {
+        QByteArrayView tail(m_lineBuffer);
+        if (tail.endsWith('\r')) tail.chop(1);
+        consumeLine(tail);
+        m_lineBuffer.clear();
+    }
+    return true;
+}
+
+void ResamplingEtl::consumeLine(QByteArrayView line)
+{
+    if (line.isEmpty()) return; // separator between result tables
+
+    // Every result table starts with its own header row
+    if (line.startsWith(",result,") || line.startsWith("result,")) {
+        const QList<QByteArray> headers = line.toByteArray().split(',');
+        m_timeIndex = headers.indexOf("_time");
+        m_valueIndex = headers.indexOf("_value");
+        return;
+    }
+    if (m_timeIndex < 0 || m_valueIndex < 0) return;
+
+    // Locate the two columns; the value may contain commas when it is the last column
+    QByteArrayView timeField;
+    QByteArrayView valueField;
+    bool haveTime = false;
+    bool haveValue = false;
+    qsizetype fieldStart = 0;
+    int field = 0;
+    for (qsizetype i = 0; i <= line.size() && !(haveTime && haveValue); ++i) {
+        if (i < line.size() && line[i] != ',') continue;
+
+        if (field == m_timeIndex) {
+            timeField = line.sliced(fieldStart, i - fieldStart);
+            haveTime = true;
+        } else if (field == m_valueIndex) {
+            valueField = m_valueIndex > m_timeIndex ? line.sliced(fieldStart)
+                                                    : line.sliced(fieldStart, i - fieldStart);
+            haveValue = true;
+        }
+        ++field;
+        fieldStart = i + 1;
+    }
+
+    ++m_rowsRead;
+
+    qint64 msecs = 0;
+    double value = 0.0;
+    if (!haveTime || !haveValue || !parseRfc3339(timeField, msecs)
+        || !convertRawValue(m_topics[m_topicIndex].kind, valueField, value)) {
+        ++m_rowsRejected;
+        return;
+    }
+
+    addSample(msecs, value);
+}
+
+void ResamplingEtl::addSample(qint64 msecs, double value)
+{
+    qint64 seconds = msecs / 1000;
+    qint64 windowStart = seconds - seconds % m_config.windowSeconds;
+
+    if (m_windowStart >= 0 && windowStart != m_windowStart) {
+        if (windowStart < m_windowStart) {
+            // Input is sorted by time, anything older belongs to a window already written
+            ++m_rowsRejected;
+            return;
+        }
+        emitWindow();
+    }
+
+    if (m_windowStart < 0) {
+        m_windowStart = windowStart;
+        m_windowSum = 0.0;
+        m_windowCount = 0;
+    }
+
+    m_windowSum += value;
+    m_windowCount++;
+}
+
+void ResamplingEtl::emitWindow()
+{
+    if (m_windowStart < 0 || m_windowCount == 0) return;
+
+    // An overflowing sum cannot be written as line protocol, the window is skipped
+    const double average = m_windowSum / m_windowCount;
+    if (qIsFinite(average)) {
+        QByteArray line = m_targetMeasurement;
+        line += " value=";
+        line += QByteArray::number(average, 'g', 12);
+        line += ' ';
+        line += QByteArray::number(m_windowStart);
+
+        // Input is paused while the writer is back-pressured, so this is never rejected
+        if (m_writer->writeLine(line)) {
+            m_pointsWritten++;
+        }
+    }
+
+    m_nextWatermark = m_windowStart + m_config.windowSeconds;
+    m_windowStart = -1;
+}
+
+void ResamplingEtl::onBackPressureChanged(bool backPressured)
+{
+    if (backPressured || m_topicIndex < 0 || m_topicIndex >= m_topics.size()) return;
+
+    // Resume reading where consumeLines() stopped
+    if (m_queryFinished) {
+        completeQuery();
+    } else if (m_queryReply) {
+        onQueryReadyRead();
+    }
+}
+
+void ResamplingEtl::onWriterDrained()
+{
+    if (m_queryDone) {
+        finishTopic();
+    }
+}
+
+void ResamplingEtl::onQueryFinished()
+{
+    QNetworkReply *reply = m_queryReply;
+    if (!reply) return;
+    m_queryReply = nullptr;
+
+    const EtlTopic& topic = m_topics[m_topicIndex];
+
+    if (reply->error() != QNetworkReply::NoError) {
+        qDebug() << "ResamplingEtl: Query for" << topic.source << "failed:" << reply->errorString();
+        m_queryFailed = true;
+        m_windowStart = -1;
+        m_lineBuffer.clear();
+    } else {
+        m_lineBuffer.append(reply->readAll());
+    }
+    reply->deleteLater();
+
+    m_queryFinished = true;
+    completeQuery();
+}
+
+void ResamplingEtl::completeQuery()
+{
+    if (m_queryDone) return;
+
+    if (!m_queryFailed) {
+        if (!consumeLines(true)) {
+            return; // writer is back-pressured, continue in onBackPressureChanged()
+        }
+
+        // The newest window may still be filling up; hold it back for the next run
+        const qint64 settledBefore = m_queryStartedSecs - m_config.settleSeconds;
+        if (m_windowStart >= 0) {
+            if (m_windowStart + m_config.windowSeconds <= settledBefore) {
+                emitWindow();
+            } else {
+                m_nextWatermark = m_windowStart;
+                m_windowStart = -1;
+            }
+        } else if (m_rowsRead == m_rowsRejected) {
+            // Nothing usable in range: skip it next time, except for the unsettled tail
+            qint64 settledWindow = settledBefore - settledBefore % m_config.windowSeconds;
+            m_nextWatermark = qMax(m_nextWatermark, settledWindow);
+        }
+
+        qDebug() << "ResamplingEtl: Read" << m_rowsRead << "rows from" << m_topics[m_topicIndex].source
+                 << "(" << m_rowsRejected << "rejected)";
+    }
+
+    // finishTopic() runs from onWriterDrained() once the last batch is acknowledged
+    m_queryDone = true;
+    m_writer->flush();
+}
+
+void ResamplingEtl::finishTopic()
+{
+    const EtlTopic& topic = m_topics[m_topicIndex];
+
+    m_queryDone = false;
+
+    const qint64 lostLines = m_writer->linesFailed() + m_writer->linesDropped() - m_lostLinesAtTopicStart;
+    if (m_queryFailed || lostLines > 0) {
+        qDebug() << "ResamplingEtl: Topic" << topic.source << "failed (" << lostLines
+                 << "lines not written), watermark not advanced";
+        m_success = false;
+    } else {
+        m_watermarks.insert(topic.target, m_nextWatermark);
+        if (!saveWatermarks()) {
+            m_success = false;
+        }
+        qDebug() << "ResamplingEtl: Wrote" << m_pointsWritten << "points to" << topic.target
+                 << "- watermark now" << QDateTime::fromSecsSinceEpoch(m_nextWatermark, QTimeZone::UTC).toString(Qt::ISODate);
+    }
+
+    startNextTopic();
+}
+
+void ResamplingEtl::finishRun()
+{
+    qDebug() << (m_success ? "ResamplingEtl: ✅ Done." : "ResamplingEtl: Finished with errors.");
+    emit finished(m_success);
+}
+
+void ResamplingEtl::loadWatermarks()
+{
+    m_watermarks.clear();
+
+    QFile file(m_config.watermarkPath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    const QJsonObject object = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        m_watermarks.insert(it.key(), it.value().toInteger());
+    }
+    qDebug() << "ResamplingEtl: Loaded" << m_watermarks.size() << "watermarks from" << m_config.watermarkPath;
+}
+
+bool ResamplingEtl::saveWatermarks()
+{
+    QJsonObject object;
+    for (auto it = m_watermarks.constBegin(); it != m_watermarks.constEnd(); ++it) {
+        object.insert(it.key(), it.value());
+    }
+
+    QDir().mkpath(QFileInfo(m_config.watermarkPath).absolutePath());
+
+    // Written atomically so an interrupted run never leaves a truncated file
+    QSaveFile file(m_config.watermarkPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "ResamplingEtl: Cannot write watermarks:" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(object).toJson());
+    return file.commit();
+}
@@ -0,0 +1,107 @@
+#ifndef RESAMPLINGETL_H
+#define RESAMPLINGETL_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+#include <QHash>
+#include <QList>
+
+#include "telemetryconversion.h"
+#include "lineprotocolwriter.h"
+
+// One raw topic and the treated series it is resampled into
+struct EtlTopic {
+    QString source;  // e.g. "Vehicle/1/Speed"
+    QString target;  // e.g. "Vehicle/1/qt/speed"
+    TelemetryConversion::RawTopic kind;
+};
+
+// Native replacement for DataTreatment/main.py. Each raw topic is streamed out
+// of InfluxDB line by line, converted, averaged into fixed windows in a single
+// pass and handed to a LineProtocolWriter, which posts them as large gzipped
+// batches; reading pauses while the writer is back-pressured. A per-topic watermark
+// remembers the first window that has not been written yet, so later runs only
+// query and resample new data.
+class ResamplingEtl : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Config {
+        QString url;
+        QString token;
+        QString org;
+        QString bucket;
+        QString vehicleId = "1";
+        int lookbackDays = 10;        // used when a topic has no watermark yet
+        int windowSeconds = 1;        // resampling window
+        int settleSeconds = 10;       // windows this close to "now" may still receive data
+        int batchLines = 5000;        // lines per write request
+        int maxWritesInFlight = 4;
+        QString watermarkPath;
+    };
+
+    explicit ResamplingEtl(const Config& config, QObject *parent = nullptr);
+
+    void run();
+
+signals:
+    void finished(bool success);
+
+private slots:
+    void onQueryReadyRead();
+    void onQueryFinished();
+    void onBackPressureChanged(bool backPressured);
+    void onWriterDrained();
+
+private:
+    void startNextTopic();
+    bool consumeLines(bool atEnd);
+    void consumeLine(QByteArrayView line);
+    void addSample(qint64 msecs, double value);
+    void emitWindow();
+    void completeQuery();
+    void finishTopic();
+    void finishRun();
+
+    void loadWatermarks();
+    bool saveWatermarks();
+
+    Config m_config;
+    QNetworkAccessManager *m_networkManager;
+    QList<EtlTopic> m_topics;
+    int m_topicIndex;
+    bool m_success;
+
+    // Streaming query state
+    QPointer<QNetworkReply> m_queryReply;
+    QByteArray m_lineBuffer;
+    int m_timeIndex;
+    int m_valueIndex;
+    qint64 m_queryStartedSecs;
+    qint64 m_rowsRead;
+    qint64 m_rowsRejected;
+
+    // Current resampling window
+    qint64 m_windowStart;   // seconds, -1 when no window is open
+    double m_windowSum;
+    int m_windowCount;
+    qint64 m_nextWatermark; // seconds, first window not written yet
+
+    // Output
+    LineProtocolWriter *m_writer;
+    QByteArray m_targetMeasurement; // escaped for line protocol
+    qint64 m_pointsWritten;
+    qint64 m_lostLinesAtTopicStart;
+    bool m_queryFailed;
+    bool m_queryFinished;  // reply complete, m_lineBuffer holds the rest
+    bool m_queryDone;      // everything consumed and handed to the writer
+
+    static const qint64 QUERY_READ_BUFFER_BYTES = 4 * 1024 * 1024;
+
+    QHash<QString, qint64> m_watermarks; // target measurement -> seconds since epoch
+};
+
+#endif // RESAMPLINGETL_H
@@ -0,0 +1,303 @@
+#include "sessiondetector.h"
+
+static QDateTime fromMsecs(qint64 msecs)
+{
+    return QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::UTC);
+}
+
+static void writeSession(QDataStream& out, const SessionInfo& session)
+{
+    out << qint32(session.sessionId) << session.startTime << session.endTime
+        << session.startCharge << session.endCharge << session.durationSeconds;
+}
+
+static SessionInfo readSession(QDataStream& in)
+{
+    SessionInfo session;
+    qint32 sessionId = -1;
+    in >> sessionId >> session.startTime >> session.endTime
+       >> session.startCharge >> session.endCharge >> session.durationSeconds;
+    session.sessionId = sessionId;
+    return session;
+}
+
+SessionDetectorConfig SessionDetectorConfig::fromEnvironment()
+{
+    SessionDetectorConfig config;
+    bool ok = false;
+
+    int seconds = qEnvironmentVariableIntValue("PARKING_MIN_SECONDS", &ok);
+    if (ok && seconds > 0) config.parkingMinSeconds = seconds;
+    seconds = qEnvironmentVariableIntValue("CHARGING_END_SECONDS", &ok);
+    if (ok && seconds > 0) config.chargingEndSeconds = seconds;
+
+    const double rise = qEnvironmentVariable("CHARGING_MIN_RISE_PERCENT").toDouble(&ok);
+    if (ok && rise > 0.0) config.chargingMinRisePercent = rise;
+    return config;
+}
+
+ParkingMachine::ParkingMachine(const SessionDetectorConfig& config)
+    : m_minMsecs(qint64(config.parkingMinSeconds) * 1000)
+{
+    reset(1);
+}
+
+void ParkingMachine::reset(int firstSessionId)
+{
+    m_sessions.clear();
+    m_nextSessionId = firstSessionId;
+    m_standing = false;
+    m_open = false;
+    m_startMsecs = 0;
+    m_startCharge = qQNaN();
+    m_lastMsecs = 0;
+    m_lastCharge = qQNaN();
+}
+
+void ParkingMachine::processStopped(const qint64 *msecs, const double *charges, qsizetype count,
+                                    QList<SessionEvent>& events)
+{
+    if (count <= 0) return;
+
+    if (!m_standing) {
+        m_standing = true;
+        m_startMsecs = msecs[0];
+        m_startCharge = qQNaN();
+    }
+    m_lastMsecs = msecs[count - 1];
+
+    // Unknown charge (NaN) is skipped: the session takes the first and the
+    // last reading, the last one carries over from before when there is none
+    if (qIsNaN(m_startCharge)) {
+        for (qsizetype i = 0; i < count; ++i) {
+            if (!qIsNaN(charges[i])) {
+                m_startCharge = charges[i];
+                break;
+            }
+        }
+    }
+    for (qsizetype i = count - 1; i >= 0; --i) {
+        if (!qIsNaN(charges[i])) {
+            m_lastCharge = charges[i];
+            break;
+        }
+    }
+
+    if (!m_open && m_lastMsecs - m_startMsecs >= m_minMsecs) {
+        m_open = true;
+
+        SessionInfo session;
+        session.sessionId = m_nextSessionId++;
+        session.startTime = fromMsecs(m_startMsecs);
+        session.startCharge = m_startCharge;
+        m_sessions.append(session);
+        events.append(SessionEvent(SessionEvent::Parking, SessionEvent::Started, m_sessions.size() - 1));
+    }
+    if (m_open) {
+        // Opened before the first reading arrived
+        if (qIsNaN(m_sessions.last().startCharge)) {
+            m_sessions.last().startCharge = m_startCharge;
+        }
+        m_sessions.last().endCharge = m_lastCharge;
+    }
+}
+
+void ParkingMachine::processMoving(qint64 msecs, QList<SessionEvent>& events)
+{
+    // Parked until the moment it moved, or until the data resumed with movement
+    if (m_open) {
+        end(msecs, events);
+    }
+    m_standing = false;
+}
+
+void ParkingMachine::end(qint64 msecs, QList<SessionEvent>& events)
+{
+    SessionInfo& session = m_sessions.last();
+    session.endTime = fromMsecs(msecs);
+    session.endCharge = m_lastCharge;
+    session.durationSeconds = session.startTime.secsTo(session.endTime);
+    events.append(SessionEvent(SessionEvent::Parking, SessionEvent::Ended, m_sessions.size() - 1));
+    m_open = false;
+}
+
+void ParkingMachine::saveState(QDataStream& out) const
+{
+    out << qint32(m_nextSessionId) << m_standing << m_open
+        << m_startMsecs << m_startCharge << m_lastMsecs << m_lastCharge;
+    if (m_open) {
+        writeSession(out, m_sessions.last());
+    }
+}
+
+bool ParkingMachine::restoreState(QDataStream& in)
+{
+    m_sessions.clear();
+    qint32 nextSessionId = 1;
+    in >> nextSessionId >> m_standing >> m_open
+       >> m_startMsecs >> m_startCharge >> m_lastMsecs >> m_lastCharge;
+    m_nextSessionId = nextSessionId;
+    if (m_open) {
+        m_sessions.append(readSession(in));
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+ChargingMachine::ChargingMachine(const SessionDetectorConfig& config)
+    : m_minRise(config.chargingMinRisePercent)
+    , m_endMsecs(qint64(config.chargingEndSeconds) * 1000)
+{
+    reset(1);
+}
+
+void ChargingMachine::reset(int firstSessionId)
+{
+    m_sessions.clear();
+    m_nextSessionId = firstSessionId;
+    m_hasLow = false;
+    m_open = false;
+    m_lowMsecs = 0;
+    m_lowCharge = 0.0;
+    m_highMsecs = 0;
+    m_highCharge = 0.0;
+}
+
+void ChargingMachine::processStopped(const qint64 *msecs, const double *charges, qsizetype count,
+                                     QList<SessionEvent>& events)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        const double charge = charges[i];
+        if (qIsNaN(charge)) continue;
+
+        if (m_open) {
+            if (charge > m_highCharge) {
+                m_highMsecs = msecs[i];
+                m_highCharge = charge;
+                m_sessions.last().endCharge = charge;
+            } else if (msecs[i] - m_highMsecs >= m_endMsecs) {
+                // Full, or unplugged: the session ended at the last new high
+                end(SessionEvent::Ended, events);
+                m_hasLow = true;
+                m_lowMsecs = msecs[i];
+                m_lowCharge = charge;
+            }
+            continue;
+        }
+
+        // Track the latest lowest reading; charging shows as a clear rise above it
+        if (!m_hasLow || charge <= m_lowCharge) {
+            m_hasLow = true;
+            m_lowMsecs = msecs[i];
+            m_lowCharge = charge;
+        } else if (charge - m_lowCharge >= m_minRise) {
+            m_open = true;
+            m_highMsecs = msecs[i];
+            m_highCharge = charge;
+
+            SessionInfo session;
+            session.sessionId = m_nextSessionId++;
+            session.startTime = fromMsecs(m_lowMsecs);
+            session.startCharge = m_lowCharge;
+            session.endCharge = charge;
+            m_sessions.append(session);
+            events.append(SessionEvent(SessionEvent::Charging, SessionEvent::Started, m_sessions.size() - 1));
+        }
+    }
+}
+
+void ChargingMachine::processMoving(QList<SessionEvent>& events)
+{
+    if (m_open) {
+        end(SessionEvent::Ended, events);
+    }
+    m_hasLow = false;
+}
+
+void ChargingMachine::expire(QList<SessionEvent>& events)
+{
+    if (m_open) {
+        end(SessionEvent::TimedOut, events);
+    }
+    m_hasLow = false;
+}
+
+void ChargingMachine::end(SessionEvent::Type reason, QList<SessionEvent>& events)
+{
+    SessionInfo& session = m_sessions.last();
+    session.endTime = fromMsecs(m_highMsecs);
+    session.endCharge = m_highCharge;
+    session.durationSeconds = session.startTime.secsTo(session.endTime);
+    events.append(SessionEvent(SessionEvent::Charging, reason, m_sessions.size() - 1));
+    m_open = false;
+}
+
+void ChargingMachine::saveState(QDataStream& out) const
+{
+    out << qint32(m_nextSessionId) << m_hasLow << m_open
+        << m_lowMsecs << m_lowCharge << m_highMsecs << m_highCharge;
+    if (m_open) {
+        writeSession(out, m_sessions.last());
+    }
+}
+
+bool ChargingMachine::restoreState(QDataStream& in)
+{
+    m_sessions.clear();
+    qint32 nextSessionId = 1;
+    in >> nextSessionId >> m_hasLow >> m_open
+       >> m_lowMsecs >> m_lowCharge >> m_highMsecs >> m_highCharge;
+    m_nextSessionId = nextSessionId;
+    if (m_open) {
+        m_sessions.append(readSession(in));
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+SessionDetector::SessionDetector(const SessionDetectorConfig& config)
+    : m_charging(config)
+    , m_parking(config)
+{
+}
+
+void SessionDetector::reset(int firstChargingId, int firstParkingId)
+{
+    m_charging.reset(firstChargingId);
+    m_parking.reset(firstParkingId);
+    m_events.clear();
+}
+
+void SessionDetector::processStopped(const qint64 *msecs, const double *charges, qsizetype count)
+{
+    m_charging.processStopped(msecs, charges, count, m_events);
+    m_parking.processStopped(msecs, charges, count, m_events);
+}
+
+void SessionDetector::processMoving(qint64 msecs)
+{
+    m_charging.processMoving(m_events);
+    m_parking.processMoving(msecs, m_events);
+}
+
+void SessionDetector::expire()
+{
+    m_charging.expire(m_events);
+}
+
+void SessionDetector::saveState(QDataStream& out) const
+{
+    m_charging.saveState(out);
+    m_parking.saveState(out);
+}
+
+bool SessionDetector::restoreState(QDataStream& in)
+{
+    m_events.clear();
+    return m_charging.restoreState(in) && m_parking.restoreState(in);
+}
+
+QList<SessionEvent> SessionDetector::takeEvents()
+{
+    QList<SessionEvent> events;
+    events.swap(m_events);
+    return events;
+}
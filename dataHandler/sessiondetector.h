@@ -0,0 +1,154 @@
+#ifndef SESSIONDETECTOR_H
+#define SESSIONDETECTOR_H
+
+#include <QDateTime>
+#include <QList>
+#include <QDataStream>
+
+#include "tripdata.h"
+
+// A stretch of time the vehicle spent standing, either parked or charging
+struct SessionInfo {
+    int sessionId;
+    QDateTime startTime;
+    QDateTime endTime;   // null while the session is open
+    double startCharge;  // %
+    double endCharge;    // %, latest known while open
+    qint64 durationSeconds;
+
+    SessionInfo() : sessionId(-1), startCharge(0.0), endCharge(0.0), durationSeconds(0) {}
+
+    double chargeAddedPercent() const { return endCharge - startCharge; }
+    double energyAddedWh() const { return qMax(0.0, chargeAddedPercent()) / 100.0 * BATTERY_CAPACITY_WH; }
+};
+
+struct SessionEvent {
+    enum Machine {
+        Charging,
+        Parking
+    };
+    enum Type {
+        Started,   // parked for parkingMinSeconds / charge rose by chargingMinRisePercent
+        Ended,     // vehicle moved, or charge stopped rising for chargingEndSeconds
+        TimedOut   // charging only: data gap of the trip timeout while the session was open
+    };
+
+    Machine machine;
+    Type type;
+    int sessionIndex; // index into the machine's sessions()
+
+    SessionEvent(Machine m, Type t, int index) : machine(m), type(t), sessionIndex(index) {}
+};
+
+struct SessionDetectorConfig {
+    int parkingMinSeconds = 300;          // standstill that counts as parking
+    double chargingMinRisePercent = 1.0;  // SoC rise over its low while standing that starts charging
+    int chargingEndSeconds = 600;         // no new SoC high for this long ends charging
+
+    // PARKING_MIN_SECONDS, CHARGING_MIN_RISE_PERCENT and CHARGING_END_SECONDS override the defaults
+    static SessionDetectorConfig fromEnvironment();
+};
+
+// Parking: every standstill of at least parkingMinSeconds, until the vehicle
+// moves. A data gap does not end it: standing on both sides of the gap is one
+// standstill, moving after it ends the session when the data resumes.
+class ParkingMachine
+{
+public:
+    explicit ParkingMachine(const SessionDetectorConfig& config);
+
+    void reset(int firstSessionId);
+    void processStopped(const qint64 *msecs, const double *charges, qsizetype count, QList<SessionEvent>& events);
+    void processMoving(qint64 msecs, QList<SessionEvent>& events);
+
+    // Machine state and the open session; closed sessions are not kept
+    void saveState(QDataStream& out) const;
+    bool restoreState(QDataStream& in);
+
+    QList<SessionInfo>& sessions() { return m_sessions; }
+    const QList<SessionInfo>& sessions() const { return m_sessions; }
+    int nextSessionId() const { return m_nextSessionId; }
+
+private:
+    void end(qint64 msecs, QList<SessionEvent>& events);
+
+    qint64 m_minMsecs;
+    QList<SessionInfo> m_sessions;
+    int m_nextSessionId;
+    bool m_standing;  // a standstill is being timed
+    bool m_open;      // ... and has lasted long enough
+    qint64 m_startMsecs;
+    double m_startCharge;
+    qint64 m_lastMsecs;
+    double m_lastCharge;
+};
+
+// Charging: while standing, SoC rises chargingMinRisePercent above its low; the
+// session runs from that low to the last new high
+class ChargingMachine
+{
+public:
+    explicit ChargingMachine(const SessionDetectorConfig& config);
+
+    void reset(int firstSessionId);
+    void processStopped(const qint64 *msecs, const double *charges, qsizetype count, QList<SessionEvent>& events);
+    void processMoving(QList<SessionEvent>& events);
+    void expire(QList<SessionEvent>& events);
+
+    // Machine state and the open session; closed sessions are not kept
+    void saveState(QDataStream& out) const;
+    bool restoreState(QDataStream& in);
+
+    QList<SessionInfo>& sessions() { return m_sessions; }
+    const QList<SessionInfo>& sessions() const { return m_sessions; }
+    int nextSessionId() const { return m_nextSessionId; }
+
+private:
+    void end(SessionEvent::Type reason, QList<SessionEvent>& events);
+
+    double m_minRise;
+    qint64 m_endMsecs;
+    QList<SessionInfo> m_sessions;
+    int m_nextSessionId;
+    bool m_hasLow;
+    bool m_open;
+    qint64 m_lowMsecs;
+    double m_lowCharge;
+    qint64 m_highMsecs;
+    double m_highCharge;
+};
+
+// The standstill state machines, driven by TripDetector from the motion runs
+// it segments anyway, so sessions cost no extra pass over the data. Runs of
+// stationary points go to processStopped(), the first point of a moving run to
+// processMoving(); both machines see the same calls in batch and push ingest.
+class SessionDetector
+{
+public:
+    explicit SessionDetector(const SessionDetectorConfig& config = SessionDetectorConfig());
+
+    void reset(int firstChargingId = 1, int firstParkingId = 1);
+    void processStopped(const qint64 *msecs, const double *charges, qsizetype count);
+    void processMoving(qint64 msecs);
+    // Data resumed after a timeout gap: open charging ends at the last data,
+    // parking carries on until the next movement
+    void expire();
+
+    // Both machines, for TripDetector::saveState(); pending events are not kept
+    void saveState(QDataStream& out) const;
+    bool restoreState(QDataStream& in);
+
+    QList<SessionEvent> takeEvents();
+
+    ChargingMachine& charging() { return m_charging; }
+    const ChargingMachine& charging() const { return m_charging; }
+    ParkingMachine& parking() { return m_parking; }
+    const ParkingMachine& parking() const { return m_parking; }
+
+private:
+    ChargingMachine m_charging;
+    ParkingMachine m_parking;
+    QList<SessionEvent> m_events;
+};
+
+#endif // SESSIONDETECTOR_H
@@ -0,0 +1,106 @@
+#include "speedfilter.h"
+#include <algorithm>
+#include <cmath>
+
+// Smallest MAD in m/s the Hampel threshold is based on. A window of equal
+// samples has a MAD of 0, which would replace every other value by the median
+// and hold back each start of movement until the median catches up.
+static const double MIN_MAD = 0.1;
+
+SpeedFilter::SpeedFilter(int window, double sigmas)
+    : m_window(qBound(0, window, int(MAX_WINDOW)))
+    , m_sigmas(qMax(0.0, sigmas))
+{
+    reset();
+}
+
+void SpeedFilter::reset()
+{
+    m_head = 0;
+    m_size = 0;
+}
+
+double SpeedFilter::median() const
+{
+    const int middle = m_size / 2;
+    return m_size % 2 ? m_sorted[middle] : 0.5 * (m_sorted[middle - 1] + m_sorted[middle]);
+}
+
+double SpeedFilter::filter(double speed)
+{
+    // NaN never counts as moving downstream and would break the ordering here
+    if (!isEnabled() || std::isnan(speed)) return speed;
+
+    double *sortedEnd = m_sorted + m_size;
+    if (m_size == m_window) {
+        // Drop the oldest sample from the sorted copy
+        const double oldest = m_ring[m_head];
+        double *slot = std::lower_bound(m_sorted, sortedEnd, oldest);
+        std::copy(slot + 1, sortedEnd, slot);
+        --sortedEnd;
+        m_ring[m_head] = speed;
+        m_head = (m_head + 1) % m_window;
+    } else {
+        m_ring[m_size] = speed;
+        ++m_size;
+    }
+    double *slot = std::upper_bound(m_sorted, sortedEnd, speed);
+    std::copy_backward(slot, sortedEnd, sortedEnd + 1);
+    *slot = speed;
+
+    const double center = median();
+    if (m_sigmas == 0.0) return center;
+
+    // The deviations from the median grow outward from it in the sorted
+    // window, so merging both sides finds the MAD without sorting a copy; like
+    // the median it is the mean of the two middle ranks for an even window
+    int right = int(std::upper_bound(m_sorted, m_sorted + m_size, center) - m_sorted);
+    int left = right - 1;
+    double lower = 0.0;
+    double deviation = 0.0;
+    for (int rank = 0; rank <= m_size / 2; ++rank) {
+        if (right >= m_size || (left >= 0 && center - m_sorted[left] <= m_sorted[right] - center)) {
+            deviation = center - m_sorted[left--];
+        } else {
+            deviation = m_sorted[right++] - center;
+        }
+        if (rank == (m_size - 1) / 2) lower = deviation;
+    }
+    const double mad = qMax(MIN_MAD, 0.5 * (lower + deviation));
+
+    return std::fabs(speed - center) > m_sigmas * 1.4826 * mad ? center : speed;
+}
+
+void SpeedFilter::filter(double *speeds, qsizetype count)
+{
+    if (!isEnabled()) return;
+    for (qsizetype i = 0; i < count; ++i) {
+        speeds[i] = filter(speeds[i]);
+    }
+}
+
+void SpeedFilter::saveState(QDataStream& out) const
+{
+    // Once full the ring starts at m_head
+    const int first = m_size == m_window ? m_head : 0;
+    out << qint32(m_size);
+    for (int i = 0; i < m_size; ++i) {
+        out << m_ring[(first + i) % m_window];
+    }
+}
+
+bool SpeedFilter::restoreState(QDataStream& in)
+{
+    reset();
+    qint32 size = 0;
+    in >> size;
+    if (size < 0 || size > m_window) return false;
+
+    // Feeding the samples again rebuilds both the ring and the sorted copy
+    for (qint32 i = 0; i < size; ++i) {
+        double speed = 0.0;
+        in >> speed;
+        filter(speed);
+    }
+    return in.status() == QDataStream::Ok;
+}
@@ -0,0 +1,50 @@
+#ifndef SPEEDFILTER_H
+#define SPEEDFILTER_H
+
+#include <QtGlobal>
+#include <QDataStream>
+
+// Streaming outlier filter for the speed series, run before trip detection so
+// a single noisy sample cannot reset a pending trip start or end.
+//
+// Keeps the last 'window' samples in a ring buffer plus a sorted copy that is
+// updated in place: the oldest sample is erased and the new one inserted at
+// positions found by binary search, and the MAD is read off the sorted window
+// by walking outward from the median. Nothing is sorted per sample, the work
+// is bounded by the window (MAX_WINDOW at most). With sigmas == 0 the
+// output is the sliding median; otherwise it is a Hampel filter: a sample is
+// replaced by the median only when it is more than 'sigmas' robust standard
+// deviations (1.4826 * MAD, the MAD at least 0.1 m/s) away from it. The window is causal, it looks at the
+// current and the previous samples only.
+class SpeedFilter
+{
+public:
+    explicit SpeedFilter(int window = 0, double sigmas = 0.0);
+
+    bool isEnabled() const { return m_window > 1; }
+    int window() const { return m_window; }
+    double sigmas() const { return m_sigmas; }
+
+    void reset();
+    double filter(double speed);
+    // Same as filter() for each value of a column, in place
+    void filter(double *speeds, qsizetype count);
+
+    // The window's samples, oldest first; restoring refills the window with them
+    void saveState(QDataStream& out) const;
+    bool restoreState(QDataStream& in);
+
+    static const int MAX_WINDOW = 31;
+
+private:
+    double median() const;
+
+    int m_window;
+    double m_sigmas;
+    double m_ring[MAX_WINDOW];
+    double m_sorted[MAX_WINDOW];
+    int m_head; // oldest sample once the ring is full
+    int m_size;
+};
+
+#endif // SPEEDFILTER_H
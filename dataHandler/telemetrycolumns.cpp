@@ -0,0 +1,113 @@
+#include "telemetrycolumns.h"
+#include <QTimeZone>
+#include <algorithm>
+#include <numeric>
+
+void TelemetrySeries::normalize()
+{
+    const qsizetype count = timestamps.size();
+    if (count < 2) return;
+
+    // Queries sort by time, so the common case is a single check
+    if (!std::is_sorted(timestamps.cbegin(), timestamps.cend())) {
+        QList<qsizetype> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](qsizetype a, qsizetype b) {
+            return timestamps[a] < timestamps[b];
+        });
+
+        QList<qint64> sortedTimestamps;
+        QList<double> sortedValues;
+        sortedTimestamps.reserve(count);
+        sortedValues.reserve(count);
+        for (qsizetype index : order) {
+            sortedTimestamps.append(timestamps[index]);
+            sortedValues.append(values[index]);
+        }
+        timestamps.swap(sortedTimestamps);
+        values.swap(sortedValues);
+    }
+
+    // Collapse duplicates in place, the later sample wins
+    qsizetype out = 0;
+    for (qsizetype i = 1; i < count; ++i) {
+        if (timestamps[i] != timestamps[out]) {
+            ++out;
+            timestamps[out] = timestamps[i];
+        }
+        values[out] = values[i];
+    }
+    timestamps.resize(out + 1);
+    values.resize(out + 1);
+}
+
+TelemetrySeries *TelemetryColumns::series(int id)
+{
+    switch (id) {
+    case Speed: return &speed;
+    case Charge: return &charge;
+    default: return nullptr;
+    }
+}
+
+void TelemetrySeries::removeAfter(qint64 msecs)
+{
+    const qsizetype count = std::upper_bound(timestamps.cbegin(), timestamps.cend(), msecs) - timestamps.cbegin();
+    timestamps.resize(count);
+    values.resize(count);
+}
+
+void TelemetryColumns::alignSeries(qint64 speedWatermark, qint64 chargeWatermark, qint64 graceMsecs)
+{
+    speed.normalize();
+    charge.normalize();
+
+    // Each series is complete up to its newest received sample. Merged past
+    // the older of the two, the other series' next samples would land behind
+    // the timeline, so the rest waits for the next query (it is asked for
+    // again from the watermark). A series that never had a sample, or lags
+    // more than the grace, is not waited for
+    const qint64 speedNewest = speed.isEmpty() ? speedWatermark : speed.timestamps.last();
+    const qint64 chargeNewest = charge.isEmpty() ? chargeWatermark : charge.timestamps.last();
+    if (speedNewest < 0 || chargeNewest < 0) return;
+
+    const qint64 horizon = qMax(qMin(speedNewest, chargeNewest),
+                                qMax(speedNewest, chargeNewest) - graceMsecs);
+    speed.removeAfter(horizon);
+    charge.removeAfter(horizon);
+}
+
+QList<VehicleDataPoint> TelemetryColumns::toDataPoints(double speedBefore, double chargeBefore)
+{
+    speed.normalize();
+    charge.normalize();
+
+    QList<VehicleDataPoint> points;
+    points.reserve(speed.size() + charge.size());
+
+    double lastSpeed = speedBefore;
+    double lastCharge = chargeBefore;
+    qsizetype s = 0;
+    qsizetype c = 0;
+
+    while (s < speed.size() || c < charge.size()) {
+        qint64 time;
+        if (c >= charge.size() || (s < speed.size() && speed.timestamps[s] <= charge.timestamps[c])) {
+            time = speed.timestamps[s];
+        } else {
+            time = charge.timestamps[c];
+        }
+
+        // A series without a sample at this time keeps its last known value
+        if (s < speed.size() && speed.timestamps[s] == time) {
+            lastSpeed = speed.values[s++];
+        }
+        if (c < charge.size() && charge.timestamps[c] == time) {
+            lastCharge = charge.values[c++];
+        }
+
+        points.append(VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(time, QTimeZone::UTC),
+                                       lastSpeed, lastCharge));
+    }
+    return points;
+}
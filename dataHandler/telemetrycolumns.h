@@ -0,0 +1,52 @@
+#ifndef TELEMETRYCOLUMNS_H
+#define TELEMETRYCOLUMNS_H
+
+#include <QList>
+#include <limits>
+#include "tripdata.h"
+
+// One numeric series stored column-wise: parallel timestamp and value arrays
+struct TelemetrySeries {
+    QList<qint64> timestamps; // ms since epoch
+    QList<double> values;
+
+    void append(qint64 msecs, double value) { timestamps.append(msecs); values.append(value); }
+    void reserve(qsizetype size) { timestamps.reserve(size); values.reserve(size); }
+    qsizetype size() const { return timestamps.size(); }
+    bool isEmpty() const { return timestamps.isEmpty(); }
+    void clear() { timestamps.clear(); values.clear(); }
+
+    // Sort by time and keep the last value of duplicate timestamps
+    void normalize();
+    // Drops the samples after 'msecs', on a normalized series
+    void removeAfter(qint64 msecs);
+};
+
+// The speed and charge series of one query. Decoders (CSV, Arrow) append into
+// the columns directly; toDataPoints() then merges both series onto a common
+// timeline in one pass, carrying the last value of each series forward.
+struct TelemetryColumns {
+    enum Series { Speed = 0, Charge = 1 };
+
+    TelemetrySeries speed;
+    TelemetrySeries charge;
+
+    TelemetrySeries *series(int id);
+    void clear() { speed.clear(); charge.clear(); }
+    bool isEmpty() const { return speed.isEmpty() && charge.isEmpty(); }
+
+    // Cuts the series that is ahead back to where the other one was received
+    // up to, so the lagging one is not left behind the merged timeline. A
+    // series without samples counts as received up to its watermark (-1 =
+    // never), one lagging more than 'graceMsecs' is not waited for
+    void alignSeries(qint64 speedWatermark, qint64 chargeWatermark, qint64 graceMsecs);
+
+    // 'speedBefore' and 'chargeBefore' are carried forward until a series has
+    // its first sample, for queries that continue an earlier timeline. Charge
+    // is NaN (unknown) until then by default, which sessions and trip
+    // statistics skip; a made-up 0 % would look like a charge to 80 % later
+    QList<VehicleDataPoint> toDataPoints(double speedBefore = 0.0,
+                                         double chargeBefore = std::numeric_limits<double>::quiet_NaN());
+};
+
+#endif // TELEMETRYCOLUMNS_H
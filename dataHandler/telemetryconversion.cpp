@@ -0,0 +1,88 @@
+#include "telemetryconversion.h"
+#include <QtMath>
+
+namespace TelemetryConversion {
+
+RawTopic rawTopicKind(QStringView topic)
+{
+    if (!topic.startsWith(u"Vehicle/")) return RawTopic::Unknown;
+
+    if (topic.endsWith(u"/Speed")) return RawTopic::Speed;
+    if (topic.endsWith(u"/Powertrain/TractionBattery/StateOfCharge")) return RawTopic::StateOfCharge;
+    if (topic.endsWith(u"/ADAS/ActiveAutonomyLevel")) return RawTopic::AutonomyLevel;
+    return RawTopic::Unknown;
+}
+
+QString treatedMeasurement(QStringView topic)
+{
+    // Vehicle id is the second path segment
+    const qsizetype idEnd = topic.indexOf(u'/', 8);
+    if (idEnd < 0) return QString();
+
+    const QString prefix = topic.left(idEnd).toString();
+    switch (rawTopicKind(topic)) {
+    case RawTopic::Speed:         return prefix + QStringLiteral("/qt/speed");
+    case RawTopic::StateOfCharge: return prefix + QStringLiteral("/qt/charge");
+    case RawTopic::AutonomyLevel: return prefix + QStringLiteral("/qt/autonomy_level");
+    case RawTopic::Unknown:       break;
+    }
+    return QString();
+}
+
+QString rawTopicName(RawTopic kind, QStringView vehicleId)
+{
+    const QString prefix = QStringLiteral("Vehicle/") + vehicleId.toString();
+    switch (kind) {
+    case RawTopic::Speed:         return prefix + QStringLiteral("/Speed");
+    case RawTopic::StateOfCharge: return prefix + QStringLiteral("/Powertrain/TractionBattery/StateOfCharge");
+    case RawTopic::AutonomyLevel: return prefix + QStringLiteral("/ADAS/ActiveAutonomyLevel");
+    case RawTopic::Unknown:       break;
+    }
+    return QString();
+}
+
+static bool isNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '.';
+}
+
+bool extractNumber(QByteArrayView payload, double& value)
+{
+    qsizetype start = 0;
+    while (start < payload.size() && !isNumberChar(payload[start])) {
+        ++start;
+    }
+    qsizetype end = start;
+    while (end < payload.size() && isNumberChar(payload[end])) {
+        ++end;
+    }
+    if (end == start) return false;
+
+    bool ok = false;
+    value = payload.sliced(start, end - start).toDouble(&ok);
+    return ok;
+}
+
+double rpmToMetersPerSecond(double rpm)
+{
+    return rpm * WHEEL_RADIUS_M * 2 * M_PI / 60;
+}
+
+double clampStateOfCharge(double percent)
+{
+    return qBound(0.0, percent, 100.0);
+}
+
+bool convertRawValue(RawTopic kind, QByteArrayView payload, double& value)
+{
+    if (kind == RawTopic::Unknown || !extractNumber(payload, value)) return false;
+
+    if (kind == RawTopic::Speed) {
+        value = rpmToMetersPerSecond(value);
+    } else if (kind == RawTopic::StateOfCharge) {
+        value = clampStateOfCharge(value);
+    }
+    return true;
+}
+
+} // namespace TelemetryConversion
@@ -0,0 +1,42 @@
+#ifndef TELEMETRYCONVERSION_H
+#define TELEMETRYCONVERSION_H
+
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+// Raw vehicle topics and the conversions that turn them into the treated
+// Vehicle/<id>/qt/* series. Shared by the MQTT ingest and the resampling ETL,
+// and kept identical to what DataTreatment/main.py does.
+namespace TelemetryConversion {
+
+enum class RawTopic {
+    Unknown,
+    Speed,          // Vehicle/<id>/Speed, motor RPM
+    StateOfCharge,  // Vehicle/<id>/Powertrain/TractionBattery/StateOfCharge, percent
+    AutonomyLevel   // Vehicle/<id>/ADAS/ActiveAutonomyLevel
+};
+
+// Wheel radius used to turn motor RPM into m/s
+const double WHEEL_RADIUS_M = 0.067;
+
+RawTopic rawTopicKind(QStringView topic);
+
+// "Vehicle/1/Speed" -> "Vehicle/1/qt/speed"; empty for unknown topics
+QString treatedMeasurement(QStringView topic);
+
+// Raw topic names for one vehicle id (or an MQTT wildcard such as "+")
+QString rawTopicName(RawTopic kind, QStringView vehicleId);
+
+// First run of digits and dots in the payload, like the ([\d.]+) extraction in main.py
+bool extractNumber(QByteArrayView payload, double& value);
+
+double rpmToMetersPerSecond(double rpm);
+double clampStateOfCharge(double percent);
+
+// Extract and convert one raw payload into the unit of the treated series
+bool convertRawValue(RawTopic kind, QByteArrayView payload, double& value);
+
+} // namespace TelemetryConversion
+
+#endif // TELEMETRYCONVERSION_H
@@ -0,0 +1,384 @@
+#include "telemetrysegmentstore.h"
+#include <QDir>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char SEGMENT_MAGIC[4] = { 'T', 'S', 'E', 'G' };
+const char INDEX_MAGIC[4] = { 'T', 'I', 'D', 'X' };
+const char LOG_MAGIC[4] = { 'T', 'L', 'O', 'G' };
+const quint32 FORMAT_VERSION = 1;
+// Version 1 logs had no series watermarks
+const quint32 LOG_FORMAT_VERSION = 2;
+
+// Segment: magic, version, point count | msecs | speeds | charges | chunk ranges | chunk count, magic, 0
+const qint64 SEGMENT_HEADER_SIZE = 16;
+const qint64 SEGMENT_TRAILER_SIZE = 16;
+// Log: magic, version, speed watermark, charge watermark | records
+const qint64 LOG_HEADER_SIZE = 24;
+const qint64 LOG_V1_HEADER_SIZE = 8;
+
+QString segmentFileName(qint64 firstMsecs)
+{
+    // Zero padded, so name order is time order
+    return QString("segment-%1.tseg").arg(firstMsecs, 16, 10, QChar('0'));
+}
+
+template <typename T>
+T readValue(const uchar *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+template <typename T>
+bool writeValues(QIODevice& device, const T *values, qint64 count)
+{
+    const qint64 bytes = count * qint64(sizeof(T));
+    return device.write(reinterpret_cast<const char *>(values), bytes) == bytes;
+}
+
+} // namespace
+
+TelemetrySegmentStore::TelemetrySegmentStore()
+    : m_lastMsecs(-1)
+    , m_speedWatermark(-1)
+    , m_chargeWatermark(-1)
+    , m_watermarksChanged(false)
+{
+}
+
+TelemetrySegmentStore::~TelemetrySegmentStore()
+{
+    flush();
+}
+
+bool TelemetrySegmentStore::open(const QString& directory)
+{
+    m_directory = directory;
+    QDir dir(directory);
+    if (!dir.mkpath(".")) {
+        qDebug() << "TelemetrySegmentStore: Cannot create" << directory;
+        return false;
+    }
+
+    const QStringList names = dir.entryList(QStringList() << "segment-*.tseg", QDir::Files, QDir::Name);
+    for (const QString& name : names) {
+        auto segment = std::make_shared<Segment>();
+        const QString path = dir.filePath(name);
+        if (!mapSegment(path, *segment)) {
+            // A cache, not the source of truth: drop what cannot be used
+            qDebug() << "TelemetrySegmentStore: Discarding unreadable segment" << name;
+            segment.reset();
+            QFile::remove(path);
+            continue;
+        }
+        // Only the records older than what the previous segments hold are
+        // skipped, the file stays until removeBefore() ages it out
+        segment->first = std::lower_bound(segment->msecs, segment->msecs + segment->count, m_lastMsecs)
+                         - segment->msecs;
+        if (segment->first > 0) {
+            qDebug() << "TelemetrySegmentStore: Ignoring" << segment->first << "out of order points in" << name;
+        }
+        m_lastMsecs = qMax(m_lastMsecs, segment->lastMsecs);
+        m_segments.append(segment);
+    }
+
+    m_log.setFileName(dir.filePath("active.tlog"));
+    if (!m_log.open(QIODevice::ReadWrite)) {
+        qDebug() << "TelemetrySegmentStore: Cannot open log:" << m_log.errorString();
+        return false;
+    }
+    if (!replayLog()) {
+        m_log.close();
+        return false;
+    }
+
+    qDebug() << "TelemetrySegmentStore:" << size() << "points in" << m_segments.size()
+             << "segments and the log of" << directory;
+    return true;
+}
+
+bool TelemetrySegmentStore::mapSegment(const QString& path, Segment& segment)
+{
+    segment.file = std::make_unique<QFile>(path);
+    if (!segment.file->open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = segment.file->size();
+    if (size < SEGMENT_HEADER_SIZE + SEGMENT_TRAILER_SIZE) return false;
+    segment.data = segment.file->map(0, size);
+    if (!segment.data) return false;
+
+    const uchar *trailer = segment.data + size - SEGMENT_TRAILER_SIZE;
+    if (std::memcmp(segment.data, SEGMENT_MAGIC, 4) != 0 || readValue<quint32>(segment.data + 4) != FORMAT_VERSION
+        || std::memcmp(trailer + 8, INDEX_MAGIC, 4) != 0) {
+        return false;
+    }
+
+    segment.count = readValue<qint64>(segment.data + 8);
+    segment.chunkCount = readValue<qint64>(trailer);
+    const qint64 recordBytes = qint64(sizeof(qint64) + 2 * sizeof(double));
+    if (segment.count <= 0 || segment.count > size / recordBytes
+        || segment.chunkCount <= 0 || segment.chunkCount > size / qint64(sizeof(ChunkRange))
+        || size != SEGMENT_HEADER_SIZE + segment.count * recordBytes
+                   + segment.chunkCount * qint64(sizeof(ChunkRange)) + SEGMENT_TRAILER_SIZE) {
+        return false;
+    }
+
+    // Every column starts on an 8 byte boundary of the page aligned map
+    const uchar *column = segment.data + SEGMENT_HEADER_SIZE;
+    segment.msecs = reinterpret_cast<const qint64 *>(column);
+    column += segment.count * qint64(sizeof(qint64));
+    segment.speeds = reinterpret_cast<const double *>(column);
+    column += segment.count * qint64(sizeof(double));
+    segment.charges = reinterpret_cast<const double *>(column);
+    column += segment.count * qint64(sizeof(double));
+    segment.chunks = reinterpret_cast<const ChunkRange *>(column);
+
+    segment.firstMsecs = segment.msecs[0];
+    segment.lastMsecs = segment.msecs[segment.count - 1];
+    return true;
+}
+
+bool TelemetrySegmentStore::replayLog()
+{
+    m_logRecords.clear();
+
+    const qint64 size = m_log.size();
+    const QByteArray header = m_log.read(LOG_HEADER_SIZE);
+    const uchar *headerData = reinterpret_cast<const uchar *>(header.constData());
+    const quint32 version = header.size() >= LOG_V1_HEADER_SIZE && std::memcmp(headerData, LOG_MAGIC, 4) == 0
+                            ? readValue<quint32>(headerData + 4) : 0;
+
+    qint64 headerSize = 0;
+    bool watermarksKnown = false;
+    if (version == LOG_FORMAT_VERSION && header.size() == LOG_HEADER_SIZE) {
+        headerSize = LOG_HEADER_SIZE;
+        m_speedWatermark = readValue<qint64>(headerData + 8);
+        m_chargeWatermark = readValue<qint64>(headerData + 16);
+        watermarksKnown = true;
+    } else if (version == 1) {
+        headerSize = LOG_V1_HEADER_SIZE;
+    }
+
+    bool rewrite = headerSize != LOG_HEADER_SIZE;
+    if (headerSize > 0 && m_log.seek(headerSize)) {
+        const qint64 recordCount = (size - headerSize) / qint64(sizeof(Record));
+        const QByteArray bytes = m_log.read(recordCount * qint64(sizeof(Record)));
+        // A crash while appending leaves a partial record at the end
+        rewrite = rewrite || bytes.size() != size - headerSize;
+
+        // A crash between sealing a segment and truncating the log leaves the
+        // segment's records at the start of the log. Timestamps alone cannot
+        // tell them apart from new points with the segment's last timestamp
+        const Segment *newest = m_segments.isEmpty() ? nullptr : m_segments.last().get();
+        qint64 sealed = 0;
+        for (qint64 i = 0; i < bytes.size() / qint64(sizeof(Record)); ++i) {
+            const Record record = readValue<Record>(reinterpret_cast<const uchar *>(bytes.constData()) + i * sizeof(Record));
+            if (newest && sealed == i && sameAsSegmentRecord(record, *newest, i)) {
+                sealed++;
+                rewrite = true;
+                continue;
+            }
+            // Out of order
+            if (record.msecs < m_lastMsecs) {
+                rewrite = true;
+                continue;
+            }
+            m_logRecords.append(record);
+            m_lastMsecs = record.msecs;
+        }
+    }
+
+    if (!watermarksKnown) {
+        // Old or damaged header: assume both series reach the newest point
+        m_speedWatermark = m_lastMsecs;
+        m_chargeWatermark = m_lastMsecs;
+    }
+    // Never ahead of the points themselves, e.g. after a torn record
+    m_speedWatermark = qMin(m_speedWatermark, m_lastMsecs);
+    m_chargeWatermark = qMin(m_chargeWatermark, m_lastMsecs);
+    m_watermarksChanged = false;
+
+    if (rewrite) {
+        if (!m_log.resize(0) || !writeLogHeader()
+            || !writeValues(m_log, m_logRecords.constData(), m_logRecords.size())) {
+            qDebug() << "TelemetrySegmentStore: Cannot rewrite log:" << m_log.errorString();
+            return false;
+        }
+        m_log.flush();
+    }
+    return m_log.seek(m_log.size());
+}
+
+bool TelemetrySegmentStore::sameAsSegmentRecord(const Record& record, const Segment& segment, qint64 index) const
+{
+    // Bitwise, NaN charges included
+    return index < segment.count && record.msecs == segment.msecs[index]
+        && std::memcmp(&record.speed, &segment.speeds[index], sizeof(double)) == 0
+        && std::memcmp(&record.charge, &segment.charges[index], sizeof(double)) == 0;
+}
+
+bool TelemetrySegmentStore::writeLogHeader()
+{
+    return m_log.seek(0)
+        && m_log.write(LOG_MAGIC, 4) == 4
+        && writeValues(m_log, &LOG_FORMAT_VERSION, 1)
+        && writeValues(m_log, &m_speedWatermark, 1)
+        && writeValues(m_log, &m_chargeWatermark, 1);
+}
+
+void TelemetrySegmentStore::setSeriesWatermarks(qint64 speedMsecs, qint64 chargeMsecs)
+{
+    if (speedMsecs == m_speedWatermark && chargeMsecs == m_chargeWatermark) return;
+    m_speedWatermark = speedMsecs;
+    m_chargeWatermark = chargeMsecs;
+    m_watermarksChanged = true;
+}
+
+qint64 TelemetrySegmentStore::size() const
+{
+    qint64 count = m_logRecords.size();
+    for (const auto& segment : m_segments) {
+        count += segment->count - segment->first;
+    }
+    return count;
+}
+
+bool TelemetrySegmentStore::append(qint64 msecs, double speed, double charge)
+{
+    if (!isOpen() || msecs < m_lastMsecs) return false;
+
+    const Record record = { msecs, speed, charge };
+    if (!writeValues(m_log, &record, 1)) {
+        qDebug() << "TelemetrySegmentStore: Cannot append to log:" << m_log.errorString();
+        return false;
+    }
+    m_logRecords.append(record);
+    m_lastMsecs = msecs;
+
+    if (m_logRecords.size() >= SEGMENT_POINTS) {
+        return rollOver();
+    }
+    return true;
+}
+
+bool TelemetrySegmentStore::flush()
+{
+    if (!isOpen()) return true;
+
+    // The header is rewritten in place, after the records it describes
+    if (m_watermarksChanged) {
+        if (!m_log.flush() || !writeLogHeader() || !m_log.seek(m_log.size())) {
+            qDebug() << "TelemetrySegmentStore: Cannot write series watermarks:" << m_log.errorString();
+            return false;
+        }
+        m_watermarksChanged = false;
+    }
+    return m_log.flush();
+}
+
+bool TelemetrySegmentStore::rollOver()
+{
+    const qint64 count = m_logRecords.size();
+    const QString path = QDir(m_directory).filePath(segmentFileName(m_logRecords.first().msecs));
+
+    QList<qint64> msecs(count);
+    QList<double> speeds(count);
+    QList<double> charges(count);
+    for (qint64 i = 0; i < count; ++i) {
+        msecs[i] = m_logRecords[i].msecs;
+        speeds[i] = m_logRecords[i].speed;
+        charges[i] = m_logRecords[i].charge;
+    }
+
+    QList<ChunkRange> chunks;
+    for (qint64 first = 0; first < count; first += INDEX_CHUNK_POINTS) {
+        const qint64 last = qMin(count, first + qint64(INDEX_CHUNK_POINTS)) - 1;
+        chunks.append(ChunkRange{ msecs[first], msecs[last] });
+    }
+
+    QSaveFile file(path);
+    const qint64 chunkCount = chunks.size();
+    const quint32 reserved = 0;
+    const bool written = file.open(QIODevice::WriteOnly)
+        && file.write(SEGMENT_MAGIC, 4) == 4
+        && writeValues(file, &FORMAT_VERSION, 1)
+        && writeValues(file, &count, 1)
+        && writeValues(file, msecs.constData(), count)
+        && writeValues(file, speeds.constData(), count)
+        && writeValues(file, charges.constData(), count)
+        && writeValues(file, chunks.constData(), chunkCount)
+        && writeValues(file, &chunkCount, 1)
+        && file.write(INDEX_MAGIC, 4) == 4
+        && writeValues(file, &reserved, 1);
+    // commit() renames the finished file into place
+    if (!written || !file.commit()) {
+        qDebug() << "TelemetrySegmentStore: Cannot write segment" << path << ":" << file.errorString();
+        return false;
+    }
+
+    auto segment = std::make_shared<Segment>();
+    if (!mapSegment(path, *segment)) {
+        qDebug() << "TelemetrySegmentStore: Cannot map new segment" << path;
+        return false;
+    }
+    m_segments.append(segment);
+
+    // The segment holds them now; should this fail they are skipped on the next open
+    m_logRecords.clear();
+    if (!m_log.resize(LOG_HEADER_SIZE) || !m_log.seek(LOG_HEADER_SIZE)) {
+        qDebug() << "TelemetrySegmentStore: Cannot truncate log:" << m_log.errorString();
+    }
+    return true;
+}
+
+bool TelemetrySegmentStore::clear()
+{
+    while (!m_segments.isEmpty()) {
+        const QString path = m_segments.first()->file->fileName();
+        m_segments.removeFirst();
+        QFile::remove(path);
+    }
+    m_logRecords.clear();
+    m_lastMsecs = -1;
+    setSeriesWatermarks(-1, -1);
+    return !isOpen() || (m_log.resize(LOG_HEADER_SIZE) && m_log.seek(LOG_HEADER_SIZE));
+}
+
+void TelemetrySegmentStore::removeBefore(qint64 msecs)
+{
+    while (!m_segments.isEmpty() && m_segments.first()->lastMsecs < msecs) {
+        const QString path = m_segments.first()->file->fileName();
+        m_segments.removeFirst(); // closes and unmaps the file
+        QFile::remove(path);
+    }
+}
+
+void TelemetrySegmentStore::load(CompressedTelemetry& points, qint64 fromMsecs) const
+{
+    for (const auto& segment : m_segments) {
+        if (segment->lastMsecs < fromMsecs) continue;
+
+        // Whole chunks before 'fromMsecs' are skipped by the footer index
+        qint64 first = segment->first;
+        for (qint64 chunk = 0; chunk < segment->chunkCount && segment->chunks[chunk].lastMsecs < fromMsecs; ++chunk) {
+            first = qMax(first, (chunk + 1) * INDEX_CHUNK_POINTS);
+        }
+        for (qint64 i = first; i < segment->count; ++i) {
+            if (segment->msecs[i] >= fromMsecs) {
+                points.append(segment->msecs[i], segment->speeds[i], segment->charges[i]);
+            }
+        }
+    }
+
+    for (const Record& record : m_logRecords) {
+        if (record.msecs >= fromMsecs) {
+            points.append(record.msecs, record.speed, record.charge);
+        }
+    }
+}
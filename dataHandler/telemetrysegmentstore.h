@@ -0,0 +1,107 @@
+#ifndef TELEMETRYSEGMENTSTORE_H
+#define TELEMETRYSEGMENTSTORE_H
+
+#include <QString>
+#include <QList>
+#include <QFile>
+#include <memory>
+
+#include "compressedtelemetry.h"
+
+// Local on-disk copy of the ingested timeline, so a restart starts from disk
+// and only asks InfluxDB for what came in since (the high watermark). The
+// speed and charge series also keep their own watermark, the newest sample of
+// each that the stored points hold, so a series that lags the other is asked
+// for from where it really stopped.
+//
+// New points are appended to an active log of fixed-size records. Once it
+// holds SEGMENT_POINTS it is rolled over into a sealed segment: the timestamp,
+// speed and charge columns one after the other, then a footer that indexes the
+// time range of every INDEX_CHUNK_POINTS points. The segment is written under
+// a temporary name and renamed into place (QSaveFile), so a crash leaves either
+// the log or the segment, never half of one; log records the segment already
+// holds are skipped on open. Points may share a timestamp (a speed and a
+// charge sample often do), only points older than the previous one are out
+// of order and ignored. Sealed segments are read through memory maps.
+// The series watermarks live in the log header and are rewritten on flush().
+//
+// Files use native byte order, the cache belongs to the machine that wrote it.
+class TelemetrySegmentStore
+{
+public:
+    TelemetrySegmentStore();
+    ~TelemetrySegmentStore();
+
+    // Maps the sealed segments and replays the active log of 'directory'
+    bool open(const QString& directory);
+    bool isOpen() const { return m_log.isOpen(); }
+    QString directory() const { return m_directory; }
+
+    // Newest stored time in ms since epoch, -1 when empty
+    qint64 highWatermark() const { return m_lastMsecs; }
+    // Newest stored sample of each series, -1 when it has none; for a store
+    // written before they were kept both are the high watermark
+    qint64 speedWatermark() const { return m_speedWatermark; }
+    qint64 chargeWatermark() const { return m_chargeWatermark; }
+    // Recorded by the next flush()
+    void setSeriesWatermarks(qint64 speedMsecs, qint64 chargeMsecs);
+    qint64 size() const;
+
+    // Points must not be older than the high watermark
+    bool append(qint64 msecs, double speed, double charge);
+    // Makes appended points durable against a crash of the process
+    bool flush();
+    // Drops everything, for a full reload
+    bool clear();
+    // Deletes the sealed segments whose points are all older than 'msecs'
+    void removeBefore(qint64 msecs);
+
+    // Appends the stored points from 'fromMsecs' on, oldest first
+    void load(CompressedTelemetry& points, qint64 fromMsecs) const;
+
+    static const int SEGMENT_POINTS = 65536;
+    static const int INDEX_CHUNK_POINTS = 4096;
+
+private:
+    struct Record {
+        qint64 msecs;
+        double speed;
+        double charge;
+    };
+
+    struct ChunkRange {
+        qint64 firstMsecs;
+        qint64 lastMsecs;
+    };
+
+    struct Segment {
+        std::unique_ptr<QFile> file;
+        const uchar *data = nullptr;
+        qint64 count = 0;
+        qint64 first = 0; // records before it are older than the previous segment and ignored
+        qint64 firstMsecs = 0;
+        qint64 lastMsecs = 0;
+        const qint64 *msecs = nullptr;
+        const double *speeds = nullptr;
+        const double *charges = nullptr;
+        const ChunkRange *chunks = nullptr;
+        qint64 chunkCount = 0;
+    };
+
+    bool mapSegment(const QString& path, Segment& segment);
+    bool sameAsSegmentRecord(const Record& record, const Segment& segment, qint64 index) const;
+    bool replayLog();
+    bool writeLogHeader();
+    bool rollOver();
+
+    QString m_directory;
+    QList<std::shared_ptr<Segment>> m_segments; // oldest first
+    QFile m_log;
+    QList<Record> m_logRecords; // also kept in memory, they are rolled over from here
+    qint64 m_lastMsecs;
+    qint64 m_speedWatermark;
+    qint64 m_chargeWatermark;
+    bool m_watermarksChanged;
+};
+
+#endif // TELEMETRYSEGMENTSTORE_H
@@ -0,0 +1,169 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "compressedtelemetry.h"
+
+// Every point has to come back bit for bit, from sealed blocks and the open one
+class TestCompressedTelemetry : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripAcrossBlocks();
+    void blockSummaries();
+    void pointsBetweenBlockBoundaries();
+    void removeBeforeKeepsStraddlingBlock();
+
+private:
+    struct Columns {
+        QList<qint64> msecs;
+        QList<double> speeds;
+        QList<double> charges;
+    };
+
+    static Columns generate(qsizetype count);
+    static CompressedTelemetry fill(const Columns& columns);
+    static bool sameBits(double a, double b);
+};
+
+// Irregular sampling with repeated timestamps, jumps of days and of a few
+// milliseconds; values that flip sign, repeat, are NaN, infinite or denormal
+TestCompressedTelemetry::Columns TestCompressedTelemetry::generate(qsizetype count)
+{
+    QRandomGenerator random(48);
+    Columns columns;
+    qint64 msecs = -86400000; // before the epoch, the first timestamp is stored raw
+    double charge = 90.0;
+    for (qsizetype i = 0; i < count; ++i) {
+        switch (random.bounded(8)) {
+        case 0: break;                                              // same time again
+        case 1: msecs += qint64(random.bounded(20)) * 86400000; break; // days
+        case 2: msecs += 1 + random.bounded(5); break;
+        default: msecs += 1000; break;                              // regular 1 Hz
+        }
+
+        double speed = 0.0;
+        switch (random.bounded(10)) {
+        case 0: speed = -random.bounded(30.0); break;
+        case 1: speed = -0.0; break;
+        case 2: speed = std::numeric_limits<double>::quiet_NaN(); break;
+        case 3: speed = i % 2 ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity(); break;
+        case 4: speed = std::numeric_limits<double>::denorm_min() * random.bounded(100); break;
+        case 5: speed = random.bounded(2) ? 1e300 : -1e-300; break;
+        default: speed = random.bounded(30.0); break;
+        }
+        if (random.bounded(5) == 0) {
+            charge = random.bounded(3) == 0 ? std::numeric_limits<double>::quiet_NaN() : random.bounded(100.0);
+        }
+
+        columns.msecs.append(msecs);
+        columns.speeds.append(speed);
+        columns.charges.append(charge);
+    }
+    return columns;
+}
+
+CompressedTelemetry TestCompressedTelemetry::fill(const Columns& columns)
+{
+    CompressedTelemetry telemetry;
+    for (qsizetype i = 0; i < columns.msecs.size(); ++i) {
+        telemetry.append(columns.msecs[i], columns.speeds[i], columns.charges[i]);
+    }
+    return telemetry;
+}
+
+bool TestCompressedTelemetry::sameBits(double a, double b)
+{
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+void TestCompressedTelemetry::roundTripAcrossBlocks()
+{
+    // Sealed blocks, a block that is exactly full and a partial open block
+    for (qsizetype count : { qsizetype(1), qsizetype(CompressedTelemetry::BLOCK_POINTS),
+                             qsizetype(CompressedTelemetry::BLOCK_POINTS + 1),
+                             qsizetype(3 * CompressedTelemetry::BLOCK_POINTS + 17) }) {
+        const Columns columns = generate(count);
+        const CompressedTelemetry telemetry = fill(columns);
+        QCOMPARE(telemetry.size(), count);
+
+        Columns decoded;
+        for (int block = 0; block < telemetry.blockCount(); ++block) {
+            telemetry.decodeBlock(block, decoded.msecs, decoded.speeds, decoded.charges);
+        }
+        QCOMPARE(decoded.msecs, columns.msecs);
+        QCOMPARE(decoded.speeds.size(), count);
+        for (qsizetype i = 0; i < count; ++i) {
+            QVERIFY(sameBits(decoded.speeds[i], columns.speeds[i]));
+            QVERIFY(sameBits(decoded.charges[i], columns.charges[i]));
+        }
+
+        QVERIFY(sameBits(telemetry.first().speed, columns.speeds.first()));
+        QCOMPARE(telemetry.first().timestamp.toMSecsSinceEpoch(), columns.msecs.first());
+        QCOMPARE(telemetry.last().timestamp.toMSecsSinceEpoch(), columns.msecs.last());
+        QCOMPARE(telemetry.lastMsecs(), columns.msecs.last());
+    }
+}
+
+void TestCompressedTelemetry::blockSummaries()
+{
+    const qsizetype count = 2 * CompressedTelemetry::BLOCK_POINTS + 5;
+    const Columns columns = generate(count);
+    const CompressedTelemetry telemetry = fill(columns);
+
+    QCOMPARE(telemetry.blockCount(), 3);
+    for (int block = 0; block < telemetry.blockCount(); ++block) {
+        const CompressedTelemetry::BlockSummary summary = telemetry.summary(block);
+        const qsizetype first = qsizetype(block) * CompressedTelemetry::BLOCK_POINTS;
+        QCOMPARE(summary.count, block < 2 ? int(CompressedTelemetry::BLOCK_POINTS) : 5);
+        QCOMPARE(summary.firstMsecs, columns.msecs[first]);
+        QCOMPARE(summary.lastMsecs, columns.msecs[first + summary.count - 1]);
+    }
+}
+
+void TestCompressedTelemetry::pointsBetweenBlockBoundaries()
+{
+    CompressedTelemetry telemetry;
+    const qint64 count = 3 * CompressedTelemetry::BLOCK_POINTS + 100;
+    for (qint64 i = 0; i < count; ++i) {
+        telemetry.append(i * 1000, double(i), 50.0);
+    }
+
+    // Last point of the first block to the first of the third
+    const qint64 from = CompressedTelemetry::BLOCK_POINTS - 1;
+    const qint64 to = 2 * CompressedTelemetry::BLOCK_POINTS;
+    const QList<VehicleDataPoint> points = telemetry.pointsBetween(from * 1000, to * 1000);
+    QCOMPARE(points.size(), qsizetype(to - from + 1));
+    for (qsizetype k = 0; k < points.size(); ++k) {
+        QCOMPARE(points[k].timestamp.toMSecsSinceEpoch(), (from + k) * 1000);
+        QCOMPARE(points[k].speed, double(from + k));
+    }
+
+    // Only the open block
+    QCOMPARE(telemetry.pointsBetween((count - 10) * 1000, count * 1000).size(), qsizetype(10));
+    QVERIFY(telemetry.pointsBetween(count * 1000, (count + 10) * 1000).isEmpty());
+}
+
+void TestCompressedTelemetry::removeBeforeKeepsStraddlingBlock()
+{
+    CompressedTelemetry telemetry;
+    const qint64 count = 3 * CompressedTelemetry::BLOCK_POINTS + 100;
+    for (qint64 i = 0; i < count; ++i) {
+        telemetry.append(i * 1000, 1.0, 50.0);
+    }
+
+    telemetry.removeBefore((CompressedTelemetry::BLOCK_POINTS + 10) * 1000);
+    QCOMPARE(telemetry.blockCount(), 3);
+    QCOMPARE(telemetry.size(), qsizetype(count - CompressedTelemetry::BLOCK_POINTS));
+    QCOMPARE(telemetry.first().timestamp.toMSecsSinceEpoch(), qint64(CompressedTelemetry::BLOCK_POINTS) * 1000);
+
+    telemetry.removeBefore(count * 1000);
+    QVERIFY(telemetry.isEmpty());
+    QCOMPARE(telemetry.blockCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestCompressedTelemetry)
+#include "tst_compressedtelemetry.moc"
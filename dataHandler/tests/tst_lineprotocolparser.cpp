@@ -0,0 +1,186 @@
+#include <QtTest>
+#include <QTimeZone>
+
+#include "lineprotocolparser.h"
+#include "lineprotocollistener.h"
+
+// The push ingest tokenizer, and the listener's payload parsing on top of it
+class TestLineProtocolParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void splitsSections();
+    void escapesAndQuotedStrings();
+    void skipsCommentsAndMalformedLines();
+    void findField();
+    void parseNumber_data();
+    void parseNumber();
+    void parseTimestamp_data();
+    void parseTimestamp();
+    void parsePayload();
+};
+
+void TestLineProtocolParser::splitsSections()
+{
+    const QByteArray data = "Vehicle/1/qt/speed,host=car,unit=ms value=2.5,ok=true 1700000000\n"
+                            "Vehicle/1/qt/charge value=80i\n";
+    LineProtocolParser parser(data);
+    LineProtocolLine line;
+
+    QVERIFY(parser.next(line));
+    QCOMPARE(line.measurement, QByteArrayView("Vehicle/1/qt/speed"));
+    QCOMPARE(line.tags, QByteArrayView("host=car,unit=ms"));
+    QCOMPARE(line.fields, QByteArrayView("value=2.5,ok=true"));
+    QCOMPARE(line.timestamp, QByteArrayView("1700000000"));
+
+    // No tags and no timestamp
+    QVERIFY(parser.next(line));
+    QCOMPARE(line.measurement, QByteArrayView("Vehicle/1/qt/charge"));
+    QVERIFY(line.tags.isEmpty());
+    QCOMPARE(line.fields, QByteArrayView("value=80i"));
+    QVERIFY(line.timestamp.isEmpty());
+
+    QVERIFY(!parser.next(line));
+    QCOMPARE(parser.errorCount(), 0);
+}
+
+void TestLineProtocolParser::escapesAndQuotedStrings()
+{
+    // Escaped separators in the key, spaces, commas and escaped quotes in a string field
+    const QByteArray data = R"(Vehicle/1/qt/my\ speed,site=a\,b value=1,note="stop, then \"go\" now" 42)";
+    LineProtocolParser parser(data);
+    LineProtocolLine line;
+
+    QVERIFY(parser.next(line));
+    QCOMPARE(line.measurement, QByteArrayView(R"(Vehicle/1/qt/my\ speed)"));
+    QCOMPARE(line.tags, QByteArrayView(R"(site=a\,b)"));
+    QCOMPARE(line.fields, QByteArrayView(R"(value=1,note="stop, then \"go\" now")"));
+    QCOMPARE(line.timestamp, QByteArrayView("42"));
+    QCOMPARE(parser.errorCount(), 0);
+}
+
+void TestLineProtocolParser::skipsCommentsAndMalformedLines()
+{
+    const QByteArray data = "# comment line\n"
+                            "\n"
+                            "   \n"
+                            "no_fields\n"
+                            "m value=1\r\n"
+                            "m \n"
+                            "m value=2";
+    LineProtocolParser parser(data);
+    LineProtocolLine line;
+
+    QVERIFY(parser.next(line));
+    QCOMPARE(line.fields, QByteArrayView("value=1"));
+    QVERIFY(line.timestamp.isEmpty()); // the CR is not part of the line
+    QVERIFY(parser.next(line));
+    QCOMPARE(line.fields, QByteArrayView("value=2"));
+    QVERIFY(!parser.next(line));
+    QCOMPARE(parser.errorCount(), 2);
+}
+
+void TestLineProtocolParser::findField()
+{
+    const QByteArrayView fields = R"(note="a,value=9",speed=3,value=4.5i)";
+    QByteArrayView value;
+
+    // A key inside a quoted string is not a field
+    QVERIFY(LineProtocolParser::findField(fields, "value", value));
+    QCOMPARE(value, QByteArrayView("4.5i"));
+    QVERIFY(LineProtocolParser::findField(fields, "note", value));
+    QCOMPARE(value, QByteArrayView(R"("a,value=9")"));
+    QVERIFY(!LineProtocolParser::findField(fields, "charge", value));
+    QVERIFY(!LineProtocolParser::findField(fields, "val", value));
+}
+
+void TestLineProtocolParser::parseNumber_data()
+{
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<double>("expected");
+
+    QTest::newRow("float") << QByteArray("2.5") << true << 2.5;
+    QTest::newRow("exponent") << QByteArray("-1.5e3") << true << -1500.0;
+    QTest::newRow("integer") << QByteArray("80i") << true << 80.0;
+    QTest::newRow("unsigned") << QByteArray("7u") << true << 7.0;
+    QTest::newRow("true") << QByteArray("t") << true << 1.0;
+    QTest::newRow("false") << QByteArray("FALSE") << true << 0.0;
+    QTest::newRow("string") << QByteArray("\"3\"") << false << 0.0;
+    QTest::newRow("empty") << QByteArray() << false << 0.0;
+    QTest::newRow("text") << QByteArray("fast") << false << 0.0;
+}
+
+void TestLineProtocolParser::parseNumber()
+{
+    QFETCH(QByteArray, value);
+    QFETCH(bool, ok);
+    QFETCH(double, expected);
+
+    double result = 0.0;
+    QCOMPARE(LineProtocolParser::parseNumber(value, result), ok);
+    if (ok) {
+        QCOMPARE(result, expected);
+    }
+}
+
+void TestLineProtocolParser::parseTimestamp_data()
+{
+    QTest::addColumn<QByteArray>("precision");
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<qint64>("msecs");
+
+    QTest::newRow("default is ns") << QByteArray() << QByteArray("1700000000123456789") << qint64(1700000000123);
+    QTest::newRow("us") << QByteArray("us") << QByteArray("1700000000123456") << qint64(1700000000123);
+    QTest::newRow("u") << QByteArray("u") << QByteArray("1700000000123456") << qint64(1700000000123);
+    QTest::newRow("ms") << QByteArray("ms") << QByteArray("1700000000123") << qint64(1700000000123);
+    QTest::newRow("s") << QByteArray("s") << QByteArray("1700000000") << qint64(1700000000000);
+    QTest::newRow("before epoch") << QByteArray("s") << QByteArray("-60") << qint64(-60000);
+}
+
+void TestLineProtocolParser::parseTimestamp()
+{
+    QFETCH(QByteArray, precision);
+    QFETCH(QByteArray, value);
+    QFETCH(qint64, msecs);
+
+    qint64 result = 0;
+    QVERIFY(LineProtocolParser::parseTimestamp(value, LineProtocolParser::precisionFromString(precision), result));
+    QCOMPARE(result, msecs);
+    QVERIFY(!LineProtocolParser::parseTimestamp("12.5", LineProtocolPrecision::Seconds, result));
+}
+
+void TestLineProtocolParser::parsePayload()
+{
+    const QByteArray payload = "Vehicle/1/qt/speed value=2.5 1700000000\n"
+                               "Vehicle/1/qt/charge,src=etl value=80i 1700000001\n"
+                               "Vehicle/1/Speed value=1500 1700000002\n"    // raw topic, ignored
+                               "cpu,host=a usage=3 1700000003\n"            // not a vehicle, ignored
+                               "Vehicle/1/qt/speed other=1 1700000004\n"    // no value field
+                               "Vehicle/1/qt/speed value=\"x\" 1700000005\n" // not a number
+                               "Vehicle/1/qt/speed value=1 soon\n"          // bad timestamp
+                               "Vehicle/2/qt/my\\ speed value=3 1700000006\n";
+    int rejected = 0;
+    const QList<TelemetrySample> samples = LineProtocolListener::parsePayload(payload, LineProtocolPrecision::Seconds,
+                                                                              &rejected);
+
+    QCOMPARE(rejected, 3);
+    QCOMPARE(samples.size(), qsizetype(3));
+    QCOMPARE(samples[0].measurement, QString("Vehicle/1/qt/speed"));
+    QCOMPARE(samples[0].value, 2.5);
+    QCOMPARE(samples[0].timestamp, QDateTime::fromMSecsSinceEpoch(1700000000000, QTimeZone::UTC));
+    QCOMPARE(samples[1].measurement, QString("Vehicle/1/qt/charge"));
+    QCOMPARE(samples[1].value, 80.0);
+    QCOMPARE(samples[2].measurement, QString("Vehicle/2/qt/my speed"));
+
+    // Without a timestamp the sample is taken at the time it was received
+    const qint64 before = QDateTime::currentMSecsSinceEpoch();
+    const QList<TelemetrySample> untimed = LineProtocolListener::parsePayload("Vehicle/1/qt/speed value=1",
+                                                                              LineProtocolPrecision::Nanoseconds);
+    QCOMPARE(untimed.size(), qsizetype(1));
+    QVERIFY(untimed[0].timestamp.toMSecsSinceEpoch() >= before);
+}
+
+QTEST_GUILESS_MAIN(TestLineProtocolParser)
+#include "tst_lineprotocolparser.moc"
@@ -0,0 +1,124 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cmath>
+
+#include "speedfilter.h"
+
+class TestSpeedFilter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void spikeIsRemoved();
+    void stepPassesThrough();
+    void matchesReference_data();
+    void matchesReference();
+    void stateRoundTrip();
+
+private:
+    static double median(QList<double> values);
+};
+
+double TestSpeedFilter::median(QList<double> values)
+{
+    std::sort(values.begin(), values.end());
+    const qsizetype middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+void TestSpeedFilter::spikeIsRemoved()
+{
+    SpeedFilter filter(5, 3.0);
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(filter.filter(0.0), 0.0);
+    }
+    QCOMPARE(filter.filter(8.0), 0.0);
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(filter.filter(0.0), 0.0);
+    }
+}
+
+void TestSpeedFilter::stepPassesThrough()
+{
+    // Small changes of a steady speed are not outliers, even with a MAD of 0
+    SpeedFilter filter(5, 3.0);
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(filter.filter(2.0), 2.0);
+    }
+    QCOMPARE(filter.filter(2.3), 2.3);
+
+    // A step is held back only until it is the window's median
+    SpeedFilter stepFilter(5, 3.0);
+    for (int i = 0; i < 10; ++i) {
+        stepFilter.filter(0.0);
+    }
+    QCOMPARE(stepFilter.filter(5.0), 0.0);
+    QCOMPARE(stepFilter.filter(5.0), 0.0);
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(stepFilter.filter(5.0), 5.0);
+    }
+}
+
+void TestSpeedFilter::matchesReference_data()
+{
+    QTest::addColumn<int>("window");
+    QTest::addColumn<double>("sigmas");
+
+    for (int window : { 2, 4, 5, 8, 9, 31 }) {
+        QTest::addRow("median %d", window) << window << 0.0;
+        QTest::addRow("hampel %d", window) << window << 3.0;
+    }
+}
+
+void TestSpeedFilter::matchesReference()
+{
+    QFETCH(int, window);
+    QFETCH(double, sigmas);
+
+    // Noisy speeds with repeats, so ties and a zero MAD both occur
+    QRandomGenerator random(window);
+    SpeedFilter filter(window, sigmas);
+    QList<double> recent;
+    for (int i = 0; i < 5000; ++i) {
+        const double speed = random.bounded(4) == 0 ? random.bounded(12.0) : double(random.bounded(3));
+        recent.append(speed);
+        if (recent.size() > window) recent.removeFirst();
+
+        const double center = median(recent);
+        double expected = center;
+        if (sigmas > 0.0) {
+            QList<double> deviations;
+            for (double value : recent) {
+                deviations.append(std::fabs(value - center));
+            }
+            const double mad = qMax(0.1, median(deviations));
+            expected = std::fabs(speed - center) > sigmas * 1.4826 * mad ? center : speed;
+        }
+        QCOMPARE(filter.filter(speed), expected);
+    }
+}
+
+void TestSpeedFilter::stateRoundTrip()
+{
+    SpeedFilter filter(7, 3.0);
+    for (int i = 0; i < 20; ++i) {
+        filter.filter(i % 3 * 1.5);
+    }
+    QByteArray state;
+    {
+        QDataStream out(&state, QIODevice::WriteOnly);
+        filter.saveState(out);
+    }
+    SpeedFilter restored(7, 3.0);
+    QDataStream in(state);
+    QVERIFY(restored.restoreState(in));
+
+    for (int i = 0; i < 20; ++i) {
+        const double speed = i % 4 == 0 ? 9.0 : 1.0;
+        QCOMPARE(restored.filter(speed), filter.filter(speed));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestSpeedFilter)
+#include "tst_speedfilter.moc"
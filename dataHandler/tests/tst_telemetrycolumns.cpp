@@ -0,0 +1,136 @@
+#include <QtTest>
+#include <cmath>
+
+#include "telemetrycolumns.h"
+
+// Merging the speed and charge columns of a query onto one timeline
+class TestTelemetryColumns : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void normalizeSortsAndKeepsLastDuplicate();
+    void removeAfter();
+    void toDataPointsCarriesValuesForward();
+    void alignSeries_data();
+    void alignSeries();
+
+private:
+    // One sample a second from 1 s up to 'untilMsecs', empty for 0
+    static TelemetrySeries everySecond(qint64 untilMsecs, double value);
+};
+
+TelemetrySeries TestTelemetryColumns::everySecond(qint64 untilMsecs, double value)
+{
+    TelemetrySeries series;
+    for (qint64 msecs = 1000; msecs <= untilMsecs; msecs += 1000) {
+        series.append(msecs, value);
+    }
+    return series;
+}
+
+void TestTelemetryColumns::normalizeSortsAndKeepsLastDuplicate()
+{
+    TelemetrySeries series;
+    series.append(3000, 1.0);
+    series.append(1000, 2.0);
+    series.append(2000, 3.0);
+    series.append(1000, 4.0);
+    series.append(3000, 5.0);
+    series.normalize();
+
+    QCOMPARE(series.timestamps, QList<qint64>({ 1000, 2000, 3000 }));
+    QCOMPARE(series.values, QList<double>({ 4.0, 3.0, 5.0 }));
+
+    // Already sorted, duplicates only
+    TelemetrySeries sorted;
+    sorted.append(1000, 1.0);
+    sorted.append(1000, 2.0);
+    sorted.normalize();
+    QCOMPARE(sorted.timestamps, QList<qint64>({ 1000 }));
+    QCOMPARE(sorted.values, QList<double>({ 2.0 }));
+}
+
+void TestTelemetryColumns::removeAfter()
+{
+    TelemetrySeries series = everySecond(5000, 1.0);
+    series.removeAfter(3000); // inclusive
+    QCOMPARE(series.timestamps, QList<qint64>({ 1000, 2000, 3000 }));
+    QCOMPARE(series.values.size(), qsizetype(3));
+    series.removeAfter(500);
+    QVERIFY(series.isEmpty());
+}
+
+void TestTelemetryColumns::toDataPointsCarriesValuesForward()
+{
+    TelemetryColumns columns;
+    columns.speed.append(3000, 3.0);
+    columns.speed.append(1000, 1.0); // out of order, sorted first
+    columns.charge.append(2000, 80.0);
+    columns.charge.append(3000, 79.0);
+    columns.charge.append(4000, 78.0);
+
+    QList<VehicleDataPoint> points = columns.toDataPoints();
+    QCOMPARE(points.size(), qsizetype(4));
+    QCOMPARE(points[0].timestamp.toMSecsSinceEpoch(), qint64(1000));
+    QCOMPARE(points[0].speed, 1.0);
+    QVERIFY(std::isnan(points[0].batteryCharge)); // no charge seen yet
+    QCOMPARE(points[1].speed, 1.0);
+    QCOMPARE(points[1].batteryCharge, 80.0);
+    QCOMPARE(points[2].timestamp.toMSecsSinceEpoch(), qint64(3000)); // one point for both series
+    QCOMPARE(points[2].speed, 3.0);
+    QCOMPARE(points[2].batteryCharge, 79.0);
+    QCOMPARE(points[3].speed, 3.0);
+    QCOMPARE(points[3].batteryCharge, 78.0);
+
+    // A continued timeline starts from the values before it
+    TelemetryColumns continued;
+    continued.charge.append(5000, 77.0);
+    points = continued.toDataPoints(2.5, 78.0);
+    QCOMPARE(points.size(), qsizetype(1));
+    QCOMPARE(points[0].speed, 2.5);
+    QCOMPARE(points[0].batteryCharge, 77.0);
+}
+
+void TestTelemetryColumns::alignSeries_data()
+{
+    QTest::addColumn<qint64>("speedUntil");
+    QTest::addColumn<qint64>("chargeUntil");
+    QTest::addColumn<qint64>("chargeWatermark");
+    QTest::addColumn<qint64>("speedKept");
+    QTest::addColumn<qint64>("chargeKept");
+
+    QTest::newRow("same time") << qint64(5000) << qint64(5000) << qint64(-1) << qint64(5000) << qint64(5000);
+    QTest::newRow("charge lags within grace") << qint64(20000) << qint64(10000) << qint64(-1)
+                                              << qint64(10000) << qint64(10000);
+    QTest::newRow("speed lags within grace") << qint64(10000) << qint64(20000) << qint64(-1)
+                                             << qint64(10000) << qint64(10000);
+    QTest::newRow("charge lags past grace") << qint64(200000) << qint64(100000) << qint64(-1)
+                                            << qint64(140000) << qint64(100000);
+    QTest::newRow("charge received before") << qint64(20000) << qint64(0) << qint64(5000)
+                                            << qint64(5000) << qint64(0);
+    QTest::newRow("charge never received") << qint64(20000) << qint64(0) << qint64(-1)
+                                           << qint64(20000) << qint64(0);
+}
+
+void TestTelemetryColumns::alignSeries()
+{
+    QFETCH(qint64, speedUntil);
+    QFETCH(qint64, chargeUntil);
+    QFETCH(qint64, chargeWatermark);
+    QFETCH(qint64, speedKept);
+    QFETCH(qint64, chargeKept);
+
+    TelemetryColumns columns;
+    columns.speed = everySecond(speedUntil, 1.0);
+    columns.charge = everySecond(chargeUntil, 50.0);
+    columns.alignSeries(-1, chargeWatermark, 60000);
+
+    QCOMPARE(columns.speed.isEmpty() ? qint64(0) : columns.speed.timestamps.last(), speedKept);
+    QCOMPARE(columns.charge.isEmpty() ? qint64(0) : columns.charge.timestamps.last(), chargeKept);
+    QCOMPARE(columns.speed.values.size(), columns.speed.timestamps.size());
+    QCOMPARE(columns.charge.values.size(), columns.charge.timestamps.size());
+}
+
+QTEST_GUILESS_MAIN(TestTelemetryColumns)
+#include "tst_telemetrycolumns.moc"
@@ -0,0 +1,112 @@
+#include <QtTest>
+#include <QtMath>
+
+#include "telemetryconversion.h"
+
+using namespace TelemetryConversion;
+
+Q_DECLARE_METATYPE(TelemetryConversion::RawTopic)
+
+// Raw MQTT topics and payloads to the treated series, as DataTreatment/main.py does
+class TestTelemetryConversion : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void topics_data();
+    void topics();
+    void rawTopicNames();
+    void extractNumber_data();
+    void extractNumber();
+    void convertRawValue();
+};
+
+void TestTelemetryConversion::topics_data()
+{
+    QTest::addColumn<QString>("topic");
+    QTest::addColumn<RawTopic>("kind");
+    QTest::addColumn<QString>("treated");
+
+    QTest::newRow("speed") << "Vehicle/1/Speed" << RawTopic::Speed << "Vehicle/1/qt/speed";
+    QTest::newRow("charge") << "Vehicle/12/Powertrain/TractionBattery/StateOfCharge"
+                            << RawTopic::StateOfCharge << "Vehicle/12/qt/charge";
+    QTest::newRow("autonomy") << "Vehicle/abc/ADAS/ActiveAutonomyLevel"
+                              << RawTopic::AutonomyLevel << "Vehicle/abc/qt/autonomy_level";
+    QTest::newRow("other signal") << "Vehicle/1/Cabin/Temperature" << RawTopic::Unknown << "";
+    QTest::newRow("suffix only") << "Vehicle/1/Speedometer" << RawTopic::Unknown << "";
+    QTest::newRow("other root") << "Truck/1/Speed" << RawTopic::Unknown << "";
+    QTest::newRow("no vehicle id") << "Vehicle/Speed" << RawTopic::Speed << "";
+}
+
+void TestTelemetryConversion::topics()
+{
+    QFETCH(QString, topic);
+    QFETCH(RawTopic, kind);
+    QFETCH(QString, treated);
+
+    QCOMPARE(rawTopicKind(topic), kind);
+    QCOMPARE(treatedMeasurement(topic), treated);
+}
+
+void TestTelemetryConversion::rawTopicNames()
+{
+    // Every raw topic name is recognized again and maps onto its treated series
+    for (RawTopic kind : { RawTopic::Speed, RawTopic::StateOfCharge, RawTopic::AutonomyLevel }) {
+        const QString topic = rawTopicName(kind, u"7");
+        QVERIFY(topic.startsWith("Vehicle/7/"));
+        QCOMPARE(rawTopicKind(topic), kind);
+        QVERIFY(treatedMeasurement(topic).startsWith("Vehicle/7/qt/"));
+    }
+    QCOMPARE(rawTopicName(RawTopic::Speed, u"+"), QString("Vehicle/+/Speed"));
+    QVERIFY(rawTopicName(RawTopic::Unknown, u"1").isEmpty());
+}
+
+void TestTelemetryConversion::extractNumber_data()
+{
+    QTest::addColumn<QByteArray>("payload");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<double>("value");
+
+    QTest::newRow("plain") << QByteArray("150") << true << 150.0;
+    QTest::newRow("decimal") << QByteArray("87.5") << true << 87.5;
+    QTest::newRow("json") << QByteArray(R"({"value": 42.25, "unit": "rpm"})") << true << 42.25;
+    // Like the ([\d.]+) regex the sign is not part of the number
+    QTest::newRow("negative") << QByteArray("-12") << true << 12.0;
+    QTest::newRow("two dots") << QByteArray("1.2.3") << false << 0.0;
+    QTest::newRow("no digits") << QByteArray("n/a") << false << 0.0;
+    QTest::newRow("empty") << QByteArray() << false << 0.0;
+}
+
+void TestTelemetryConversion::extractNumber()
+{
+    QFETCH(QByteArray, payload);
+    QFETCH(bool, ok);
+    QFETCH(double, value);
+
+    double result = 0.0;
+    QCOMPARE(TelemetryConversion::extractNumber(payload, result), ok);
+    if (ok) {
+        QCOMPARE(result, value);
+    }
+}
+
+void TestTelemetryConversion::convertRawValue()
+{
+    double value = 0.0;
+    QVERIFY(TelemetryConversion::convertRawValue(RawTopic::Speed, "150", value));
+    QCOMPARE(value, 150 * WHEEL_RADIUS_M * 2 * M_PI / 60);
+
+    QVERIFY(TelemetryConversion::convertRawValue(RawTopic::StateOfCharge, "87.5", value));
+    QCOMPARE(value, 87.5);
+    QVERIFY(TelemetryConversion::convertRawValue(RawTopic::StateOfCharge, "120", value));
+    QCOMPARE(value, 100.0);
+
+    QVERIFY(TelemetryConversion::convertRawValue(RawTopic::AutonomyLevel, "3", value));
+    QCOMPARE(value, 3.0);
+
+    QVERIFY(!TelemetryConversion::convertRawValue(RawTopic::Unknown, "1", value));
+    QVERIFY(!TelemetryConversion::convertRawValue(RawTopic::Speed, "stopped", value));
+}
+
+QTEST_GUILESS_MAIN(TestTelemetryConversion)
+#include "tst_telemetryconversion.moc"
@@ -0,0 +1,247 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <cmath>
+
+#include "telemetrysegmentstore.h"
+
+// The store is reopened after every scenario: what open() keeps is what the
+// next start of the application sees.
+class TestTelemetrySegmentStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void rollOverAndReopen();
+    void equalTimestampsAcrossRollOver();
+    void crashDuringRollOver();
+    void overlappingSegmentKeepsNewerPoints();
+    void tornLogRecord();
+    void seriesWatermarks();
+
+private:
+    // Same layout as the store's log records
+    struct Record {
+        qint64 msecs;
+        double speed;
+        double charge;
+    };
+
+    static QList<VehicleDataPoint> loadAll(const TelemetrySegmentStore& store);
+    static QStringList segmentFiles(const QString& directory);
+};
+
+QList<VehicleDataPoint> TestTelemetrySegmentStore::loadAll(const TelemetrySegmentStore& store)
+{
+    CompressedTelemetry points;
+    store.load(points, std::numeric_limits<qint64>::min());
+    return points.toDataPoints(0, points.blockCount());
+}
+
+QStringList TestTelemetrySegmentStore::segmentFiles(const QString& directory)
+{
+    return QDir(directory).entryList(QStringList() << "segment-*.tseg", QDir::Files, QDir::Name);
+}
+
+void TestTelemetrySegmentStore::rollOverAndReopen()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const qint64 count = 2 * TelemetrySegmentStore::SEGMENT_POINTS + 1000;
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        for (qint64 i = 0; i < count; ++i) {
+            QVERIFY(store.append(1000 + i * 500, i % 70 * 0.5, 80.0 - i * 1e-4));
+        }
+        QVERIFY(!store.append(10, 1.0, 1.0));
+        QVERIFY(store.flush());
+    }
+    QCOMPARE(segmentFiles(dir.path()).size(), qsizetype(2));
+
+    TelemetrySegmentStore store;
+    QVERIFY(store.open(dir.path()));
+    QCOMPARE(store.size(), count);
+    QCOMPARE(store.highWatermark(), 1000 + (count - 1) * 500);
+
+    // A load from the middle skips whole chunks by the index
+    const qint64 from = 70000;
+    CompressedTelemetry points;
+    store.load(points, 1000 + from * 500);
+    const QList<VehicleDataPoint> loaded = points.toDataPoints(0, points.blockCount());
+    QCOMPARE(loaded.size(), qsizetype(count - from));
+    for (qsizetype k = 0; k < loaded.size(); ++k) {
+        const qint64 i = from + k;
+        QCOMPARE(loaded[k].timestamp.toMSecsSinceEpoch(), 1000 + i * 500);
+        QCOMPARE(loaded[k].speed, i % 70 * 0.5);
+        QCOMPARE(loaded[k].batteryCharge, 80.0 - i * 1e-4);
+    }
+
+    store.removeBefore(1000 + from * 500);
+    QCOMPARE(store.size(), count - TelemetrySegmentStore::SEGMENT_POINTS);
+    QCOMPARE(segmentFiles(dir.path()).size(), qsizetype(1));
+}
+
+void TestTelemetrySegmentStore::equalTimestampsAcrossRollOver()
+{
+    // A speed and a charge sample at the same time, the segment seals
+    // between them; the second segment must survive the reopen
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const qint64 count = 2 * TelemetrySegmentStore::SEGMENT_POINTS + 10;
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        for (qint64 i = 0; i < count; ++i) {
+            QVERIFY(store.append(1000 * ((i + 1) / 2), double(i), 50.0));
+        }
+        QVERIFY(store.flush());
+    }
+
+    TelemetrySegmentStore store;
+    QVERIFY(store.open(dir.path()));
+    QCOMPARE(segmentFiles(dir.path()).size(), qsizetype(2));
+    QCOMPARE(store.size(), count);
+    const QList<VehicleDataPoint> loaded = loadAll(store);
+    QCOMPARE(loaded.size(), qsizetype(count));
+    for (qsizetype i = 0; i < loaded.size(); ++i) {
+        QCOMPARE(loaded[i].speed, double(i));
+    }
+}
+
+void TestTelemetrySegmentStore::crashDuringRollOver()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const qint64 count = TelemetrySegmentStore::SEGMENT_POINTS;
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        for (qint64 i = 0; i < count; ++i) {
+            QVERIFY(store.append(1000 * i, 1.0, 60.0));
+        }
+        QVERIFY(store.flush());
+    }
+
+    // The log still holds the sealed records, as if the process died before
+    // truncating it, followed by a new point at the segment's last time
+    QFile log(QDir(dir.path()).filePath("active.tlog"));
+    QVERIFY(log.open(QIODevice::ReadWrite | QIODevice::Append));
+    for (qint64 i = 0; i < count; ++i) {
+        const Record record = { 1000 * i, 1.0, 60.0 };
+        log.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+    const Record extra = { 1000 * (count - 1), 2.0, 61.0 };
+    log.write(reinterpret_cast<const char *>(&extra), sizeof(extra));
+    log.close();
+
+    TelemetrySegmentStore store;
+    QVERIFY(store.open(dir.path()));
+    QCOMPARE(store.size(), count + 1);
+    const QList<VehicleDataPoint> loaded = loadAll(store);
+    QCOMPARE(loaded.last().speed, 2.0);
+    QCOMPARE(loaded.last().batteryCharge, 61.0);
+}
+
+void TestTelemetrySegmentStore::overlappingSegmentKeepsNewerPoints()
+{
+    QTemporaryDir dir;
+    QTemporaryDir other;
+    QVERIFY(dir.isValid() && other.isValid());
+    const qint64 count = TelemetrySegmentStore::SEGMENT_POINTS;
+    const qint64 overlap = 30000;
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        for (qint64 i = 0; i < count; ++i) {
+            QVERIFY(store.append(i, 0.0, 50.0));
+        }
+    }
+    {
+        // Starts inside the first segment's range
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(other.path()));
+        for (qint64 i = 0; i < count; ++i) {
+            QVERIFY(store.append(count - overlap + i, 1.0, 50.0));
+        }
+    }
+    const QString name = segmentFiles(other.path()).first();
+    QVERIFY(QFile::copy(QDir(other.path()).filePath(name), QDir(dir.path()).filePath(name)));
+
+    TelemetrySegmentStore store;
+    QVERIFY(store.open(dir.path()));
+    QCOMPARE(segmentFiles(dir.path()).size(), qsizetype(2));
+    // Only the points older than the first segment's last one are skipped
+    QCOMPARE(store.size(), count + count - overlap + 1);
+    QCOMPARE(store.highWatermark(), 2 * count - overlap - 1);
+
+    const QList<VehicleDataPoint> loaded = loadAll(store);
+    for (qsizetype i = 1; i < loaded.size(); ++i) {
+        QVERIFY(loaded[i - 1].timestamp <= loaded[i].timestamp);
+    }
+}
+
+void TestTelemetrySegmentStore::tornLogRecord()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        for (qint64 i = 0; i < 100; ++i) {
+            QVERIFY(store.append(i * 1000, 1.0, std::nan("")));
+        }
+    }
+    QFile log(QDir(dir.path()).filePath("active.tlog"));
+    QVERIFY(log.open(QIODevice::WriteOnly | QIODevice::Append));
+    log.write("torn record");
+    log.close();
+
+    TelemetrySegmentStore store;
+    QVERIFY(store.open(dir.path()));
+    QCOMPARE(store.size(), qint64(100));
+    QVERIFY(std::isnan(loadAll(store).last().batteryCharge));
+    QVERIFY(store.append(100 * 1000, 1.0, 1.0));
+}
+
+void TestTelemetrySegmentStore::seriesWatermarks()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        QCOMPARE(store.speedWatermark(), qint64(-1));
+        QCOMPARE(store.chargeWatermark(), qint64(-1));
+        QVERIFY(store.append(5000, 1.0, 2.0));
+        QVERIFY(store.append(6000, 1.0, 2.0));
+        store.setSeriesWatermarks(6000, 5000);
+        QVERIFY(store.flush());
+    }
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        QCOMPARE(store.speedWatermark(), qint64(6000));
+        QCOMPARE(store.chargeWatermark(), qint64(5000));
+        // Never ahead of the stored points
+        store.setSeriesWatermarks(9000, 7000);
+        QVERIFY(store.flush());
+    }
+    {
+        TelemetrySegmentStore store;
+        QVERIFY(store.open(dir.path()));
+        QCOMPARE(store.speedWatermark(), qint64(6000));
+        QCOMPARE(store.chargeWatermark(), qint64(6000));
+        QVERIFY(store.clear());
+        QVERIFY(store.flush());
+    }
+
+    TelemetrySegmentStore store;
+    QVERIFY(store.open(dir.path()));
+    QCOMPARE(store.size(), qint64(0));
+    QCOMPARE(store.speedWatermark(), qint64(-1));
+    QCOMPARE(store.chargeWatermark(), qint64(-1));
+}
+
+QTEST_GUILESS_MAIN(TestTelemetrySegmentStore)
+#include "tst_telemetrysegmentstore.moc"
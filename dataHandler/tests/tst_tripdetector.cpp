@@ -0,0 +1,287 @@
+#include <QtTest>
+#include <QDataStream>
+#include <QRandomGenerator>
+#include <QTimeZone>
+#include <cmath>
+
+#include "tripdetector.h"
+
+// processPoints() splits a batch at timeout gaps and detects the pieces in
+// parallel; it has to end up exactly where feeding the same points one at a
+// time through processPoint() does. A detector restored from a checkpoint
+// has to continue like one that never stopped.
+class TestTripDetector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void batchMatchesPointByPoint_data();
+    void batchMatchesPointByPoint();
+    void parkingAcrossDataGap();
+    void checkpointResumesDetection_data();
+    void checkpointResumesDetection();
+
+private:
+    static QList<VehicleDataPoint> generateDrive(quint32 seed, int segments);
+    static void compareDetectors(TripDetector& batch, TripDetector& single);
+};
+
+// Alternating drives and stops at 1 Hz, with charging while stopped and now
+// and then a data gap longer than the trip timeout
+QList<VehicleDataPoint> TestTripDetector::generateDrive(quint32 seed, int segments)
+{
+    QRandomGenerator random(seed);
+    QList<VehicleDataPoint> points;
+    qint64 msecs = QDateTime(QDate(2025, 6, 1), QTime(8, 0), QTimeZone::UTC).toMSecsSinceEpoch();
+    double charge = 80.0;
+
+    for (int segment = 0; segment < segments; ++segment) {
+        const bool moving = segment % 2 == 0;
+        const int seconds = random.bounded(moving ? 400 : 900);
+        const bool charging = !moving && random.bounded(4) == 0;
+        for (int i = 0; i < seconds; ++i) {
+            double speed = 0.0;
+            if (moving) {
+                speed = 2.0 + random.bounded(8.0);
+                charge -= 0.002;
+            } else {
+                // Stopped, with the odd noisy reading
+                speed = random.bounded(50) == 0 ? random.bounded(1.5) : 0.0;
+                if (charging) charge += 0.01;
+            }
+            points.append(VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::UTC), speed, charge));
+            msecs += 1000;
+        }
+        if (random.bounded(6) == 0) {
+            msecs += 1000 * qint64(400 + random.bounded(3600));
+        }
+    }
+    return points;
+}
+
+void TestTripDetector::compareDetectors(TripDetector& batch, TripDetector& single)
+{
+    QCOMPARE(batch.trips().size(), single.trips().size());
+    for (qsizetype i = 0; i < batch.trips().size(); ++i) {
+        const TripInfo& a = batch.trips().at(i);
+        const TripInfo& b = single.trips().at(i);
+        QCOMPARE(a.tripId, b.tripId);
+        QCOMPARE(a.startTime, b.startTime);
+        QCOMPARE(a.endTime, b.endTime);
+        QCOMPARE(a.stats.count, b.stats.count);
+        QCOMPARE(a.maxSpeed, b.maxSpeed);
+        // Batches merge run statistics, single points add them one by one
+        QVERIFY(std::fabs(a.distanceTraveled - b.distanceTraveled) <= 1e-9 * qMax(1.0, b.distanceTraveled));
+        QVERIFY(std::fabs(a.averageSpeed - b.averageSpeed) <= 1e-9 * qMax(1.0, b.averageSpeed));
+    }
+
+    const QList<TripEvent> batchEvents = batch.takeEvents();
+    const QList<TripEvent> singleEvents = single.takeEvents();
+    QCOMPARE(batchEvents.size(), singleEvents.size());
+    for (qsizetype i = 0; i < batchEvents.size(); ++i) {
+        QCOMPARE(batchEvents[i].type, singleEvents[i].type);
+        QCOMPARE(batchEvents[i].tripIndex, singleEvents[i].tripIndex);
+    }
+
+    for (int machine = 0; machine < 2; ++machine) {
+        const QList<SessionInfo>& a = machine ? batch.sessions().parking().sessions() : batch.sessions().charging().sessions();
+        const QList<SessionInfo>& b = machine ? single.sessions().parking().sessions() : single.sessions().charging().sessions();
+        QCOMPARE(a.size(), b.size());
+        for (qsizetype i = 0; i < a.size(); ++i) {
+            QCOMPARE(a[i].sessionId, b[i].sessionId);
+            QCOMPARE(a[i].startTime, b[i].startTime);
+            QCOMPARE(a[i].endTime, b[i].endTime);
+        }
+    }
+    // Session events may interleave differently between machines, each machine keeps its order
+    QCOMPARE(batch.sessions().takeEvents().size(), single.sessions().takeEvents().size());
+
+    QCOMPARE(batch.inTrip(), single.inTrip());
+    QCOMPARE(batch.nextTripId(), single.nextTripId());
+    QCOMPARE(batch.potentialTripStart(), single.potentialTripStart());
+    QCOMPARE(batch.potentialTripEnd(), single.potentialTripEnd());
+    QCOMPARE(batch.lastMovementTime(), single.lastMovementTime());
+    QCOMPARE(batch.lastDataTime(), single.lastDataTime());
+}
+
+void TestTripDetector::batchMatchesPointByPoint_data()
+{
+    QTest::addColumn<quint32>("seed");
+    QTest::addColumn<bool>("tuned");
+
+    for (quint32 seed = 1; seed <= 4; ++seed) {
+        QTest::addRow("default rules, filter off, seed %u", seed) << seed << false;
+        QTest::addRow("deadband and filter, seed %u", seed) << seed << true;
+    }
+}
+
+void TestTripDetector::batchMatchesPointByPoint()
+{
+    QFETCH(quint32, seed);
+    QFETCH(bool, tuned);
+
+    TripDetectorConfig config;
+    QCOMPARE(config.speedFilterWindow, 0); // the filter is opt-in
+    if (tuned) {
+        config.startSeconds = 45;
+        config.speedThreshold = 0.5;
+        config.speedDeadband = 0.2;
+        config.speedFilterWindow = 9;
+    }
+
+    // Enough points for several parallel tasks
+    const QList<VehicleDataPoint> points = generateDrive(seed, 1200);
+    QVERIFY(points.size() > 4 * TripDetector::PARALLEL_MIN_TASK_POINTS);
+
+    std::unique_ptr<TripDetector> batch = TripDetector::create(config);
+    std::unique_ptr<TripDetector> single = TripDetector::create(config);
+
+    // Uneven batches, so state also has to carry over between calls
+    QRandomGenerator random(seed * 7919);
+    for (qsizetype begin = 0; begin < points.size();) {
+        const qsizetype count = qMin(points.size() - begin, qsizetype(1 + random.bounded(150000)));
+        batch->processPoints(points.mid(begin, count));
+        begin += count;
+    }
+    for (const VehicleDataPoint& point : points) {
+        single->processPoint(point);
+    }
+
+    compareDetectors(*batch, *single);
+}
+
+void TestTripDetector::parkingAcrossDataGap()
+{
+    TripDetectorConfig config;
+    config.speedFilterWindow = 0;
+    std::unique_ptr<TripDetector> detector = TripDetector::create(config);
+
+    const qint64 start = QDateTime(QDate(2025, 6, 1), QTime(8, 0), QTimeZone::UTC).toMSecsSinceEpoch();
+    QList<VehicleDataPoint> points;
+    auto add = [&points, start](qint64 seconds, double speed) {
+        points.append(VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(start + seconds * 1000, QTimeZone::UTC),
+                                       speed, 50.0));
+    };
+    // Parked for 10 minutes, no data for an hour, still parked for 10 more
+    for (qint64 s = 0; s < 600; ++s) add(s, 0.0);
+    for (qint64 s = 4200; s < 4800; ++s) add(s, 0.0);
+    // Another hour without data, then the data resumes with the vehicle moving
+    for (qint64 s = 8400; s < 8460; ++s) add(s, 5.0);
+    detector->processPoints(points);
+
+    const QList<SessionInfo>& parking = detector->sessions().parking().sessions();
+    QCOMPARE(parking.size(), qsizetype(1));
+    QCOMPARE(parking[0].startTime.toMSecsSinceEpoch(), start);
+    QCOMPARE(parking[0].endTime.toMSecsSinceEpoch(), start + qint64(8400) * 1000);
+
+    const QList<SessionEvent> events = detector->sessions().takeEvents();
+    QCOMPARE(events.size(), qsizetype(2));
+    QCOMPARE(events[1].type, SessionEvent::Ended);
+}
+
+void TestTripDetector::checkpointResumesDetection_data()
+{
+    QTest::addColumn<quint32>("seed");
+    QTest::addColumn<bool>("tuned");
+
+    for (quint32 seed = 1; seed <= 4; ++seed) {
+        QTest::addRow("default rules, seed %u", seed) << seed << false;
+        QTest::addRow("deadband and filter, seed %u", seed) << seed << true;
+    }
+}
+
+// A detector restored from a checkpoint and fed the rest of the points ends
+// where one that never stopped does; finished trips are not in the checkpoint,
+// so only what comes after the open trip and sessions is compared
+void TestTripDetector::checkpointResumesDetection()
+{
+    QFETCH(quint32, seed);
+    QFETCH(bool, tuned);
+
+    TripDetectorConfig config;
+    if (tuned) {
+        config.startSeconds = 45;
+        config.speedThreshold = 0.5;
+        config.speedDeadband = 0.2;
+        config.speedFilterWindow = 9;
+    }
+
+    const QList<VehicleDataPoint> points = generateDrive(seed, 60);
+    QRandomGenerator random(seed * 104729);
+    QByteArray checkpoint;
+    // Cuts anywhere: while driving, pending a start or end, parked or charging
+    for (int round = 0; round < 20; ++round) {
+        const qsizetype cut = 1 + random.bounded(int(points.size() - 1));
+        std::unique_ptr<TripDetector> full = TripDetector::create(config);
+        full->processPoints(points.mid(0, cut));
+
+        checkpoint.clear();
+        {
+            QDataStream out(&checkpoint, QIODevice::WriteOnly);
+            full->saveState(out);
+        }
+        full->takeEvents();
+        full->sessions().takeEvents();
+
+        std::unique_ptr<TripDetector> resumed = TripDetector::create(config);
+        {
+            QDataStream in(checkpoint);
+            QVERIFY(resumed->restoreState(in));
+        }
+        QCOMPARE(resumed->nextTripId(), full->nextTripId());
+        QCOMPARE(resumed->inTrip(), full->inTrip());
+        QCOMPARE(resumed->potentialTripStart(), full->potentialTripStart());
+        QCOMPARE(resumed->potentialTripEnd(), full->potentialTripEnd());
+        QCOMPARE(resumed->lastDataTime(), full->lastDataTime());
+
+        const QList<VehicleDataPoint> rest = points.mid(cut);
+        full->processPoints(rest);
+        resumed->processPoints(rest);
+
+        const qsizetype skipped = full->trips().size() - resumed->trips().size();
+        QVERIFY(skipped >= 0);
+        for (qsizetype i = 0; i < resumed->trips().size(); ++i) {
+            const TripInfo& a = resumed->trips().at(i);
+            const TripInfo& b = full->trips().at(skipped + i);
+            QCOMPARE(a.tripId, b.tripId);
+            QCOMPARE(a.startTime, b.startTime);
+            QCOMPARE(a.endTime, b.endTime);
+            QCOMPARE(a.stats.count, b.stats.count);
+            QCOMPARE(a.maxSpeed, b.maxSpeed);
+            QVERIFY(std::fabs(a.distanceTraveled - b.distanceTraveled) <= 1e-9 * qMax(1.0, b.distanceTraveled));
+        }
+
+        const QList<TripEvent> resumedEvents = resumed->takeEvents();
+        const QList<TripEvent> fullEvents = full->takeEvents();
+        QCOMPARE(resumedEvents.size(), fullEvents.size());
+        for (qsizetype i = 0; i < resumedEvents.size(); ++i) {
+            QCOMPARE(resumedEvents[i].type, fullEvents[i].type);
+            QCOMPARE(resumedEvents[i].tripIndex + skipped, qsizetype(fullEvents[i].tripIndex));
+        }
+
+        for (int machine = 0; machine < 2; ++machine) {
+            const QList<SessionInfo>& a = machine ? resumed->sessions().parking().sessions() : resumed->sessions().charging().sessions();
+            const QList<SessionInfo>& b = machine ? full->sessions().parking().sessions() : full->sessions().charging().sessions();
+            QVERIFY(a.size() <= b.size());
+            for (qsizetype i = 0; i < a.size(); ++i) {
+                const SessionInfo& c = b[b.size() - a.size() + i];
+                QCOMPARE(a[i].sessionId, c.sessionId);
+                QCOMPARE(a[i].startTime, c.startTime);
+                QCOMPARE(a[i].endTime, c.endTime);
+            }
+        }
+        QCOMPARE(resumed->sessions().takeEvents().size(), full->sessions().takeEvents().size());
+        QCOMPARE(resumed->nextTripId(), full->nextTripId());
+        QCOMPARE(resumed->lastMovementTime(), full->lastMovementTime());
+    }
+
+    // A checkpoint of other rules is refused
+    TripDetectorConfig otherConfig = config;
+    otherConfig.endSeconds += 30;
+    std::unique_ptr<TripDetector> other = TripDetector::create(otherConfig);
+    QDataStream in(checkpoint);
+    QVERIFY(!other->restoreState(in));
+}
+
+QTEST_GUILESS_MAIN(TestTripDetector)
+#include "tst_tripdetector.moc"
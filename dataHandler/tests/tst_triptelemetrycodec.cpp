@@ -0,0 +1,102 @@
+#include <QtTest>
+#include <QTimeZone>
+#include <cmath>
+#include <limits>
+
+#include "triptelemetrycodec.h"
+
+class TestTripTelemetryCodec : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void unknownValuesStayUnknown();
+    void emptyTrip();
+    void corruptBlob();
+
+private:
+    static VehicleDataPoint point(qint64 msecs, double speed, double charge);
+};
+
+VehicleDataPoint TestTripTelemetryCodec::point(qint64 msecs, double speed, double charge)
+{
+    return VehicleDataPoint(QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::UTC), speed, charge);
+}
+
+void TestTripTelemetryCodec::roundTrip()
+{
+    // Out of order and repeated timestamps, negative speed deltas, values on
+    // the 0.01 grid
+    const qint64 base = 1748764800000;
+    const QList<VehicleDataPoint> points = {
+        point(base, 0.0, 80.0),
+        point(base + 1000, 4.25, 79.99),
+        point(base + 500, 12.5, 79.98),
+        point(base + 500, 3.0, 79.98),
+        point(base + 3600000, 0.01, 12.34),
+        point(base - 86400000, 0.0, 100.0),
+    };
+
+    QList<VehicleDataPoint> decoded;
+    QVERIFY(TripTelemetryCodec::decode(TripTelemetryCodec::encode(points), decoded));
+    QCOMPARE(decoded.size(), points.size());
+    for (qsizetype i = 0; i < points.size(); ++i) {
+        QCOMPARE(decoded[i].timestamp, points[i].timestamp);
+        QCOMPARE(decoded[i].speed, points[i].speed);
+        QCOMPARE(decoded[i].batteryCharge, points[i].batteryCharge);
+    }
+}
+
+void TestTripTelemetryCodec::unknownValuesStayUnknown()
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    const qint64 base = 1748764800000;
+    const QList<VehicleDataPoint> points = {
+        point(base, 1.0, nan),
+        point(base + 1000, 2.0, 55.5),
+        point(base + 2000, nan, nan),
+        point(base + 1500, 3.0, 55.25),
+        point(base + 3000, inf, -inf),
+    };
+
+    QList<VehicleDataPoint> decoded;
+    QVERIFY(TripTelemetryCodec::decode(TripTelemetryCodec::encode(points), decoded));
+    QCOMPARE(decoded.size(), points.size());
+    QVERIFY(std::isnan(decoded[0].batteryCharge));
+    QCOMPARE(decoded[1].batteryCharge, 55.5);
+    QVERIFY(std::isnan(decoded[2].speed));
+    QVERIFY(std::isnan(decoded[2].batteryCharge));
+    // The deltas continue from the last known value
+    QCOMPARE(decoded[3].speed, 3.0);
+    QCOMPARE(decoded[3].batteryCharge, 55.25);
+    QCOMPARE(decoded[3].timestamp.toMSecsSinceEpoch(), base + 1500);
+    QVERIFY(std::isnan(decoded[4].speed));
+    QVERIFY(std::isnan(decoded[4].batteryCharge));
+}
+
+void TestTripTelemetryCodec::emptyTrip()
+{
+    QList<VehicleDataPoint> decoded = { point(0, 1.0, 1.0) };
+    QVERIFY(TripTelemetryCodec::decode(TripTelemetryCodec::encode({}), decoded));
+    QVERIFY(decoded.isEmpty());
+}
+
+void TestTripTelemetryCodec::corruptBlob()
+{
+    QList<VehicleDataPoint> points;
+    for (qint64 i = 0; i < 100; ++i) {
+        points.append(point(i * 1000, i * 0.1, 90.0 - i * 0.01));
+    }
+    const QByteArray blob = TripTelemetryCodec::encode(points);
+
+    QList<VehicleDataPoint> decoded;
+    QVERIFY(!TripTelemetryCodec::decode(blob.left(blob.size() / 2), decoded));
+    QVERIFY(decoded.isEmpty());
+    QVERIFY(!TripTelemetryCodec::decode(blob, decoded, TripTelemetryCodec::ENCODING_VERSION + 1));
+    QVERIFY(decoded.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestTripTelemetryCodec)
+#include "tst_triptelemetrycodec.moc"
@@ -0,0 +1,344 @@
+#ifndef TRIPDATA_H
+#define TRIPDATA_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include <cmath>
+#include <limits>
+
+#include "tripstatskernels.h"
+
+// Battery configuration constants
+const double BATTERY_CAPACITY_MAH = 6 * 3200; // Six 3200 mAh batteries = 19200 mAh total
+const double BATTERY_VOLTAGE = 12.0; // Typical 12V system
+const double BATTERY_CAPACITY_WH = (BATTERY_CAPACITY_MAH / 1000.0) * BATTERY_VOLTAGE; // Watt-hours
+
+// Structure to hold individual data points (speed + battery)
+struct VehicleDataPoint {
+    QDateTime timestamp;
+    double speed;        // m/s
+    double batteryCharge; // percentage (0-100)
+    
+    VehicleDataPoint() : speed(0.0), batteryCharge(0.0) {}
+    VehicleDataPoint(const QDateTime& time, double spd, double charge = 0.0) 
+        : timestamp(time), speed(spd), batteryCharge(charge) {}
+};
+
+// Legacy alias for backward compatibility
+using SpeedDataPoint = VehicleDataPoint;
+
+// Least-squares line through the (time, charge) samples of a trip, updated in
+// O(1) per sample from Welford-style co-moments. Its slope is the discharge
+// rate, which quantized and noisy SoC readings skew far less than the
+// difference of two single samples does.
+struct ChargeRegression {
+    qint64 count;
+    double meanTime;    // seconds since the first sample
+    double meanCharge;  // %
+    double timeM2;
+    double chargeM2;
+    double coMoment;
+    
+    ChargeRegression() : count(0), meanTime(0.0), meanCharge(0.0), timeM2(0.0), chargeM2(0.0), coMoment(0.0) {}
+    
+    void add(double seconds, double charge) {
+        count++;
+        const double dt = seconds - meanTime;
+        const double dc = charge - meanCharge;
+        meanTime += dt / count;
+        meanCharge += dc / count;
+        timeM2 += dt * (seconds - meanTime);
+        chargeM2 += dc * (charge - meanCharge);
+        coMoment += dt * (charge - meanCharge);
+    }
+    
+    // A line with a residual needs three samples spread over time
+    bool hasFit() const { return count >= 3 && timeM2 > 0.0; }
+    double slopePerSecond() const { return hasFit() ? coMoment / timeM2 : 0.0; }
+    
+    double slopeStandardError() const {
+        if (!hasFit()) return 0.0;
+        const double residual = qMax(0.0, chargeM2 - coMoment * coMoment / timeM2);
+        return std::sqrt(residual / (count - 2) / timeM2);
+    }
+    
+    // Two-sided 95% Student t quantile for the slope's count - 2 degrees of
+    // freedom: tabulated up to 4, Cornish-Fisher expansion (within 1%) above
+    double t95() const {
+        static const double small[] = { 12.706, 4.303, 3.182, 2.776 };
+        const qint64 degrees = qMax(qint64(1), count - 2);
+        if (degrees <= 4) return small[degrees - 1];
+        const double z = 1.959964;
+        const double df = double(degrees);
+        return z + (z * z * z + z) / (4.0 * df)
+                 + (5.0 * std::pow(z, 5) + 16.0 * z * z * z + 3.0 * z) / (96.0 * df * df);
+    }
+};
+
+// Running statistics of the points that entered a trip. Updated one point at a
+// time, so they are available in O(1) at any moment, also for ongoing trips,
+// and the points themselves do not have to be kept.
+struct TripStatsAccumulator {
+    qint64 count;
+    double speedSum;
+    double maxSpeed;
+    double meanSpeed;          // Welford running mean
+    double speedM2;            // Welford sum of squared deviations from the mean
+    double speedTimeIntegral;  // trapezoidal integral of speed over time, meters
+    qint64 firstMsecs;
+    qint64 lastMsecs;
+    double lastSpeed;
+    double firstCharge;        // first and last known SoC, 0 while there is none
+    double lastCharge;
+    ChargeRegression charge;   // time in seconds since firstMsecs, SoC readings only
+    double regressionCharge;   // last reading fed to 'charge', NaN before the first
+    
+    TripStatsAccumulator() : count(0), speedSum(0.0), maxSpeed(0.0), meanSpeed(0.0), speedM2(0.0),
+                             speedTimeIntegral(0.0), firstMsecs(0), lastMsecs(0), lastSpeed(0.0),
+                             firstCharge(0.0), lastCharge(0.0),
+                             regressionCharge(std::numeric_limits<double>::quiet_NaN()) {}
+    
+    // The merged timeline repeats the last SoC reading on every speed sample.
+    // Only a new reading enters the regression, so its count (and with it the
+    // standard error and t quantile) is the number of SoC samples rather than
+    // of speed ticks. A reading equal to the previous one cannot be told apart
+    // from a repeat and is left out too, unknown (non-finite) charge always.
+    void addChargeSample(qint64 msecs, double value) {
+        if (!std::isfinite(value) || value == regressionCharge) return;
+        if (std::isnan(regressionCharge)) {
+            firstCharge = value;
+        }
+        lastCharge = value;
+        regressionCharge = value;
+        this->charge.add((msecs - firstMsecs) / 1000.0, value);
+    }
+    
+    void add(qint64 msecs, double speed, double charge) {
+        if (count == 0) {
+            firstMsecs = msecs;
+        } else {
+            speedTimeIntegral += 0.5 * (lastSpeed + speed) * ((msecs - lastMsecs) / 1000.0);
+        }
+        
+        count++;
+        speedSum += speed;
+        if (speed > maxSpeed) {
+            maxSpeed = speed;
+        }
+        const double delta = speed - meanSpeed;
+        meanSpeed += delta / count;
+        speedM2 += delta * (speed - meanSpeed);
+        
+        addChargeSample(msecs, charge);
+        
+        lastMsecs = msecs;
+        lastSpeed = speed;
+    }
+    
+    void add(const VehicleDataPoint& point) {
+        add(point.timestamp.toMSecsSinceEpoch(), point.speed, point.batteryCharge);
+    }
+    
+    // Same as add() for each point of a chronological run given as columns; the
+    // speed statistics come from one vectorized pass
+    void addRange(const qint64 *msecs, const double *speeds, const double *charges, qsizetype n) {
+        if (n <= 0) return;
+        if (count == 0) {
+            firstMsecs = msecs[0];
+        } else {
+            speedTimeIntegral += 0.5 * (lastSpeed + speeds[0]) * ((msecs[0] - lastMsecs) / 1000.0);
+        }
+        
+        const TripStatsKernels::RangeStats range = TripStatsKernels::compute(msecs, speeds, n);
+        speedSum += range.sum;
+        if (range.max > maxSpeed) {
+            maxSpeed = range.max;
+        }
+        speedTimeIntegral += range.integral / 1000.0;
+        
+        // Merge the run's mean and spread into the running ones (Chan et al.)
+        const double rangeMean = speeds[0] + range.shiftedSum / n;
+        const double rangeM2 = qMax(0.0, range.shiftedSumSquares - range.shiftedSum * range.shiftedSum / n);
+        const qint64 total = count + n;
+        const double delta = rangeMean - meanSpeed;
+        meanSpeed += delta * n / total;
+        speedM2 += rangeM2 + delta * delta * (double(count) * n / total);
+        count = total;
+        
+        for (qsizetype i = 0; i < n; ++i) {
+            addChargeSample(msecs[i], charges[i]);
+        }
+        
+        lastMsecs = msecs[n - 1];
+        lastSpeed = speeds[n - 1];
+    }
+    
+    double averageSpeed() const { return count > 0 ? speedSum / count : 0.0; }
+    double speedVariance() const { return count > 1 ? speedM2 / (count - 1) : 0.0; }
+    double elapsedSeconds() const { return (lastMsecs - firstMsecs) / 1000.0; }
+    
+    // Mean speed weighted by the time each sample was valid, m/s
+    double timeWeightedAverageSpeed() const {
+        return elapsedSeconds() > 0 ? speedTimeIntegral / elapsedSeconds() : averageSpeed();
+    }
+    
+    double trapezoidalDistanceKm() const { return speedTimeIntegral / 1000.0; }
+};
+
+// Enhanced structure to hold comprehensive trip information with battery data
+struct TripInfo {
+    int tripId;
+    QDateTime startTime;
+    QDateTime endTime;
+    double maxSpeed;
+    double averageSpeed;
+    double distanceTraveled;
+    qint64 durationSeconds;
+    
+    // Battery and energy data
+    double startBatteryCharge;    // % at trip start
+    double endBatteryCharge;      // % at trip end
+    double batteryUsedPercent;    // % consumed during trip
+    double energyConsumedWh;      // Watt-hours consumed
+    double energyEfficiencyWhKm;  // Wh per km
+    double energyConfidenceWh;    // ± half-width of the 95% interval of energyConsumedWh
+    
+    // Trip metadata
+    QString tripName;
+    QString driverName;
+    QString notes;
+    QString imagePaths;
+    
+    // Statistics of the points seen so far; the points themselves are only kept on request
+    TripStatsAccumulator stats;
+    QList<VehicleDataPoint> dataPoints;
+    
+    TripInfo() : tripId(-1), maxSpeed(0.0), averageSpeed(0.0), distanceTraveled(0.0), 
+                durationSeconds(0), startBatteryCharge(0.0), endBatteryCharge(0.0),
+                batteryUsedPercent(0.0), energyConsumedWh(0.0), energyEfficiencyWhKm(0.0), energyConfidenceWh(0.0),
+                tripName(""), driverName(""), notes(""), imagePaths("") {}
+    
+    void addDataPoint(const VehicleDataPoint& point, bool keepPoint) {
+        stats.add(point);
+        if (keepPoint) {
+            dataPoints.append(point);
+        }
+    }
+    
+    qint64 dataPointCount() const { return stats.count; }
+    
+    void calculateStatistics() {
+        // Trips assembled from stored points rather than through addDataPoint()
+        if (stats.count == 0) {
+            for (const auto& point : dataPoints) {
+                stats.add(point);
+            }
+        }
+        if (stats.count == 0) return;
+        
+        // Get battery data from first and last data points
+        startBatteryCharge = stats.firstCharge;
+        endBatteryCharge = stats.lastCharge;
+        batteryUsedPercent = startBatteryCharge - endBatteryCharge;
+        
+        // With enough samples the usage comes from the fitted discharge rate
+        // over the trip rather than from the two end samples
+        const double elapsed = stats.elapsedSeconds();
+        energyConfidenceWh = 0.0;
+        if (stats.charge.hasFit()) {
+            batteryUsedPercent = -stats.charge.slopePerSecond() * elapsed;
+            const double usedMarginPercent = stats.charge.t95() * stats.charge.slopeStandardError() * elapsed;
+            energyConfidenceWh = (usedMarginPercent / 100.0) * BATTERY_CAPACITY_WH;
+        }
+        
+        // Speed statistics were accumulated as the points arrived. Speed is
+        // weighted by the time each sample covers and distance is the integral
+        // of speed, so irregular sampling does not bias either
+        maxSpeed = stats.maxSpeed;
+        averageSpeed = stats.timeWeightedAverageSpeed();
+        distanceTraveled = stats.trapezoidalDistanceKm();
+        
+        // Calculate duration
+        if (!startTime.isNull() && !endTime.isNull()) {
+            durationSeconds = startTime.secsTo(endTime);
+        }
+        
+        // Calculate energy consumption
+        if (batteryUsedPercent > 0) {
+            energyConsumedWh = (batteryUsedPercent / 100.0) * BATTERY_CAPACITY_WH;
+            
+            // Calculate energy efficiency (Wh per km)
+            if (distanceTraveled > 0) {
+                energyEfficiencyWhKm = energyConsumedWh / distanceTraveled;
+            }
+        }
+    }
+    
+    QString getFormattedDuration() const {
+        int minutes = durationSeconds / 60;
+        int seconds = durationSeconds % 60;
+        return QString("%1 min %2 sec").arg(minutes).arg(seconds);
+    }
+    
+    QString getFormattedDistance() const {
+        return QString("%1 km").arg(distanceTraveled, 0, 'f', 2);
+    }
+    
+    QString getFormattedStartTime() const {
+        return startTime.toString("yyyy-MM-dd hh:mm:ss");
+    }
+    
+    QString getFormattedEndTime() const {
+        return endTime.toString("yyyy-MM-dd hh:mm:ss");
+    }
+    
+    QString getFormattedBatteryUsage() const {
+        return QString("%1% → %2% (-%3%)")
+            .arg(startBatteryCharge, 0, 'f', 1)
+            .arg(endBatteryCharge, 0, 'f', 1)
+            .arg(batteryUsedPercent, 0, 'f', 1);
+    }
+    
+    double energyEfficiencyConfidenceWhKm() const {
+        return distanceTraveled > 0 ? energyConfidenceWh / distanceTraveled : 0.0;
+    }
+    
+    QString getFormattedEnergyConsumption() const {
+        if (energyConfidenceWh > 0) {
+            return QString("%1 ± %2 Wh").arg(energyConsumedWh, 0, 'f', 1).arg(energyConfidenceWh, 0, 'f', 1);
+        }
+        return QString("%1 Wh").arg(energyConsumedWh, 0, 'f', 1);
+    }
+    
+    QString getFormattedEnergyEfficiency() const {
+        if (energyEfficiencyWhKm > 0) {
+            if (energyConfidenceWh > 0) {
+                return QString("%1 ± %2 Wh/km").arg(energyEfficiencyWhKm, 0, 'f', 1)
+                    .arg(energyEfficiencyConfidenceWhKm(), 0, 'f', 1);
+            }
+            return QString("%1 Wh/km").arg(energyEfficiencyWhKm, 0, 'f', 1);
+        }
+        return "N/A";
+    }
+    
+    QString getFormattedTripName() const {
+        if (tripName.isEmpty()) {
+            return QString("Trip %1").arg(tripId);
+        }
+        return tripName;
+    }
+};
+
+// A single raw sample of one measurement, as delivered by the push ingest paths
+struct TelemetrySample {
+    QString measurement;  // e.g. "Vehicle/1/qt/speed"
+    QDateTime timestamp;
+    double value;
+    
+    TelemetrySample() : value(0.0) {}
+    TelemetrySample(const QString& name, const QDateTime& time, double v)
+        : measurement(name), timestamp(time), value(v) {}
+};
+
+#endif // TRIPDATA_H
@@ -0,0 +1,60 @@
+#include "tripdatabasereaders.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QThread>
+#include <QDebug>
+
+TripDatabaseReaders::TripDatabaseReaders(const QString& databasePath, int maxThreads)
+    : m_databasePath(databasePath)
+{
+    m_threadPool.setObjectName("TripDatabaseReaders");
+    m_threadPool.setMaxThreadCount(qMax(1, maxThreads));
+    // Idle threads are kept so their connections and page caches stay warm
+    m_threadPool.setExpiryTimeout(-1);
+}
+
+TripDatabaseReaders::~TripDatabaseReaders()
+{
+    m_threadPool.waitForDone();
+    // The owning thread keeps running, drop its connection here
+    if (m_connections.hasLocalData()) {
+        m_connections.setLocalData(nullptr);
+    }
+}
+
+TripDatabaseReaders::Connection::~Connection()
+{
+    {
+        QSqlDatabase database = QSqlDatabase::database(name, false);
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
+QSqlDatabase TripDatabaseReaders::connection()
+{
+    if (m_connections.hasLocalData()) {
+        return QSqlDatabase::database(m_connections.localData()->name, false);
+    }
+
+    Connection *connection = new Connection;
+    connection->name = QString("trip-reader-%1-%2").arg(quintptr(this), 0, 16)
+                                                   .arg(quintptr(QThread::currentThread()), 0, 16);
+    m_connections.setLocalData(connection);
+
+    QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+    database.setDatabaseName(m_databasePath);
+    database.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+    if (!database.open()) {
+        qDebug() << "TripDatabaseReaders: Failed to open database:" << database.lastError().text();
+        return database;
+    }
+
+    QSqlQuery pragma(database);
+    for (const char *statement : { "PRAGMA cache_size=-4096", "PRAGMA temp_store=MEMORY" }) {
+        if (!pragma.exec(QLatin1String(statement))) {
+            qDebug() << "TripDatabaseReaders: Failed to apply" << statement << ":" << pragma.lastError().text();
+        }
+    }
+    return database;
+}
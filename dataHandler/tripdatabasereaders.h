@@ -0,0 +1,62 @@
+#ifndef TRIPDATABASEREADERS_H
+#define TRIPDATABASEREADERS_H
+
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QFuture>
+#include <QSqlDatabase>
+#include <QtConcurrent>
+#include <type_traits>
+
+// Read-only connections to the trip database, one per thread.
+//
+// SQLite connections cannot be shared between threads, so every thread that
+// reads gets its own, opened on first use and closed when the thread ends.
+// With the database in WAL mode readers never wait for the writer thread: each
+// read transaction sees the last commit from before it started.
+//
+// The GUI thread reads through connection() directly; longer reads (reports,
+// exports) go through run(), which executes them on a small pool of threads
+// inside one read transaction, so all their statements see the same snapshot.
+class TripDatabaseReaders
+{
+public:
+    // The database file must exist with its tables created
+    explicit TripDatabaseReaders(const QString& databasePath, int maxThreads = DEFAULT_THREADS);
+    ~TripDatabaseReaders();
+
+    // Connection of the calling thread, invalid if it could not be opened
+    QSqlDatabase connection();
+
+    // Runs query(QSqlDatabase&) on a pool thread
+    template <typename Function>
+    auto run(Function query) -> QFuture<std::invoke_result_t<Function, QSqlDatabase&>>
+    {
+        return QtConcurrent::run(&m_threadPool, [this, query]() mutable {
+            QSqlDatabase database = connection();
+            const bool snapshot = database.isOpen() && database.transaction();
+            struct EndSnapshot {
+                QSqlDatabase& database;
+                bool active;
+                ~EndSnapshot() { if (active) database.rollback(); }
+            } endSnapshot{database, snapshot};
+            return query(database);
+        });
+    }
+
+    static const int DEFAULT_THREADS = 2;
+
+private:
+    struct Connection {
+        QString name;
+        ~Connection();
+    };
+
+    QString m_databasePath;
+    // Declared before the pool: the pool's threads must end first, their
+    // connections are cleaned up as they exit
+    QThreadStorage<Connection *> m_connections;
+    QThreadPool m_threadPool;
+};
+
+#endif // TRIPDATABASEREADERS_H
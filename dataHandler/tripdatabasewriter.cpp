@@ -0,0 +1,434 @@
+#include "tripdatabasewriter.h"
+#include "triptelemetrycodec.h"
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QDebug>
+
+TripDatabaseWriter::TripDatabaseWriter(const QString& databasePath, QObject *parent)
+    : QThread(parent)
+    , m_databasePath(databasePath)
+    , m_connectionName(QString("trip-writer-%1").arg(quintptr(this), 0, 16))
+    , m_stopping(false)
+{
+    setObjectName("TripDatabaseWriter");
+}
+
+TripDatabaseWriter::~TripDatabaseWriter()
+{
+    stop();
+    wait();
+}
+
+QFuture<bool> TripDatabaseWriter::saveTrip(const TripInfo& trip, const QList<VehicleDataPoint>& telemetry)
+{
+    Command command;
+    command.type = Command::SaveTrip;
+    command.trip = trip;
+    // Only the points passed as telemetry are stored
+    command.trip.dataPoints = telemetry;
+    return enqueue(command, QString("trip:%1").arg(trip.tripId));
+}
+
+QFuture<bool> TripDatabaseWriter::saveSession(SessionEvent::Machine machine, const SessionInfo& session, bool timedOut)
+{
+    Command command;
+    command.type = Command::SaveSession;
+    command.machine = machine;
+    command.session = session;
+    command.timedOut = timedOut;
+    return enqueue(command, QString("%1:%2").arg(machine == SessionEvent::Charging ? "charging" : "parking")
+                                            .arg(session.sessionId));
+}
+
+QFuture<bool> TripDatabaseWriter::updateTripField(int tripId, const QString& field, const QString& value)
+{
+    Command command;
+    command.type = Command::UpdateTrip;
+    command.tripId = tripId;
+    command.field = field;
+    command.value = value;
+    return enqueue(command, QString("trip:%1").arg(tripId));
+}
+
+QFuture<bool> TripDatabaseWriter::deleteTrip(int tripId)
+{
+    Command command;
+    command.type = Command::DeleteTrip;
+    command.tripId = tripId;
+    return enqueue(command, QString("trip:%1").arg(tripId));
+}
+
+QFuture<bool> TripDatabaseWriter::enqueue(Command command, const QString& rowKey)
+{
+    auto promise = std::make_shared<QPromise<bool>>();
+    promise->start();
+    QFuture<bool> future = promise->future();
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_stopping) {
+        locker.unlock();
+        promise->addResult(false);
+        promise->finish();
+        return future;
+    }
+
+    // A newer save of the same row replaces a queued one in place
+    const bool isSave = command.type == Command::SaveTrip || command.type == Command::SaveSession;
+    const auto last = m_lastCommandForRow.constFind(rowKey);
+    if (isSave && last != m_lastCommandForRow.constEnd() && m_queue[*last].type == command.type) {
+        Command& queued = m_queue[*last];
+        if (command.type == Command::SaveTrip && command.trip.dataPoints.isEmpty()) {
+            command.trip.dataPoints = queued.trip.dataPoints;
+        }
+        command.promises = queued.promises;
+        command.promises.append(promise);
+        queued = command;
+        return future;
+    }
+
+    if (m_queue.size() >= MAX_QUEUED_COMMANDS) {
+        // Back-pressure: the writer thread takes the whole queue at once, so
+        // this waits for at most the batch it is writing
+        qDebug() << "TripDatabaseWriter: Queue full, waiting to queue the write for" << rowKey;
+        while (m_queue.size() >= MAX_QUEUED_COMMANDS && !m_stopping) {
+            m_queueTaken.wait(&m_mutex);
+        }
+        if (m_stopping) {
+            locker.unlock();
+            qDebug() << "TripDatabaseWriter: Stopped, dropping write for" << rowKey;
+            promise->addResult(false);
+            promise->finish();
+            return future;
+        }
+    }
+
+    command.promises.append(promise);
+    m_queue.append(command);
+    m_lastCommandForRow.insert(rowKey, m_queue.size() - 1);
+    m_wakeUp.wakeOne();
+    return future;
+}
+
+void TripDatabaseWriter::stop()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stopping = true;
+    m_wakeUp.wakeOne();
+    m_queueTaken.wakeAll();
+}
+
+int TripDatabaseWriter::queuedCommands() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_queue.size());
+}
+
+void TripDatabaseWriter::run()
+{
+    if (!openConnection()) {
+        qDebug() << "TripDatabaseWriter: Writes will fail until restart";
+    }
+
+    while (true) {
+        QList<Command> commands;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.isEmpty() && !m_stopping) {
+                m_wakeUp.wait(&m_mutex);
+            }
+            if (m_queue.isEmpty()) break; // stopping and drained
+            commands.swap(m_queue);
+            m_lastCommandForRow.clear();
+            m_queueTaken.wakeAll();
+        }
+        writeBatch(commands);
+    }
+
+    closeConnection();
+}
+
+void TripDatabaseWriter::closeConnection()
+{
+    // Queries and the connection must go before the connection is removed
+    m_saveTripQuery = QSqlQuery();
+    m_saveChargingQuery = QSqlQuery();
+    m_saveParkingQuery = QSqlQuery();
+    m_deleteTripQuery = QSqlQuery();
+    m_saveTelemetryQuery = QSqlQuery();
+    m_deleteTelemetryQuery = QSqlQuery();
+    m_database.close();
+    m_database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool TripDatabaseWriter::openConnection()
+{
+    m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_database.setDatabaseName(m_databasePath);
+    if (!m_database.open()) {
+        qDebug() << "TripDatabaseWriter: Failed to open database:" << m_database.lastError().text();
+        closeConnection();
+        return false;
+    }
+
+    // WAL lets the UI read while this thread writes, and with it synchronous=NORMAL
+    // only syncs at checkpoints and stays crash safe
+    QSqlQuery pragma(m_database);
+    for (const char *statement : { "PRAGMA journal_mode=WAL", "PRAGMA synchronous=NORMAL",
+                                   "PRAGMA cache_size=-8192", "PRAGMA temp_store=MEMORY",
+                                   "PRAGMA busy_timeout=5000" }) {
+        if (!pragma.exec(QLatin1String(statement))) {
+            qDebug() << "TripDatabaseWriter: Failed to apply" << statement << ":" << pragma.lastError().text();
+        }
+    }
+
+    // Prepared once, every command only binds and executes
+    m_saveTripQuery = QSqlQuery(m_database);
+    if (!m_saveTripQuery.prepare(R"(
+        INSERT OR REPLACE INTO trips (
+            trip_id, start_time, end_time, max_speed, average_speed,
+            distance_traveled, duration_seconds, start_battery_charge,
+            end_battery_charge, battery_used_percent, energy_consumed_wh,
+            energy_efficiency_whkm, energy_confidence_wh, trip_name, driver_name, notes,
+            image_paths, data_points_count
+        ) VALUES (
+            :trip_id, :start_time, :end_time, :max_speed, :average_speed,
+            :distance_traveled, :duration_seconds, :start_battery_charge,
+            :end_battery_charge, :battery_used_percent, :energy_consumed_wh,
+            :energy_efficiency_whkm, :energy_confidence_wh, :trip_name, :driver_name, :notes,
+            :image_paths, :data_points_count
+        )
+    )")) {
+        qDebug() << "TripDatabaseWriter: Failed to prepare trip insert:" << m_saveTripQuery.lastError().text();
+        closeConnection();
+        return false;
+    }
+
+    for (QSqlQuery *sessionQuery : { &m_saveChargingQuery, &m_saveParkingQuery }) {
+        const QLatin1String table(sessionQuery == &m_saveChargingQuery ? "charging_sessions" : "parking_sessions");
+        *sessionQuery = QSqlQuery(m_database);
+        if (!sessionQuery->prepare(QString(R"(
+            INSERT OR REPLACE INTO %1 (
+                session_id, start_time, end_time, duration_seconds, start_charge,
+                end_charge, charge_added_percent, energy_added_wh, timed_out
+            ) VALUES (
+                :session_id, :start_time, :end_time, :duration_seconds, :start_charge,
+                :end_charge, :charge_added_percent, :energy_added_wh, :timed_out
+            )
+        )").arg(table))) {
+            qDebug() << "TripDatabaseWriter: Failed to prepare" << table << "insert:" << sessionQuery->lastError().text();
+            closeConnection();
+            return false;
+        }
+    }
+
+    m_deleteTripQuery = QSqlQuery(m_database);
+    if (!m_deleteTripQuery.prepare("DELETE FROM trips WHERE trip_id = :trip_id")) {
+        qDebug() << "TripDatabaseWriter: Failed to prepare trip delete:" << m_deleteTripQuery.lastError().text();
+        closeConnection();
+        return false;
+    }
+
+    m_saveTelemetryQuery = QSqlQuery(m_database);
+    if (!m_saveTelemetryQuery.prepare(R"(
+        INSERT OR REPLACE INTO trip_telemetry (trip_id, point_count, encoding, data)
+        VALUES (:trip_id, :point_count, :encoding, :data)
+    )")) {
+        qDebug() << "TripDatabaseWriter: Failed to prepare telemetry insert:" << m_saveTelemetryQuery.lastError().text();
+        closeConnection();
+        return false;
+    }
+
+    m_deleteTelemetryQuery = QSqlQuery(m_database);
+    if (!m_deleteTelemetryQuery.prepare("DELETE FROM trip_telemetry WHERE trip_id = :trip_id")) {
+        qDebug() << "TripDatabaseWriter: Failed to prepare telemetry delete:" << m_deleteTelemetryQuery.lastError().text();
+        closeConnection();
+        return false;
+    }
+
+    qDebug() << "TripDatabaseWriter: Writing to" << m_databasePath << "from its own thread";
+    return true;
+}
+
+void TripDatabaseWriter::writeBatch(QList<Command>& commands)
+{
+    for (qsizetype first = 0; first < commands.size(); first += MAX_BATCH_COMMANDS) {
+        const qsizetype last = qMin(commands.size(), first + qsizetype(MAX_BATCH_COMMANDS));
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QList<bool> results(last - first, true);
+        bool committed = commitBatch(commands, first, results);
+        if (!committed && results.contains(true) && results.contains(false)) {
+            // Nothing of the batch was kept, run it again without the failed commands
+            qDebug() << "TripDatabaseWriter: Retrying batch without" << results.count(false) << "failed commands";
+            committed = commitBatch(commands, first, results);
+        }
+
+        int failed = 0;
+        QList<int> changedTripIds;
+        QList<int> deletedTripIds;
+        for (qsizetype i = first; i < last; ++i) {
+            const Command& command = commands[i];
+            const bool ok = committed && results[i - first];
+            if (!ok) {
+                failed++;
+            } else if (command.type == Command::SaveTrip) {
+                changedTripIds.append(command.trip.tripId);
+            } else if (command.type == Command::UpdateTrip) {
+                changedTripIds.append(command.tripId);
+            } else if (command.type == Command::DeleteTrip) {
+                deletedTripIds.append(command.tripId);
+            }
+            for (const auto& promise : command.promises) {
+                promise->addResult(ok);
+                promise->finish();
+            }
+        }
+
+        emit batchWritten(int(last - first), failed, timer.elapsed());
+        if (!changedTripIds.isEmpty() || !deletedTripIds.isEmpty()) {
+            emit tripsWritten(changedTripIds, deletedTripIds);
+        }
+    }
+}
+
+bool TripDatabaseWriter::commitBatch(const QList<Command>& commands, qsizetype first, QList<bool>& results)
+{
+    const bool transaction = m_database.isOpen() && m_database.transaction();
+    bool failed = false;
+    for (qsizetype i = 0; i < results.size(); ++i) {
+        if (!results[i]) continue;
+        results[i] = execute(commands[first + i]);
+        failed = failed || !results[i];
+    }
+
+    // Without a transaction every statement has already been committed on its own
+    if (!transaction) return true;
+
+    if (failed) {
+        qDebug() << "TripDatabaseWriter: Rolling back batch after a failed command";
+        m_database.rollback();
+        return false;
+    }
+    if (!m_database.commit()) {
+        qDebug() << "TripDatabaseWriter: Failed to commit batch:" << m_database.lastError().text();
+        m_database.rollback();
+        return false;
+    }
+    return true;
+}
+
+bool TripDatabaseWriter::execute(const Command& command)
+{
+    if (!m_database.isOpen()) return false;
+
+    switch (command.type) {
+    case Command::SaveTrip: {
+        const TripInfo& trip = command.trip;
+        QSqlQuery& query = m_saveTripQuery;
+        query.bindValue(":trip_id", trip.tripId);
+        query.bindValue(":start_time", trip.startTime.toString(Qt::ISODate));
+        query.bindValue(":end_time", trip.endTime.isNull() ? QVariant() : trip.endTime.toString(Qt::ISODate));
+        query.bindValue(":max_speed", trip.maxSpeed);
+        query.bindValue(":average_speed", trip.averageSpeed);
+        query.bindValue(":distance_traveled", trip.distanceTraveled);
+        query.bindValue(":duration_seconds", trip.durationSeconds);
+        query.bindValue(":start_battery_charge", trip.startBatteryCharge);
+        query.bindValue(":end_battery_charge", trip.endBatteryCharge);
+        query.bindValue(":battery_used_percent", trip.batteryUsedPercent);
+        query.bindValue(":energy_consumed_wh", trip.energyConsumedWh);
+        query.bindValue(":energy_efficiency_whkm", trip.energyEfficiencyWhKm);
+        query.bindValue(":energy_confidence_wh", trip.energyConfidenceWh);
+        query.bindValue(":trip_name", trip.tripName);
+        query.bindValue(":driver_name", trip.driverName);
+        query.bindValue(":notes", trip.notes);
+        query.bindValue(":image_paths", trip.imagePaths);
+        query.bindValue(":data_points_count", trip.dataPointCount());
+
+        if (!query.exec()) {
+            qDebug() << "Failed to save trip to database:" << query.lastError().text();
+            return false;
+        }
+        // One line per row, a backfill saves hundreds of them at once
+        qDebug() << "🗄️ TRIP" << trip.tripId << "SAVED TO DATABASE:" << trip.durationSeconds << "s,"
+                 << trip.distanceTraveled << "km," << trip.energyConsumedWh << "±" << trip.energyConfidenceWh << "Wh,"
+                 << trip.dataPointCount() << "points";
+
+        if (trip.dataPoints.isEmpty()) return true;
+
+        const QByteArray blob = TripTelemetryCodec::encode(trip.dataPoints);
+        m_saveTelemetryQuery.bindValue(":trip_id", trip.tripId);
+        m_saveTelemetryQuery.bindValue(":point_count", qint64(trip.dataPoints.size()));
+        m_saveTelemetryQuery.bindValue(":encoding", TripTelemetryCodec::ENCODING_VERSION);
+        m_saveTelemetryQuery.bindValue(":data", blob);
+        if (!m_saveTelemetryQuery.exec()) {
+            qDebug() << "Failed to save trip telemetry:" << m_saveTelemetryQuery.lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    case Command::SaveSession: {
+        const SessionInfo& session = command.session;
+        const bool charging = command.machine == SessionEvent::Charging;
+        QSqlQuery& query = charging ? m_saveChargingQuery : m_saveParkingQuery;
+        query.bindValue(":session_id", session.sessionId);
+        query.bindValue(":start_time", session.startTime.toString(Qt::ISODate));
+        query.bindValue(":end_time", session.endTime.isNull() ? QVariant() : session.endTime.toString(Qt::ISODate));
+        query.bindValue(":duration_seconds", session.durationSeconds);
+        query.bindValue(":start_charge", session.startCharge);
+        query.bindValue(":end_charge", session.endCharge);
+        query.bindValue(":charge_added_percent", session.chargeAddedPercent());
+        query.bindValue(":energy_added_wh", session.energyAddedWh());
+        query.bindValue(":timed_out", command.timedOut ? 1 : 0);
+
+        if (!query.exec()) {
+            qDebug() << "Failed to save session:" << query.lastError().text();
+            return false;
+        }
+        qDebug() << "🗄️ SESSION" << session.sessionId << "SAVED TO"
+                 << (charging ? "charging_sessions" : "parking_sessions");
+        return true;
+    }
+
+    case Command::UpdateTrip: {
+        // The column name cannot be bound, so only the editable columns are accepted
+        static const QStringList editable = { "trip_name", "driver_name", "notes", "image_paths" };
+        if (!editable.contains(command.field)) {
+            qDebug() << "Refusing to update trip column" << command.field;
+            return false;
+        }
+
+        QSqlQuery query(m_database);
+        query.prepare(QString("UPDATE trips SET %1 = :value WHERE trip_id = :trip_id").arg(command.field));
+        query.bindValue(":value", command.value);
+        query.bindValue(":trip_id", command.tripId);
+
+        if (!query.exec()) {
+            qDebug() << "Failed to update trip in database:" << query.lastError().text();
+            return false;
+        }
+        qDebug() << "✏️ TRIP" << command.tripId << command.field << "UPDATED TO:" << command.value;
+        return true;
+    }
+
+    case Command::DeleteTrip: {
+        m_deleteTripQuery.bindValue(":trip_id", command.tripId);
+        if (!m_deleteTripQuery.exec()) {
+            qDebug() << "Failed to delete trip from database:" << m_deleteTripQuery.lastError().text();
+            return false;
+        }
+        m_deleteTelemetryQuery.bindValue(":trip_id", command.tripId);
+        if (!m_deleteTelemetryQuery.exec()) {
+            qDebug() << "Failed to delete trip telemetry:" << m_deleteTelemetryQuery.lastError().text();
+            return false;
+        }
+        qDebug() << "🗑️ TRIP" << command.tripId << "DELETED FROM DATABASE";
+        return true;
+    }
+    }
+    return false;
+}
@@ -0,0 +1,114 @@
+#ifndef TRIPDATABASEWRITER_H
+#define TRIPDATABASEWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+#include <QPromise>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QList>
+#include <QHash>
+#include <memory>
+
+#include "tripdata.h"
+#include "sessiondetector.h"
+
+// Writes to the trip database from its own thread and its own connection, so
+// slow storage (SD cards on in-vehicle units) never blocks ingest or the UI.
+//
+// Commands go into a bounded queue and are drained in batches, one transaction
+// per batch. A batch is committed whole or not at all: when a command fails it
+// is rolled back and run once more without the failed commands. A save of a
+// trip or session that is still queued is replaced by the newer one
+// (re-analysis re-saves the same trips every cycle), as long as no update or
+// delete of that row was queued in between. When the queue is full the caller
+// waits until the writer thread takes the queued commands, a detected trip or
+// session is never dropped; only commands after stop() fail right away.
+//
+// Every command returns a future that finishes with true once its row has been
+// committed; batchWritten() and tripsWritten() are emitted after every batch.
+class TripDatabaseWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    // The database file must exist with its tables created
+    explicit TripDatabaseWriter(const QString& databasePath, QObject *parent = nullptr);
+    ~TripDatabaseWriter() override;
+
+    // With 'telemetry' the trip's points are also stored in trip_telemetry,
+    // encoded on the writer thread; without, a stored blob is kept as it is
+    QFuture<bool> saveTrip(const TripInfo& trip, const QList<VehicleDataPoint>& telemetry = QList<VehicleDataPoint>());
+    QFuture<bool> saveSession(SessionEvent::Machine machine, const SessionInfo& session, bool timedOut);
+    QFuture<bool> updateTripField(int tripId, const QString& field, const QString& value);
+    QFuture<bool> deleteTrip(int tripId);
+
+    // Finish what is queued, then end the thread
+    void stop();
+
+    int queuedCommands() const;
+
+    static const int MAX_QUEUED_COMMANDS = 4096;
+    static const int MAX_BATCH_COMMANDS = 512;
+
+signals:
+    void batchWritten(int commands, int failed, qint64 elapsedMs);
+    // Trips whose rows a batch committed, saved or updated and deleted
+    void tripsWritten(const QList<int>& changedTripIds, const QList<int>& deletedTripIds);
+
+protected:
+    void run() override;
+
+private:
+    struct Command {
+        enum Type {
+            SaveTrip,
+            SaveSession,
+            UpdateTrip,
+            DeleteTrip
+        };
+
+        Type type = SaveTrip;
+        TripInfo trip;                 // SaveTrip, dataPoints holds the telemetry
+        SessionInfo session;           // SaveSession
+        SessionEvent::Machine machine = SessionEvent::Charging;
+        bool timedOut = false;
+        int tripId = -1;               // UpdateTrip, DeleteTrip
+        QString field;                 // UpdateTrip
+        QString value;
+        // Callers of this command and of the saves it replaced
+        QList<std::shared_ptr<QPromise<bool>>> promises;
+    };
+
+    QFuture<bool> enqueue(Command command, const QString& rowKey);
+    bool openConnection();
+    void closeConnection();
+    bool execute(const Command& command);
+    // Runs the commands whose result is still true in one transaction, a failed
+    // command sets its result to false and rolls the whole batch back
+    bool commitBatch(const QList<Command>& commands, qsizetype first, QList<bool>& results);
+    void writeBatch(QList<Command>& commands);
+
+    QString m_databasePath;
+    QString m_connectionName;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    QWaitCondition m_queueTaken; // enqueue() waiting for room
+    QList<Command> m_queue;
+    QHash<QString, qsizetype> m_lastCommandForRow; // row key -> index in m_queue
+    bool m_stopping;
+
+    // Only used on the writer thread
+    QSqlDatabase m_database;
+    QSqlQuery m_saveTripQuery;
+    QSqlQuery m_saveChargingQuery;
+    QSqlQuery m_saveParkingQuery;
+    QSqlQuery m_deleteTripQuery;
+    QSqlQuery m_saveTelemetryQuery;
+    QSqlQuery m_deleteTelemetryQuery;
+};
+
+#endif // TRIPDATABASEWRITER_H
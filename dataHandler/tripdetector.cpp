@@ -0,0 +1,679 @@
+#include "tripdetector.h"
+#include "motionsegmentation.h"
+#include <QDebug>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+
+TripDetectorConfig TripDetectorConfig::fromEnvironment()
+{
+    TripDetectorConfig config;
+    bool ok = false;
+
+    int seconds = qEnvironmentVariableIntValue("TRIP_START_SECONDS", &ok);
+    if (ok && seconds > 0) config.startSeconds = seconds;
+    seconds = qEnvironmentVariableIntValue("TRIP_END_SECONDS", &ok);
+    if (ok && seconds > 0) config.endSeconds = seconds;
+    seconds = qEnvironmentVariableIntValue("TRIP_TIMEOUT_SECONDS", &ok);
+    if (ok && seconds > 0) config.timeoutSeconds = seconds;
+
+    double speed = qEnvironmentVariable("TRIP_SPEED_THRESHOLD").toDouble(&ok);
+    if (ok && speed >= 0.0) config.speedThreshold = speed;
+    speed = qEnvironmentVariable("TRIP_SPEED_DEADBAND").toDouble(&ok);
+    if (ok && speed >= 0.0) config.speedDeadband = speed;
+
+    if (qEnvironmentVariableIsSet("TRIP_TIMEOUT_AT_GAPS")) {
+        config.timeoutAtGaps = qEnvironmentVariable("TRIP_TIMEOUT_AT_GAPS") != "0";
+    }
+    seconds = qEnvironmentVariableIntValue("TRIP_SPEED_FILTER_WINDOW", &ok);
+    if (ok && seconds >= 0) config.speedFilterWindow = qMin(seconds, int(SpeedFilter::MAX_WINDOW));
+    const double sigmas = qEnvironmentVariable("TRIP_SPEED_FILTER_SIGMAS").toDouble(&ok);
+    if (ok && sigmas >= 0.0) config.speedFilterSigmas = sigmas;
+
+    if (qEnvironmentVariableIsSet("TRIP_KEEP_POINTS")) {
+        config.keepTripPoints = qEnvironmentVariable("TRIP_KEEP_POINTS") != "0";
+    }
+    config.sessions = SessionDetectorConfig::fromEnvironment();
+    return config;
+}
+
+// Everything the rules depend on, a snapshot is only valid for the same values
+static QByteArray configKey(const TripDetectorConfig& config)
+{
+    QByteArray key;
+    QDataStream out(&key, QIODevice::WriteOnly);
+    out << qint32(config.startSeconds) << qint32(config.endSeconds) << qint32(config.timeoutSeconds)
+        << config.speedThreshold << config.speedDeadband << config.timeoutAtGaps
+        << qint32(config.speedFilterWindow) << config.speedFilterSigmas << config.keepTripPoints
+        << qint32(config.sessions.parkingMinSeconds) << config.sessions.chargingMinRisePercent
+        << qint32(config.sessions.chargingEndSeconds);
+    return key;
+}
+
+static void writePoint(QDataStream& out, const VehicleDataPoint& point)
+{
+    out << point.timestamp << point.speed << point.batteryCharge;
+}
+
+static VehicleDataPoint readPoint(QDataStream& in)
+{
+    VehicleDataPoint point;
+    in >> point.timestamp >> point.speed >> point.batteryCharge;
+    return point;
+}
+
+static void writeStats(QDataStream& out, const TripStatsAccumulator& stats)
+{
+    out << stats.count << stats.speedSum << stats.maxSpeed << stats.meanSpeed << stats.speedM2
+        << stats.speedTimeIntegral << stats.firstMsecs << stats.lastMsecs << stats.lastSpeed
+        << stats.firstCharge << stats.lastCharge
+        << stats.charge.count << stats.charge.meanTime << stats.charge.meanCharge
+        << stats.charge.timeM2 << stats.charge.chargeM2 << stats.charge.coMoment << stats.regressionCharge;
+}
+
+static TripStatsAccumulator readStats(QDataStream& in)
+{
+    TripStatsAccumulator stats;
+    in >> stats.count >> stats.speedSum >> stats.maxSpeed >> stats.meanSpeed >> stats.speedM2
+       >> stats.speedTimeIntegral >> stats.firstMsecs >> stats.lastMsecs >> stats.lastSpeed
+       >> stats.firstCharge >> stats.lastCharge
+       >> stats.charge.count >> stats.charge.meanTime >> stats.charge.meanCharge
+       >> stats.charge.timeM2 >> stats.charge.chargeM2 >> stats.charge.coMoment >> stats.regressionCharge;
+    return stats;
+}
+
+// An open trip: what startTrip() set plus the statistics so far
+static void writeOpenTrip(QDataStream& out, const TripInfo& trip)
+{
+    out << qint32(trip.tripId) << trip.startTime << trip.startBatteryCharge
+        << trip.tripName << trip.driverName << trip.notes << trip.imagePaths;
+    writeStats(out, trip.stats);
+    out << qint64(trip.dataPoints.size());
+    for (const VehicleDataPoint& point : trip.dataPoints) {
+        writePoint(out, point);
+    }
+}
+
+static bool readOpenTrip(QDataStream& in, TripInfo& trip)
+{
+    qint32 tripId = -1;
+    in >> tripId >> trip.startTime >> trip.startBatteryCharge
+       >> trip.tripName >> trip.driverName >> trip.notes >> trip.imagePaths;
+    trip.tripId = tripId;
+    trip.stats = readStats(in);
+
+    qint64 pointCount = 0;
+    in >> pointCount;
+    if (in.status() != QDataStream::Ok || pointCount < 0 || pointCount > trip.stats.count) return false;
+    trip.dataPoints.reserve(pointCount);
+    for (qint64 i = 0; i < pointCount; ++i) {
+        trip.dataPoints.append(readPoint(in));
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+TripDetector::TripDetector(const TripDetectorConfig& config)
+    : m_config(config)
+    , m_sessions(config.sessions)
+    , m_speedFilter(config.speedFilterWindow, config.speedFilterSigmas)
+    , m_inTrip(false)
+    , m_moving(false)
+    , m_nextTripId(1)
+    , m_recordSessionRuns(false)
+    , m_potentialStartCharge(0.0)
+    , m_potentialEndCharge(0.0)
+{
+}
+
+void TripDetector::reset(int firstTripId)
+{
+    m_trips.clear();
+    m_events.clear();
+    m_sessions.reset();
+    m_sessionRuns.clear();
+    m_speedFilter.reset();
+    m_inTrip = false;
+    m_moving = false;
+    m_nextTripId = firstTripId;
+    m_potentialTripStart = QDateTime();
+    m_potentialTripEnd = QDateTime();
+    m_lastMovementTime = QDateTime();
+    m_potentialStartCharge = 0.0;
+    m_potentialEndCharge = 0.0;
+    m_pendingStats = TripStatsAccumulator();
+    m_lastPoint = VehicleDataPoint();
+}
+
+bool TripDetector::hasOngoingTrip() const
+{
+    return m_inTrip || (!m_trips.isEmpty() && m_trips.last().endTime.isNull());
+}
+
+bool TripDetector::checkTimeout(const QDateTime& currentTime)
+{
+    if (m_lastPoint.timestamp.isNull()) return false;
+
+    qint64 timeSinceLastData = m_lastPoint.timestamp.secsTo(currentTime);
+
+    qDebug() << "\n=== TIMEOUT CHECK ===";
+    qDebug() << "Current time:" << currentTime.toString();
+    qDebug() << "Last data time:" << m_lastPoint.timestamp.toString();
+    qDebug() << "Time since last data:" << timeSinceLastData << "seconds (" << (timeSinceLastData / 60.0) << "minutes)";
+    qDebug() << "Timeout threshold:" << m_config.timeoutSeconds << "seconds (" << (m_config.timeoutSeconds / 60.0) << "minutes)";
+    qDebug() << "Currently in trip:" << m_inTrip;
+
+    if (timeSinceLastData < m_config.timeoutSeconds || !hasOngoingTrip()) {
+        return false;
+    }
+
+    expireOpenTrip();
+    return true;
+}
+
+void TripDetector::expireOpenTrip()
+{
+    // End the trip at the time of the last data point
+    if (!m_trips.isEmpty() && m_trips.last().endTime.isNull()) {
+        qDebug() << "\n🕐 FORCING TRIP END DUE TO TIMEOUT";
+        endTrip(m_lastPoint.timestamp, m_lastPoint.batteryCharge, TripEvent::TimedOut);
+    }
+
+    m_inTrip = false;
+    m_potentialTripEnd = QDateTime();
+    m_potentialTripStart = QDateTime();
+}
+
+bool TripDetector::isTimeoutGap(const QDateTime& from, const QDateTime& to) const
+{
+    return from.msecsTo(to) >= qint64(m_config.timeoutSeconds) * 1000;
+}
+
+void TripDetector::handleTimeoutGap()
+{
+    expireOpenTrip();
+    if (m_recordSessionRuns) {
+        m_sessionRuns.append({ SessionRun::Gap, 0, 0 });
+    } else {
+        m_sessions.expire();
+    }
+    m_moving = false;
+}
+
+void TripDetector::feedSessions(const PointColumns& batch, const SessionRun& run)
+{
+    if (m_recordSessionRuns) {
+        m_sessionRuns.append(run);
+        return;
+    }
+    switch (run.kind) {
+    case SessionRun::Stopped:
+        m_sessions.processStopped(batch.msecs.constData() + run.first, batch.charges.constData() + run.first,
+                                  run.count);
+        break;
+    case SessionRun::Moving:
+        m_sessions.processMoving(batch.msecs[run.first]);
+        break;
+    case SessionRun::Gap:
+        m_sessions.expire();
+        break;
+    }
+}
+
+void TripDetector::replaySessionRuns(const PointColumns& batch, const QList<SessionRun>& runs)
+{
+    for (const SessionRun& run : runs) {
+        feedSessions(batch, run);
+    }
+}
+
+void TripDetector::append(const TripDetector& later)
+{
+    // 'later' starts after a timeout gap, which closes whatever is open here
+    handleTimeoutGap();
+
+    const int indexOffset = m_trips.size();
+    for (TripInfo trip : later.m_trips) {
+        trip.tripId = m_nextTripId++;
+        m_trips.append(trip);
+    }
+    for (const TripEvent& event : later.m_events) {
+        m_events.append(TripEvent(event.type, event.tripIndex + indexOffset));
+    }
+
+    m_inTrip = later.m_inTrip;
+    m_moving = later.m_moving;
+    m_potentialTripStart = later.m_potentialTripStart;
+    m_potentialTripEnd = later.m_potentialTripEnd;
+    m_potentialStartCharge = later.m_potentialStartCharge;
+    m_potentialEndCharge = later.m_potentialEndCharge;
+    m_pendingStats = later.m_pendingStats;
+    if (!later.m_lastMovementTime.isNull()) {
+        m_lastMovementTime = later.m_lastMovementTime;
+    }
+    m_lastPoint = later.m_lastPoint;
+}
+
+QList<TripEvent> TripDetector::takeEvents()
+{
+    QList<TripEvent> events;
+    events.swap(m_events);
+    return events;
+}
+
+void TripDetector::saveState(QDataStream& out) const
+{
+    out << configKey(m_config);
+    out << m_inTrip << m_moving << qint32(m_nextTripId)
+        << m_potentialTripStart << m_lastMovementTime << m_potentialTripEnd
+        << m_potentialStartCharge << m_potentialEndCharge;
+    writeStats(out, m_pendingStats);
+    writePoint(out, m_lastPoint);
+
+    const bool openTrip = !m_trips.isEmpty() && m_trips.last().endTime.isNull();
+    out << openTrip;
+    if (openTrip) {
+        writeOpenTrip(out, m_trips.last());
+    }
+
+    m_sessions.saveState(out);
+    m_speedFilter.saveState(out);
+}
+
+bool TripDetector::restoreState(QDataStream& in)
+{
+    reset();
+
+    QByteArray key;
+    in >> key;
+    if (key != configKey(m_config)) {
+        qDebug() << "TripDetector: Snapshot was taken with a different config";
+        return false;
+    }
+
+    qint32 nextTripId = 1;
+    in >> m_inTrip >> m_moving >> nextTripId
+       >> m_potentialTripStart >> m_lastMovementTime >> m_potentialTripEnd
+       >> m_potentialStartCharge >> m_potentialEndCharge;
+    m_nextTripId = nextTripId;
+    m_pendingStats = readStats(in);
+    m_lastPoint = readPoint(in);
+
+    bool openTrip = false;
+    in >> openTrip;
+    if (openTrip) {
+        TripInfo trip;
+        if (!readOpenTrip(in, trip)) return false;
+        m_trips.append(trip);
+    }
+
+    return m_sessions.restoreState(in) && m_speedFilter.restoreState(in) && in.status() == QDataStream::Ok;
+}
+
+void TripDetector::addToStats(TripStatsAccumulator& stats, const PointColumns& batch, qsizetype begin, qsizetype end)
+{
+    if (begin >= end) return;
+    stats.addRange(batch.msecs.constData() + begin, batch.speeds.constData() + begin,
+                   batch.charges.constData() + begin, end - begin);
+}
+
+void TripDetector::appendToTrip(const PointColumns& batch, qsizetype begin, qsizetype end)
+{
+    TripInfo& trip = m_trips.last();
+    addToStats(trip.stats, batch, begin, end);
+    if (m_config.keepTripPoints) {
+        for (qsizetype i = begin; i < end; ++i) {
+            // Kept as detected, with the filtered speed
+            VehicleDataPoint point = batch.points[i];
+            point.speed = batch.speeds[i];
+            trip.dataPoints.append(point);
+        }
+    }
+}
+
+void TripDetector::startTrip()
+{
+    m_inTrip = true;
+
+    TripInfo newTrip;
+    newTrip.tripId = m_nextTripId++;
+    newTrip.startTime = m_potentialTripStart;
+    newTrip.startBatteryCharge = m_potentialStartCharge;
+    newTrip.stats = m_pendingStats;
+
+    m_trips.append(newTrip);
+    m_events.append(TripEvent(TripEvent::Started, m_trips.size() - 1));
+
+    m_potentialTripStart = QDateTime();
+}
+
+void TripDetector::endTrip(const QDateTime& endTime, double endCharge, TripEvent::Type reason)
+{
+    TripInfo& currentTrip = m_trips.last();
+    currentTrip.endTime = endTime;
+    currentTrip.endBatteryCharge = endCharge;
+    currentTrip.calculateStatistics();
+
+    m_events.append(TripEvent(reason, m_trips.size() - 1));
+
+    m_inTrip = false;
+    m_potentialTripEnd = QDateTime();
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+BasicTripDetector<Motion, Hysteresis, Timeout>::BasicTripDetector(const TripDetectorConfig& config)
+    : TripDetector(config)
+    , m_enterAbove(Motion::enterAbove(config))
+    , m_stayAbove(Motion::stayAbove(config))
+{
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+QString BasicTripDetector<Motion, Hysteresis, Timeout>::description() const
+{
+    QString filter = QStringLiteral("off");
+    if (m_speedFilter.isEnabled()) {
+        filter = m_speedFilter.sigmas() > 0.0
+            ? QString("hampel %1 samples %2 sigma").arg(m_speedFilter.window()).arg(m_speedFilter.sigmas())
+            : QString("median %1 samples").arg(m_speedFilter.window());
+    }
+    return QString("motion=%1 hysteresis=%2 timeout=%3 (start %4 s, end %5 s, timeout %6 s, moving above %7/%8 m/s, filter %9)")
+        .arg(QLatin1String(Motion::name()), QLatin1String(Hysteresis::name()), QLatin1String(Timeout::name()))
+        .arg(Hysteresis::startSeconds(m_config)).arg(Hysteresis::endSeconds(m_config))
+        .arg(m_config.timeoutSeconds).arg(m_enterAbove).arg(m_stayAbove).arg(filter);
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+void BasicTripDetector<Motion, Hysteresis, Timeout>::processPoint(const VehicleDataPoint& rawPoint)
+{
+    // A trip cannot continue across a gap in the data longer than the timeout
+    if (Timeout::endsAtGaps && !m_lastPoint.timestamp.isNull() && isTimeoutGap(m_lastPoint.timestamp, rawPoint.timestamp)) {
+        handleTimeoutGap();
+        m_speedFilter.reset();
+    }
+    VehicleDataPoint point = rawPoint;
+    point.speed = m_speedFilter.filter(rawPoint.speed);
+    m_lastPoint = point;
+    m_moving = Motion::isMoving(point.speed, m_moving, m_enterAbove, m_stayAbove);
+
+    const qint64 msecs = point.timestamp.toMSecsSinceEpoch();
+    if (m_moving) {
+        m_sessions.processMoving(msecs);
+    } else {
+        m_sessions.processStopped(&msecs, &point.batteryCharge, 1);
+    }
+
+    if (!m_inTrip) {
+        // Looking for trip start
+        if (m_moving) {
+            if (m_potentialTripStart.isNull()) {
+                m_potentialTripStart = point.timestamp;
+                m_potentialStartCharge = point.batteryCharge;
+                m_pendingStats = TripStatsAccumulator();
+                m_pendingStats.add(point);
+                qDebug() << "Potential trip start detected at:" << m_potentialTripStart.toString();
+            } else {
+                m_pendingStats.add(point);
+                if (m_potentialTripStart.secsTo(point.timestamp) >= Hysteresis::startSeconds(m_config)) {
+                    // Moving for long enough - trip confirmed!
+                    startTrip();
+                }
+            }
+            m_lastMovementTime = point.timestamp;
+        } else {
+            // Reset potential trip start if speed goes to zero
+            m_potentialTripStart = QDateTime();
+        }
+        return;
+    }
+
+    // We're in a trip - add data points and check for trip end
+    addToTrip(point);
+
+    if (m_moving) {
+        m_lastMovementTime = point.timestamp;
+        m_potentialTripEnd = QDateTime(); // Reset potential end
+    } else if (m_potentialTripEnd.isNull()) {
+        // Vehicle stopped
+        m_potentialTripEnd = point.timestamp;
+        m_potentialEndCharge = point.batteryCharge;
+    } else if (m_potentialTripEnd.secsTo(point.timestamp) >= Hysteresis::endSeconds(m_config)) {
+        // Stopped for long enough - trip ended!
+        endTrip(m_potentialTripEnd, m_potentialEndCharge, TripEvent::Ended);
+    }
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+void BasicTripDetector<Motion, Hysteresis, Timeout>::processPoints(const QList<VehicleDataPoint>& points)
+{
+    if (points.isEmpty()) return;
+
+    PointColumns batch = { points, {}, {}, {} };
+    batch.msecs.reserve(points.size());
+    batch.speeds.reserve(points.size());
+    batch.charges.reserve(points.size());
+    for (const VehicleDataPoint& point : points) {
+        batch.msecs.append(point.timestamp.toMSecsSinceEpoch());
+        batch.speeds.append(point.speed);
+        batch.charges.append(point.batteryCharge);
+    }
+
+    // Trips cannot span a timeout gap, so the timeline falls apart into chunks
+    // that only depend on each other through the trip numbering
+    QList<qsizetype> chunkStarts;
+    chunkStarts.append(0);
+    if (Timeout::endsAtGaps) {
+        for (qsizetype i = 1; i < points.size(); ++i) {
+            if (batch.msecs[i] - batch.msecs[i - 1] >= qint64(m_config.timeoutSeconds) * 1000) {
+                chunkStarts.append(i);
+            }
+        }
+    }
+    chunkStarts.append(points.size());
+
+    // Filter ahead of detection in stream order, restarting after every gap
+    if (m_speedFilter.isEnabled()) {
+        for (qsizetype chunk = 0; chunk + 1 < chunkStarts.size(); ++chunk) {
+            const qsizetype begin = chunkStarts[chunk];
+            const bool afterGap = chunk > 0 || (Timeout::endsAtGaps && !m_lastPoint.timestamp.isNull()
+                                                && isTimeoutGap(m_lastPoint.timestamp, points[begin].timestamp));
+            if (afterGap) {
+                m_speedFilter.reset();
+            }
+            m_speedFilter.filter(batch.speeds.data() + begin, chunkStarts[chunk + 1] - begin);
+        }
+    }
+
+    // Group whole chunks into tasks of similar size for the thread pool
+    const qsizetype taskPoints = qMax(qsizetype(PARALLEL_MIN_TASK_POINTS),
+                                      points.size() / (4 * qMax(1, QThreadPool::globalInstance()->maxThreadCount())));
+    QList<ChunkRange> tasks;
+    ChunkRange task = { 0, 0 };
+    for (qsizetype chunk = 0; chunk + 1 < chunkStarts.size(); ++chunk) {
+        task.lastChunk = chunk + 1;
+        if (chunkStarts[task.lastChunk] - chunkStarts[task.firstChunk] >= taskPoints) {
+            tasks.append(task);
+            task = { task.lastChunk, task.lastChunk };
+        }
+    }
+    if (task.lastChunk > task.firstChunk) {
+        tasks.append(task);
+    }
+
+    if (tasks.size() == 1) {
+        processChunks(batch, chunkStarts, tasks.first());
+        return;
+    }
+
+    // Every task but the first starts after a gap, i.e. from a clean state, and
+    // runs on its own detector; the first continues this detector's state here
+    const TripDetectorConfig config = m_config;
+    QFuture<BasicTripDetector> results = QtConcurrent::mapped(tasks.cbegin() + 1, tasks.cend(),
+        [&batch, &chunkStarts, config](const ChunkRange& range) {
+            BasicTripDetector detector(config);
+            detector.m_recordSessionRuns = true;
+            detector.processChunks(batch, chunkStarts, range);
+            return detector;
+        });
+    processChunks(batch, chunkStarts, tasks.first());
+
+    const QList<BasicTripDetector> later = results.results();
+    for (const BasicTripDetector& detector : later) {
+        append(detector);
+        replaySessionRuns(batch, detector.m_sessionRuns);
+    }
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+void BasicTripDetector<Motion, Hysteresis, Timeout>::processChunks(const PointColumns& batch,
+                                                                   const QList<qsizetype>& chunkStarts,
+                                                                   const ChunkRange& range)
+{
+    const QList<VehicleDataPoint>& points = batch.points;
+    for (qsizetype chunk = range.firstChunk; chunk < range.lastChunk; ++chunk) {
+        const qsizetype begin = chunkStarts[chunk];
+        const qsizetype end = chunkStarts[chunk + 1];
+
+        if (Timeout::endsAtGaps && !m_lastPoint.timestamp.isNull()
+            && isTimeoutGap(m_lastPoint.timestamp, points[begin].timestamp)) {
+            handleTimeoutGap();
+        }
+
+        // Split the speed column into moving/stopped runs, then apply the start and
+        // end rules, and the session machines, once per run instead of once per point
+        const QList<MotionSegment> segments = MotionSegmentation::segment(
+            batch.speeds.constData() + begin, end - begin, m_enterAbove, m_stayAbove, m_moving);
+        for (const MotionSegment& segment : segments) {
+            const qsizetype first = begin + segment.begin;
+            if (segment.moving) {
+                feedSessions(batch, { SessionRun::Moving, first, 0 });
+                processMovingSegment(batch, first, begin + segment.end);
+            } else {
+                feedSessions(batch, { SessionRun::Stopped, first, segment.end - segment.begin });
+                processStoppedSegment(batch, first, begin + segment.end);
+            }
+        }
+        m_lastPoint = points[end - 1];
+        m_lastPoint.speed = batch.speeds[end - 1];
+    }
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+void BasicTripDetector<Motion, Hysteresis, Timeout>::processMovingSegment(const PointColumns& batch,
+                                                                          qsizetype begin, qsizetype end)
+{
+    const QList<VehicleDataPoint>& points = batch.points;
+    qsizetype next = begin;
+
+    if (!m_inTrip) {
+        if (m_potentialTripStart.isNull()) {
+            m_potentialTripStart = points[begin].timestamp;
+            m_potentialStartCharge = points[begin].batteryCharge;
+            m_pendingStats = TripStatsAccumulator();
+            qDebug() << "Potential trip start detected at:" << m_potentialTripStart.toString();
+            next = begin + 1;
+        }
+
+        const qsizetype confirm = firstPointAfter(batch, next, end, m_potentialTripStart,
+                                                  Hysteresis::startSeconds(m_config));
+        if (confirm == end) {
+            addToStats(m_pendingStats, batch, begin, end);
+            m_lastMovementTime = points[end - 1].timestamp;
+            return;
+        }
+
+        // Moving for long enough - trip confirmed! The confirming point itself
+        // is not part of the trip, like in processPoint()
+        addToStats(m_pendingStats, batch, begin, confirm + 1);
+        startTrip();
+        next = confirm + 1;
+    }
+
+    appendToTrip(batch, next, end);
+    m_lastMovementTime = points[end - 1].timestamp;
+    m_potentialTripEnd = QDateTime();
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+void BasicTripDetector<Motion, Hysteresis, Timeout>::processStoppedSegment(const PointColumns& batch,
+                                                                           qsizetype begin, qsizetype end)
+{
+    const QList<VehicleDataPoint>& points = batch.points;
+    if (!m_inTrip) {
+        m_potentialTripStart = QDateTime();
+        return;
+    }
+
+    qsizetype next = begin;
+    if (m_potentialTripEnd.isNull()) {
+        m_potentialTripEnd = points[begin].timestamp;
+        m_potentialEndCharge = points[begin].batteryCharge;
+        next = begin + 1;
+    }
+
+    const qsizetype confirm = firstPointAfter(batch, next, end, m_potentialTripEnd,
+                                              Hysteresis::endSeconds(m_config));
+    if (confirm == end) {
+        appendToTrip(batch, begin, end);
+        return;
+    }
+
+    // The point that confirms the stop is still recorded in the trip
+    appendToTrip(batch, begin, confirm + 1);
+    endTrip(m_potentialTripEnd, m_potentialEndCharge, TripEvent::Ended);
+
+    // The rest of the run is stopped outside a trip, leaving no start candidate
+    m_potentialTripStart = QDateTime();
+}
+
+template <typename Motion, typename Hysteresis, typename Timeout>
+qsizetype BasicTripDetector<Motion, Hysteresis, Timeout>::firstPointAfter(const PointColumns& batch,
+                                                                          qsizetype begin, qsizetype end,
+                                                                          const QDateTime& since, int seconds) const
+{
+    // Timestamps are ascending, so the first point far enough from 'since' can be
+    // bisected; whole elapsed seconds like QDateTime::secsTo()
+    const qint64 sinceMsecs = since.toMSecsSinceEpoch();
+    auto it = std::partition_point(batch.msecs.cbegin() + begin, batch.msecs.cbegin() + end,
+                                   [sinceMsecs, seconds](qint64 msecs) {
+                                       return (msecs - sinceMsecs) / 1000 < seconds;
+                                   });
+    return it - batch.msecs.cbegin();
+}
+
+// The configurations TripDetector::create() can choose from
+template class BasicTripDetector<SpeedAboveThreshold, FixedHysteresis<60, 60>, GapTimeout>;
+template class BasicTripDetector<SpeedAboveThreshold, FixedHysteresis<60, 60>, SilenceTimeout>;
+template class BasicTripDetector<SpeedAboveThreshold, ConfiguredHysteresis, GapTimeout>;
+template class BasicTripDetector<SpeedAboveThreshold, ConfiguredHysteresis, SilenceTimeout>;
+template class BasicTripDetector<SpeedWithDeadband, FixedHysteresis<60, 60>, GapTimeout>;
+template class BasicTripDetector<SpeedWithDeadband, FixedHysteresis<60, 60>, SilenceTimeout>;
+template class BasicTripDetector<SpeedWithDeadband, ConfiguredHysteresis, GapTimeout>;
+template class BasicTripDetector<SpeedWithDeadband, ConfiguredHysteresis, SilenceTimeout>;
+
+// Pick the instantiation for the config; the stock durations get the variant
+// where they are compile-time constants
+template <typename Motion, typename Timeout>
+static std::unique_ptr<TripDetector> createWithHysteresis(const TripDetectorConfig& config)
+{
+    if (config.startSeconds == 60 && config.endSeconds == 60) {
+        return std::make_unique<BasicTripDetector<Motion, FixedHysteresis<60, 60>, Timeout>>(config);
+    }
+    return std::make_unique<BasicTripDetector<Motion, ConfiguredHysteresis, Timeout>>(config);
+}
+
+template <typename Motion>
+static std::unique_ptr<TripDetector> createWithMotion(const TripDetectorConfig& config)
+{
+    if (config.timeoutAtGaps) {
+        return createWithHysteresis<Motion, GapTimeout>(config);
+    }
+    return createWithHysteresis<Motion, SilenceTimeout>(config);
+}
+
+std::unique_ptr<TripDetector> TripDetector::create(const TripDetectorConfig& config)
+{
+    if (config.speedDeadband > 0.0) {
+        return createWithMotion<SpeedWithDeadband>(config);
+    }
+    return createWithMotion<SpeedAboveThreshold>(config);
+}
@@ -0,0 +1,248 @@
+#ifndef TRIPDETECTOR_H
+#define TRIPDETECTOR_H
+
+#include <QDateTime>
+#include <QList>
+#include <memory>
+
+#include "tripdata.h"
+#include "sessiondetector.h"
+#include "speedfilter.h"
+
+// Something the detector decided while consuming data. The owner turns these
+// into signals and database writes once the current batch has been processed.
+struct TripEvent {
+    enum Type {
+        Started,   // start confirmed after startSeconds of movement
+        Ended,     // vehicle stopped for endSeconds
+        TimedOut   // no data for timeoutSeconds while a trip was open
+    };
+
+    Type type;
+    int tripIndex; // index into TripDetector::trips()
+
+    TripEvent(Type t, int index) : type(t), tripIndex(index) {}
+};
+
+// Tunable trip rules. TripDetector::create() picks the detector instantiation
+// that matches them, so changing them needs no rebuild.
+struct TripDetectorConfig {
+    int startSeconds = 60;         // 1 minute of movement to start trip
+    int endSeconds = 60;           // 1 minute of no movement to end trip
+    int timeoutSeconds = 300;      // 5 minutes without data to force trip end
+    double speedThreshold = 0.0;   // m/s, moving when above
+    double speedDeadband = 0.0;    // m/s, start above threshold + deadband, stop at threshold - deadband
+    bool timeoutAtGaps = true;     // a gap of timeoutSeconds in the data ends a trip, not only checkTimeout()
+    int speedFilterWindow = 0;     // samples in the median/Hampel window applied before detection, 0 = off
+    double speedFilterSigmas = 3.0; // Hampel threshold in robust standard deviations, 0 = plain median
+    bool keepTripPoints = false;   // store every point in TripInfo::dataPoints, statistics do not need them
+    SessionDetectorConfig sessions; // charging and parking, detected in the same pass
+
+    // TRIP_START_SECONDS, TRIP_END_SECONDS, TRIP_TIMEOUT_SECONDS, TRIP_SPEED_THRESHOLD,
+    // TRIP_SPEED_DEADBAND, TRIP_TIMEOUT_AT_GAPS, TRIP_KEEP_POINTS, TRIP_SPEED_FILTER_WINDOW
+    // and TRIP_SPEED_FILTER_SIGMAS override the defaults,
+    // the session settings come from SessionDetectorConfig::fromEnvironment()
+    static TripDetectorConfig fromEnvironment();
+};
+
+// Streaming trip state machine. Points are fed in chronological order, either
+// as a whole re-analysed window (polling) or one at a time (push ingest); the
+// state carries over between calls so both modes share the same rules.
+//
+// The rules themselves live in BasicTripDetector, specialized at compile time
+// by policy types; this base holds the state and the results, and is what the
+// owner talks to. The virtual calls are per point only in push ingest.
+class TripDetector
+{
+public:
+    virtual ~TripDetector() = default;
+
+    static std::unique_ptr<TripDetector> create(const TripDetectorConfig& config = TripDetectorConfig());
+
+    void reset(int firstTripId = 1);
+    virtual void processPoint(const VehicleDataPoint& point) = 0;
+    // Same rules as processPoint() for a chronological batch. With timeoutAtGaps
+    // the batch is cut at timeout gaps, the pieces are detected in parallel and
+    // stitched back in order; within a piece the rules are applied per motion segment.
+    virtual void processPoints(const QList<VehicleDataPoint>& points) = 0;
+
+    // Force-end an open trip when the newest data is older than the timeout
+    bool checkTimeout(const QDateTime& currentTime);
+
+    QList<TripEvent> takeEvents();
+
+    // Compact snapshot for resuming after a restart: the pending start or end,
+    // the open trip and sessions, the speed filter and the next ids; finished
+    // trips are not part of it. restoreState() refuses a snapshot taken with a
+    // different config, the caller resets the detector then.
+    void saveState(QDataStream& out) const;
+    bool restoreState(QDataStream& in);
+
+    // Charging and parking sessions found while detecting trips, with their own
+    // events; charging ends at timeout gaps like trips, parking carries across them
+    SessionDetector& sessions() { return m_sessions; }
+    const SessionDetector& sessions() const { return m_sessions; }
+
+    QList<TripInfo>& trips() { return m_trips; }
+    const QList<TripInfo>& trips() const { return m_trips; }
+
+    const TripDetectorConfig& config() const { return m_config; }
+    // Policies of this instantiation, for logging
+    virtual QString description() const = 0;
+
+    bool inTrip() const { return m_inTrip; }
+    bool hasOngoingTrip() const;
+    int nextTripId() const { return m_nextTripId; }
+    QDateTime potentialTripStart() const { return m_potentialTripStart; }
+    QDateTime potentialTripEnd() const { return m_potentialTripEnd; }
+    QDateTime lastMovementTime() const { return m_lastMovementTime; }
+    QDateTime lastDataTime() const { return m_lastPoint.timestamp; }
+
+    // Smallest batch share worth handing to another thread
+    static const int PARALLEL_MIN_TASK_POINTS = 50000;
+
+protected:
+    explicit TripDetector(const TripDetectorConfig& config);
+
+    bool isTimeoutGap(const QDateTime& from, const QDateTime& to) const;
+    // Data resumed after a timeout gap: the open trip ends, motion starts over
+    void handleTimeoutGap();
+    void expireOpenTrip();
+    // Continue with the trips of a detector that ran on data after a timeout gap
+    void append(const TripDetector& later);
+
+    // A batch with its timestamp, speed and charge columns extracted once, for the kernels
+    struct PointColumns {
+        const QList<VehicleDataPoint>& points;
+        QList<qint64> msecs;
+        QList<double> speeds;
+        QList<double> charges;
+    };
+
+    // A call into the session machines. Parking carries across timeout gaps, so
+    // the detectors of later parallel pieces only record their calls and the
+    // owner replays them in order after appending the piece.
+    struct SessionRun {
+        enum Kind {
+            Stopped,
+            Moving,
+            Gap
+        };
+        Kind kind;
+        qsizetype first; // batch index, Stopped and Moving
+        qsizetype count; // Stopped only
+    };
+    void feedSessions(const PointColumns& batch, const SessionRun& run);
+    void replaySessionRuns(const PointColumns& batch, const QList<SessionRun>& runs);
+
+    static void addToStats(TripStatsAccumulator& stats, const PointColumns& batch, qsizetype begin, qsizetype end);
+    void addToTrip(const VehicleDataPoint& point) { m_trips.last().addDataPoint(point, m_config.keepTripPoints); }
+    void appendToTrip(const PointColumns& batch, qsizetype begin, qsizetype end);
+    void startTrip();
+    void endTrip(const QDateTime& endTime, double endCharge, TripEvent::Type reason);
+
+    TripDetectorConfig m_config;
+
+    QList<TripInfo> m_trips;
+    QList<TripEvent> m_events;
+    SessionDetector m_sessions;
+    bool m_recordSessionRuns;
+    QList<SessionRun> m_sessionRuns;
+    // Runs ahead of detection; restarted at timeout gaps so chunks stay independent
+    SpeedFilter m_speedFilter;
+
+    // Trip detection state
+    bool m_inTrip;
+    bool m_moving; // motion state, matters with a speed deadband
+    int m_nextTripId;
+    QDateTime m_potentialTripStart;
+    QDateTime m_lastMovementTime;
+    QDateTime m_potentialTripEnd;
+    double m_potentialStartCharge;
+    double m_potentialEndCharge;
+    // Moving points before the start is confirmed; they become the first of the trip's statistics
+    TripStatsAccumulator m_pendingStats;
+    VehicleDataPoint m_lastPoint;
+};
+
+// Motion policies: which points count as moving
+
+// Moving while speed > speedThreshold (speed > 0 by default)
+struct SpeedAboveThreshold {
+    static const char *name() { return "threshold"; }
+    static double enterAbove(const TripDetectorConfig& config) { return config.speedThreshold; }
+    static double stayAbove(const TripDetectorConfig& config) { return config.speedThreshold; }
+    static bool isMoving(double speed, bool, double enter, double) { return speed > enter; }
+};
+
+// Starts moving above threshold + deadband, stops at threshold - deadband, so
+// sensor noise around the threshold does not toggle the state
+struct SpeedWithDeadband {
+    static const char *name() { return "deadband"; }
+    static double enterAbove(const TripDetectorConfig& config) { return config.speedThreshold + config.speedDeadband; }
+    static double stayAbove(const TripDetectorConfig& config) { return config.speedThreshold - config.speedDeadband; }
+    static bool isMoving(double speed, bool wasMoving, double enter, double stay) { return speed > (wasMoving ? stay : enter); }
+};
+
+// Start/end hysteresis policies: how long movement or standstill must last
+
+// Durations fixed at compile time, the stock 60 s / 60 s rules
+template <int StartSeconds, int EndSeconds>
+struct FixedHysteresis {
+    static const char *name() { return "fixed"; }
+    static int startSeconds(const TripDetectorConfig&) { return StartSeconds; }
+    static int endSeconds(const TripDetectorConfig&) { return EndSeconds; }
+};
+
+struct ConfiguredHysteresis {
+    static const char *name() { return "configured"; }
+    static int startSeconds(const TripDetectorConfig& config) { return config.startSeconds; }
+    static int endSeconds(const TripDetectorConfig& config) { return config.endSeconds; }
+};
+
+// Timeout policies: what ends a trip when data stops
+
+// A gap in the data ends the trip, which also lets batches be split and detected in parallel
+struct GapTimeout {
+    static const char *name() { return "gap"; }
+    static const bool endsAtGaps = true;
+};
+
+// Only checkTimeout() against the wall clock ends a trip, gaps inside a batch are bridged
+struct SilenceTimeout {
+    static const char *name() { return "silence"; }
+    static const bool endsAtGaps = false;
+};
+
+// The trip rules for one combination of policies. Instantiated for the common
+// combinations in tripdetector.cpp, which is where TripDetector::create() chooses.
+template <typename Motion, typename Hysteresis, typename Timeout>
+class BasicTripDetector : public TripDetector
+{
+public:
+    explicit BasicTripDetector(const TripDetectorConfig& config = TripDetectorConfig());
+
+    void processPoint(const VehicleDataPoint& point) override;
+    void processPoints(const QList<VehicleDataPoint>& points) override;
+    QString description() const override;
+
+private:
+    // Consecutive chunks [firstChunk, lastChunk) of a batch cut at timeout gaps
+    struct ChunkRange {
+        qsizetype firstChunk;
+        qsizetype lastChunk;
+    };
+
+    void processChunks(const PointColumns& batch, const QList<qsizetype>& chunkStarts, const ChunkRange& range);
+    void processMovingSegment(const PointColumns& batch, qsizetype begin, qsizetype end);
+    void processStoppedSegment(const PointColumns& batch, qsizetype begin, qsizetype end);
+    qsizetype firstPointAfter(const PointColumns& batch, qsizetype begin, qsizetype end,
+                              const QDateTime& since, int seconds) const;
+
+    // Motion thresholds resolved once from the config; the durations are asked
+    // from Hysteresis at each use so fixed ones stay compile-time constants
+    double m_enterAbove;
+    double m_stayAbove;
+};
+
+#endif // TRIPDETECTOR_H
@@ -0,0 +1,190 @@
+#include "triplistmodel.h"
+#include "influxdbclient.h"
+#include <algorithm>
+
+TripListModel::TripListModel(InfluxDBClient *client, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_client(client)
+    , m_hasMore(true)
+{
+    m_nextQuery = m_query;
+    connect(m_client, &InfluxDBClient::tripChanged, this, &TripListModel::onTripChanged);
+    connect(m_client, &InfluxDBClient::tripRemoved, this, &TripListModel::onTripRemoved);
+}
+
+int TripListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(m_trips.size());
+}
+
+QVariant TripListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_trips.size()) return QVariant();
+
+    const TripInfo& trip = m_trips.at(index.row());
+    switch (role) {
+    case TripIdRole: return trip.tripId;
+    case StartTimeRole: return trip.startTime;
+    case EndTimeRole: return trip.endTime;
+    case Qt::DisplayRole:
+    case TripNameRole: return trip.getFormattedTripName();
+    case DriverNameRole: return trip.driverName;
+    case FormattedStartTimeRole: return trip.getFormattedStartTime();
+    case FormattedEndTimeRole: return trip.endTime.isNull() ? QString("Ongoing") : trip.getFormattedEndTime();
+    case FormattedDurationRole: return trip.getFormattedDuration();
+    case FormattedDistanceRole: return trip.getFormattedDistance();
+    case MaxSpeedRole: return trip.maxSpeed;
+    case AverageSpeedRole: return trip.averageSpeed;
+    case DistanceTraveledRole: return trip.distanceTraveled;
+    case DurationSecondsRole: return trip.durationSeconds;
+    case StartBatteryChargeRole: return trip.startBatteryCharge;
+    case EndBatteryChargeRole: return trip.endBatteryCharge;
+    case BatteryUsedPercentRole: return trip.batteryUsedPercent;
+    case EnergyConsumedWhRole: return trip.energyConsumedWh;
+    case EnergyEfficiencyWhKmRole: return trip.energyEfficiencyWhKm;
+    case EnergyConfidenceWhRole: return trip.energyConfidenceWh;
+    case NotesRole: return trip.notes;
+    case ImagePathsRole: return trip.imagePaths;
+    case FormattedBatteryUsageRole: return trip.getFormattedBatteryUsage();
+    case FormattedEnergyConsumptionRole: return trip.getFormattedEnergyConsumption();
+    case FormattedEnergyEfficiencyRole: return trip.getFormattedEnergyEfficiency();
+    }
+    return QVariant();
+}
+
+// Same names as the keys of InfluxDBClient::getTripDetails()
+QHash<int, QByteArray> TripListModel::roleNames() const
+{
+    static const QHash<int, QByteArray> roles = {
+        { TripIdRole, "tripId" },
+        { StartTimeRole, "startTime" },
+        { EndTimeRole, "endTime" },
+        { TripNameRole, "tripName" },
+        { DriverNameRole, "driverName" },
+        { FormattedStartTimeRole, "formattedStartTime" },
+        { FormattedEndTimeRole, "formattedEndTime" },
+        { FormattedDurationRole, "formattedDuration" },
+        { FormattedDistanceRole, "formattedDistance" },
+        { MaxSpeedRole, "maxSpeed" },
+        { AverageSpeedRole, "averageSpeed" },
+        { DistanceTraveledRole, "distanceTraveled" },
+        { DurationSecondsRole, "durationSeconds" },
+        { StartBatteryChargeRole, "startBatteryCharge" },
+        { EndBatteryChargeRole, "endBatteryCharge" },
+        { BatteryUsedPercentRole, "batteryUsedPercent" },
+        { EnergyConsumedWhRole, "energyConsumedWh" },
+        { EnergyEfficiencyWhKmRole, "energyEfficiencyWhKm" },
+        { EnergyConfidenceWhRole, "energyConfidenceWh" },
+        { NotesRole, "notes" },
+        { ImagePathsRole, "imagePaths" },
+        { FormattedBatteryUsageRole, "formattedBatteryUsage" },
+        { FormattedEnergyConsumptionRole, "formattedEnergyConsumption" },
+        { FormattedEnergyEfficiencyRole, "formattedEnergyEfficiency" }
+    };
+    return roles;
+}
+
+bool TripListModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && m_hasMore;
+}
+
+void TripListModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid() || !m_hasMore) return;
+
+    TripPage page;
+    if (!m_client->queryTripsFromDatabase(m_nextQuery, page)) {
+        m_hasMore = false;
+        return;
+    }
+
+    m_hasMore = page.hasMore;
+    m_nextQuery = page.nextQuery(m_nextQuery);
+    if (page.trips.isEmpty()) return;
+
+    const int first = int(m_trips.size());
+    beginInsertRows(QModelIndex(), first, first + int(page.trips.size()) - 1);
+    m_trips.append(page.trips);
+    endInsertRows();
+}
+
+void TripListModel::setFilter(const QVariantMap& options)
+{
+    m_query = TripQuery::fromVariantMap(options);
+    reload();
+}
+
+void TripListModel::reload()
+{
+    beginResetModel();
+    m_trips.clear();
+    m_nextQuery = m_query;
+    m_hasMore = true;
+    endResetModel();
+}
+
+// Views keep at most a few thousand rows loaded, a scan is fine for the
+// occasional committed write
+int TripListModel::rowOf(int tripId) const
+{
+    for (int row = 0; row < m_trips.size(); ++row) {
+        if (m_trips.at(row).tripId == tripId) return row;
+    }
+    return -1;
+}
+
+int TripListModel::insertPosition(const TripInfo& trip) const
+{
+    const auto position = std::lower_bound(m_trips.cbegin(), m_trips.cend(), trip,
+        [this](const TripInfo& a, const TripInfo& b) { return m_query.sortsBefore(a, b); });
+    return int(position - m_trips.cbegin());
+}
+
+void TripListModel::insertTrip(const TripInfo& trip)
+{
+    const int position = insertPosition(trip);
+    // Past the loaded rows it comes with a later page
+    if (position == m_trips.size() && m_hasMore) return;
+
+    beginInsertRows(QModelIndex(), position, position);
+    m_trips.insert(position, trip);
+    endInsertRows();
+}
+
+void TripListModel::onTripChanged(int tripId)
+{
+    TripInfo trip;
+    const bool listed = m_client->loadTripFromDatabase(tripId, trip) && m_query.matches(trip);
+    const int row = rowOf(tripId);
+
+    if (row >= 0) {
+        // Edits such as a rename keep the row where it is
+        const bool inPlace = listed
+            && (row == 0 || m_query.sortsBefore(m_trips.at(row - 1), trip))
+            && (row == m_trips.size() - 1 || m_query.sortsBefore(trip, m_trips.at(row + 1)));
+        if (inPlace) {
+            m_trips[row] = trip;
+            emit dataChanged(index(row), index(row));
+            return;
+        }
+
+        beginRemoveRows(QModelIndex(), row, row);
+        m_trips.removeAt(row);
+        endRemoveRows();
+    }
+
+    if (listed) {
+        insertTrip(trip);
+    }
+}
+
+void TripListModel::onTripRemoved(int tripId)
+{
+    const int row = rowOf(tripId);
+    if (row < 0) return;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_trips.removeAt(row);
+    endRemoveRows();
+}
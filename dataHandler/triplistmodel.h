@@ -0,0 +1,79 @@
+#ifndef TRIPLISTMODEL_H
+#define TRIPLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QByteArray>
+
+#include "tripquery.h"
+
+class InfluxDBClient;
+
+// Trips from the database for QML list views, one row per trip.
+//
+// Rows are read a page at a time as the view scrolls (canFetchMore/fetchMore)
+// and the formatted strings are only built in data() for rows that are shown.
+// Committed writes update single rows: a saved or edited trip is updated in
+// place or inserted where it sorts, a deleted one removed, so views keep their
+// delegates and scroll position.
+class TripListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        TripIdRole = Qt::UserRole + 1,
+        StartTimeRole,
+        EndTimeRole,
+        TripNameRole,
+        DriverNameRole,
+        FormattedStartTimeRole,
+        FormattedEndTimeRole,
+        FormattedDurationRole,
+        FormattedDistanceRole,
+        MaxSpeedRole,
+        AverageSpeedRole,
+        DistanceTraveledRole,
+        DurationSecondsRole,
+        StartBatteryChargeRole,
+        EndBatteryChargeRole,
+        BatteryUsedPercentRole,
+        EnergyConsumedWhRole,
+        EnergyEfficiencyWhKmRole,
+        EnergyConfidenceWhRole,
+        NotesRole,
+        ImagePathsRole,
+        FormattedBatteryUsageRole,
+        FormattedEnergyConsumptionRole,
+        FormattedEnergyEfficiencyRole
+    };
+
+    explicit TripListModel(InfluxDBClient *client, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    // Filters and sort order as for InfluxDBClient::queryTrips(), then reload
+    Q_INVOKABLE void setFilter(const QVariantMap& options);
+    Q_INVOKABLE void reload();
+
+private slots:
+    void onTripChanged(int tripId);
+    void onTripRemoved(int tripId);
+
+private:
+    int rowOf(int tripId) const;
+    int insertPosition(const TripInfo& trip) const;
+    void insertTrip(const TripInfo& trip);
+
+    InfluxDBClient *m_client;
+    TripQuery m_query;      // first page
+    TripQuery m_nextQuery;  // continues after the last loaded row
+    bool m_hasMore;
+    QList<TripInfo> m_trips;
+};
+
+#endif // TRIPLISTMODEL_H
@@ -0,0 +1,209 @@
+#include "tripquery.h"
+#include <QSqlError>
+#include <QStringList>
+#include <QDebug>
+
+// Sort column and direction; trip_id breaks ties in the same direction
+static const char *sortColumn(TripQuery::Sort sort)
+{
+    switch (sort) {
+    case TripQuery::OldestFirst:
+    case TripQuery::NewestFirst:
+        return "start_time";
+    case TripQuery::LongestFirst:
+        return "distance_traveled";
+    case TripQuery::MostEfficientFirst:
+        return "energy_efficiency_whkm";
+    }
+    return "start_time";
+}
+
+static bool isDescending(TripQuery::Sort sort)
+{
+    return sort == TripQuery::NewestFirst || sort == TripQuery::LongestFirst;
+}
+
+// start_time is stored as UTC ISO text, which sorts like the time itself
+static QString timeKey(const QDateTime& time)
+{
+    return time.toUTC().toString(Qt::ISODate);
+}
+
+TripQuery TripQuery::fromVariantMap(const QVariantMap& options)
+{
+    TripQuery query;
+    query.startedAfter = options.value("startedAfter").toDateTime();
+    query.startedBefore = options.value("startedBefore").toDateTime();
+    query.driverName = options.value("driverName").toString();
+    query.minDistanceKm = options.value("minDistanceKm").toDouble();
+    query.minEfficiencyWhKm = options.value("minEfficiencyWhKm").toDouble();
+    query.maxEfficiencyWhKm = options.value("maxEfficiencyWhKm").toDouble();
+
+    const QString sort = options.value("sort").toString();
+    if (sort == "oldest") query.sort = OldestFirst;
+    else if (sort == "longest") query.sort = LongestFirst;
+    else if (sort == "efficient") query.sort = MostEfficientFirst;
+
+    if (options.contains("limit")) {
+        query.limit = options.value("limit").toInt();
+    }
+    if (options.contains("afterTripId")) {
+        query.afterKey = options.value("afterKey");
+        query.afterTripId = options.value("afterTripId").toInt();
+    }
+    return query;
+}
+
+bool TripQuery::matches(const TripInfo& trip) const
+{
+    if (startedAfter.isValid() && trip.startTime < startedAfter) return false;
+    if (startedBefore.isValid() && trip.startTime >= startedBefore) return false;
+    if (!driverName.isEmpty() && trip.driverName != driverName) return false;
+    if (minDistanceKm > 0.0 && trip.distanceTraveled < minDistanceKm) return false;
+    if (minEfficiencyWhKm > 0.0 && trip.energyEfficiencyWhKm < minEfficiencyWhKm) return false;
+    if (maxEfficiencyWhKm > 0.0 && trip.energyEfficiencyWhKm > maxEfficiencyWhKm) return false;
+    return true;
+}
+
+bool TripQuery::sortsBefore(const TripInfo& a, const TripInfo& b) const
+{
+    // Same keys as the ORDER BY in queryTrips()
+    int order = 0;
+    switch (sort) {
+    case NewestFirst:
+    case OldestFirst:
+        order = a.startTime < b.startTime ? -1 : (b.startTime < a.startTime ? 1 : 0);
+        break;
+    case LongestFirst:
+        order = a.distanceTraveled < b.distanceTraveled ? -1 : (b.distanceTraveled < a.distanceTraveled ? 1 : 0);
+        break;
+    case MostEfficientFirst:
+        order = a.energyEfficiencyWhKm < b.energyEfficiencyWhKm ? -1 : (b.energyEfficiencyWhKm < a.energyEfficiencyWhKm ? 1 : 0);
+        break;
+    }
+    if (order == 0) {
+        order = a.tripId < b.tripId ? -1 : (a.tripId > b.tripId ? 1 : 0);
+    }
+    return isDescending(sort) ? order > 0 : order < 0;
+}
+
+TripQuery TripPage::nextQuery(const TripQuery& query) const
+{
+    TripQuery next = query;
+    next.afterKey = nextKey;
+    next.afterTripId = nextTripId;
+    return next;
+}
+
+TripInfo tripFromQuery(const QSqlQuery& query)
+{
+    TripInfo trip;
+    trip.tripId = query.value("trip_id").toInt();
+    trip.startTime = QDateTime::fromString(query.value("start_time").toString(), Qt::ISODate);
+
+    QString endTimeStr = query.value("end_time").toString();
+    if (!endTimeStr.isEmpty()) {
+        trip.endTime = QDateTime::fromString(endTimeStr, Qt::ISODate);
+    }
+
+    trip.maxSpeed = query.value("max_speed").toDouble();
+    trip.averageSpeed = query.value("average_speed").toDouble();
+    trip.distanceTraveled = query.value("distance_traveled").toDouble();
+    trip.durationSeconds = query.value("duration_seconds").toLongLong();
+    trip.startBatteryCharge = query.value("start_battery_charge").toDouble();
+    trip.endBatteryCharge = query.value("end_battery_charge").toDouble();
+    trip.batteryUsedPercent = query.value("battery_used_percent").toDouble();
+    trip.energyConsumedWh = query.value("energy_consumed_wh").toDouble();
+    trip.energyEfficiencyWhKm = query.value("energy_efficiency_whkm").toDouble();
+    trip.energyConfidenceWh = query.value("energy_confidence_wh").toDouble();
+    trip.tripName = query.value("trip_name").toString();
+    trip.driverName = query.value("driver_name").toString();
+    trip.notes = query.value("notes").toString();
+    trip.imagePaths = query.value("image_paths").toString();
+    return trip;
+}
+
+bool queryTrips(const QSqlDatabase& database, const TripQuery& tripQuery, TripPage& page)
+{
+    page = TripPage();
+
+    if (!database.isOpen()) {
+        qDebug() << "Database not open - cannot query trips";
+        return false;
+    }
+
+    const QString column = QLatin1String(sortColumn(tripQuery.sort));
+    const bool descending = isDescending(tripQuery.sort);
+    const int limit = qBound(1, tripQuery.limit, int(TripQuery::MAX_PAGE_SIZE));
+
+    QStringList where;
+    if (tripQuery.startedAfter.isValid()) where << "start_time >= :started_after";
+    if (tripQuery.startedBefore.isValid()) where << "start_time < :started_before";
+    if (!tripQuery.driverName.isEmpty()) where << "driver_name = :driver_name";
+    if (tripQuery.minDistanceKm > 0.0) where << "distance_traveled >= :min_distance";
+    if (tripQuery.minEfficiencyWhKm > 0.0) where << "energy_efficiency_whkm >= :min_efficiency";
+    if (tripQuery.maxEfficiencyWhKm > 0.0) where << "energy_efficiency_whkm <= :max_efficiency";
+    if (tripQuery.hasCursor()) {
+        // Row value comparison, SQLite turns it into a range on the sort index
+        where << QString("(%1, trip_id) %2 (:after_key, :after_id)").arg(column, QLatin1String(descending ? "<" : ">"));
+    }
+
+    QString sql = "SELECT * FROM trips";
+    if (!where.isEmpty()) {
+        sql += " WHERE " + where.join(" AND ");
+    }
+    sql += QString(" ORDER BY %1 %2, trip_id %2 LIMIT :limit").arg(column, QLatin1String(descending ? "DESC" : "ASC"));
+
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql)) {
+        qDebug() << "Failed to prepare trip query:" << query.lastError().text();
+        return false;
+    }
+    if (tripQuery.startedAfter.isValid()) query.bindValue(":started_after", timeKey(tripQuery.startedAfter));
+    if (tripQuery.startedBefore.isValid()) query.bindValue(":started_before", timeKey(tripQuery.startedBefore));
+    if (!tripQuery.driverName.isEmpty()) query.bindValue(":driver_name", tripQuery.driverName);
+    if (tripQuery.minDistanceKm > 0.0) query.bindValue(":min_distance", tripQuery.minDistanceKm);
+    if (tripQuery.minEfficiencyWhKm > 0.0) query.bindValue(":min_efficiency", tripQuery.minEfficiencyWhKm);
+    if (tripQuery.maxEfficiencyWhKm > 0.0) query.bindValue(":max_efficiency", tripQuery.maxEfficiencyWhKm);
+    if (tripQuery.hasCursor()) {
+        query.bindValue(":after_key", tripQuery.afterKey);
+        query.bindValue(":after_id", tripQuery.afterTripId);
+    }
+    // One row more than asked tells whether another page follows
+    query.bindValue(":limit", limit + 1);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to query trips:" << query.lastError().text();
+        return false;
+    }
+
+    page.trips.reserve(limit);
+    while (query.next()) {
+        if (page.trips.size() == limit) {
+            page.hasMore = true;
+            break;
+        }
+        page.trips.append(tripFromQuery(query));
+        page.nextKey = query.value(column);
+        page.nextTripId = page.trips.last().tripId;
+    }
+    return true;
+}
+
+bool createTripQueryIndexes(const QSqlDatabase& database)
+{
+    // Every index ends in the rowid (trip_id), which covers the tie breaker
+    QSqlQuery query(database);
+    for (const char *statement : {
+             "CREATE INDEX IF NOT EXISTS trips_start_time ON trips (start_time)",
+             "CREATE INDEX IF NOT EXISTS trips_driver_start_time ON trips (driver_name, start_time)",
+             "CREATE INDEX IF NOT EXISTS trips_distance ON trips (distance_traveled)",
+             "CREATE INDEX IF NOT EXISTS trips_efficiency ON trips (energy_efficiency_whkm)" }) {
+        if (!query.exec(QLatin1String(statement))) {
+            qDebug() << "Failed to create index:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef TRIPQUERY_H
+#define TRIPQUERY_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include "tripdata.h"
+
+// One page of the trips table, filtered and sorted in SQL.
+//
+// Pages are keyset based: the next page starts after the sort key and id of
+// the last row returned, so every page costs the same index range scan
+// however deep the listing goes, and trips saved meanwhile do not shift rows
+// between pages. The indexes this relies on are created by
+// createTripQueryIndexes().
+struct TripQuery {
+    enum Sort {
+        NewestFirst,        // start_time descending
+        OldestFirst,        // start_time ascending
+        LongestFirst,       // distance_traveled descending
+        MostEfficientFirst  // energy_efficiency_whkm ascending
+    };
+
+    // Filters, each one off by default
+    QDateTime startedAfter;     // inclusive
+    QDateTime startedBefore;    // exclusive
+    QString driverName;         // exact match
+    double minDistanceKm;
+    double minEfficiencyWhKm;
+    double maxEfficiencyWhKm;   // 0 = no limit
+
+    Sort sort;
+    int limit;
+
+    // Cursor: sort key and id of the last row of the previous page
+    QVariant afterKey;
+    int afterTripId;
+
+    TripQuery()
+        : minDistanceKm(0.0), minEfficiencyWhKm(0.0), maxEfficiencyWhKm(0.0)
+        , sort(NewestFirst), limit(DEFAULT_PAGE_SIZE), afterTripId(-1) {}
+
+    bool hasCursor() const { return afterTripId >= 0 && afterKey.isValid(); }
+
+    // The filters and sort order above applied to trips already in memory,
+    // for models that place a changed trip without querying again
+    bool matches(const TripInfo& trip) const;
+    bool sortsBefore(const TripInfo& a, const TripInfo& b) const;
+
+    // From the QML options map, see README.md for the keys
+    static TripQuery fromVariantMap(const QVariantMap& options);
+
+    static const int DEFAULT_PAGE_SIZE = 50;
+    static const int MAX_PAGE_SIZE = 500;
+};
+
+struct TripPage {
+    QList<TripInfo> trips;
+    bool hasMore;
+    // Cursor for the next page, valid when hasMore
+    QVariant nextKey;
+    int nextTripId;
+
+    TripPage() : hasMore(false), nextTripId(-1) {}
+
+    // Query with the same filters continuing after this page
+    TripQuery nextQuery(const TripQuery& query) const;
+};
+
+// Builds a TripInfo from the current row of a "SELECT * FROM trips" query
+TripInfo tripFromQuery(const QSqlQuery& query);
+
+// Runs on whichever thread owns 'database'
+bool queryTrips(const QSqlDatabase& database, const TripQuery& query, TripPage& page);
+
+// Secondary indexes for the filters and sort orders above
+bool createTripQueryIndexes(const QSqlDatabase& database);
+
+#endif // TRIPQUERY_H
@@ -0,0 +1,155 @@
+#include "tripstatskernels.h"
+#include <limits>
+
+#include "cpufeatures.h"
+
+using TripStatsKernels::RangeStats;
+
+namespace {
+
+using KernelFunction = RangeStats (*)(const qint64 *msecs, const double *speeds, qsizetype count);
+
+// Adds points [begin, count) to 'stats', including the intervals between them
+void accumulateScalar(RangeStats& stats, const qint64 *msecs, const double *speeds,
+                      qsizetype begin, qsizetype count, double shift)
+{
+    for (qsizetype i = begin; i < count; ++i) {
+        const double speed = speeds[i];
+        const double shifted = speed - shift;
+        stats.sum += speed;
+        stats.shiftedSum += shifted;
+        stats.shiftedSumSquares += shifted * shifted;
+        if (speed > stats.max) {
+            stats.max = speed;
+        }
+        if (i + 1 < count) {
+            stats.integral += 0.5 * (speed + speeds[i + 1]) * double(msecs[i + 1] - msecs[i]);
+        }
+    }
+}
+
+RangeStats emptyStats()
+{
+    return { 0.0, 0.0, 0.0, -std::numeric_limits<double>::infinity(), 0.0 };
+}
+
+RangeStats computeScalar(const qint64 *msecs, const double *speeds, qsizetype count)
+{
+    RangeStats stats = emptyStats();
+    accumulateScalar(stats, msecs, speeds, 0, count, speeds[0]);
+    return stats;
+}
+
+#ifdef CPU_FEATURES_AVX2
+CPU_FEATURES_TARGET_AVX2
+double horizontalSum(__m256d v)
+{
+    const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+CPU_FEATURES_TARGET_AVX2
+double horizontalMax(__m256d v)
+{
+    const __m128d pair = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+// Built for AVX2 regardless of the compiler flags, only called after a CPU check
+CPU_FEATURES_TARGET_AVX2
+RangeStats computeAvx2(const qint64 *msecs, const double *speeds, qsizetype count)
+{
+    const double shift = speeds[0];
+    const __m256d shiftV = _mm256_set1_pd(shift);
+    // AVX2 has no int64 -> double conversion; intervals are far below 2^52 ms, so
+    // OR-ing them into the mantissa of 2^52 and subtracting 2^52 is exact
+    const __m256i magicBits = _mm256_set1_epi64x(0x4330000000000000LL);
+    const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+
+    __m256d sum = _mm256_setzero_pd();
+    __m256d shiftedSum = _mm256_setzero_pd();
+    __m256d shiftedSquares = _mm256_setzero_pd();
+    __m256d integral = _mm256_setzero_pd();
+    __m256d max = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+
+    // Each step takes points i..i+3 and the intervals that follow them
+    qsizetype i = 0;
+    for (; i + 4 < count; i += 4) {
+        const __m256d speed = _mm256_loadu_pd(speeds + i);
+        const __m256d nextSpeed = _mm256_loadu_pd(speeds + i + 1);
+        const __m256i time = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(msecs + i));
+        const __m256i nextTime = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(msecs + i + 1));
+        const __m256d interval = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(_mm256_sub_epi64(nextTime, time), magicBits)), magic);
+
+        const __m256d shifted = _mm256_sub_pd(speed, shiftV);
+        sum = _mm256_add_pd(sum, speed);
+        shiftedSum = _mm256_add_pd(shiftedSum, shifted);
+        shiftedSquares = _mm256_add_pd(shiftedSquares, _mm256_mul_pd(shifted, shifted));
+        integral = _mm256_add_pd(integral, _mm256_mul_pd(_mm256_add_pd(speed, nextSpeed), interval));
+        // Operand order keeps the accumulator when the speed is NaN
+        max = _mm256_max_pd(speed, max);
+    }
+
+    RangeStats stats = { horizontalSum(sum), horizontalSum(shiftedSum), horizontalSum(shiftedSquares),
+                         horizontalMax(max), 0.5 * horizontalSum(integral) };
+    accumulateScalar(stats, msecs, speeds, i, count, shift);
+    return stats;
+}
+#endif
+
+#ifdef CPU_FEATURES_NEON
+RangeStats computeNeon(const qint64 *msecs, const double *speeds, qsizetype count)
+{
+    const double shift = speeds[0];
+    const float64x2_t shiftV = vdupq_n_f64(shift);
+
+    float64x2_t sum = vdupq_n_f64(0.0);
+    float64x2_t shiftedSum = vdupq_n_f64(0.0);
+    float64x2_t shiftedSquares = vdupq_n_f64(0.0);
+    float64x2_t integral = vdupq_n_f64(0.0);
+    float64x2_t max = vdupq_n_f64(-std::numeric_limits<double>::infinity());
+
+    qsizetype i = 0;
+    for (; i + 2 < count; i += 2) {
+        const float64x2_t speed = vld1q_f64(speeds + i);
+        const float64x2_t nextSpeed = vld1q_f64(speeds + i + 1);
+        const int64x2_t time = vld1q_s64(reinterpret_cast<const int64_t *>(msecs + i));
+        const int64x2_t nextTime = vld1q_s64(reinterpret_cast<const int64_t *>(msecs + i + 1));
+        const float64x2_t interval = vcvtq_f64_s64(vsubq_s64(nextTime, time));
+
+        const float64x2_t shifted = vsubq_f64(speed, shiftV);
+        sum = vaddq_f64(sum, speed);
+        shiftedSum = vaddq_f64(shiftedSum, shifted);
+        shiftedSquares = vfmaq_f64(shiftedSquares, shifted, shifted);
+        integral = vfmaq_f64(integral, vaddq_f64(speed, nextSpeed), interval);
+        // maxnm ignores a NaN lane like the scalar compare does
+        max = vmaxnmq_f64(max, speed);
+    }
+
+    RangeStats stats = { vaddvq_f64(sum), vaddvq_f64(shiftedSum), vaddvq_f64(shiftedSquares),
+                         vmaxnmvq_f64(max), 0.5 * vaddvq_f64(integral) };
+    accumulateScalar(stats, msecs, speeds, i, count, shift);
+    return stats;
+}
+#endif
+
+const CpuFeatures::Kernel<KernelFunction> &kernel()
+{
+    static const CpuFeatures::Kernel<KernelFunction> selected = CpuFeatures::select<KernelFunction>(
+        CPU_FEATURES_IF_AVX2(computeAvx2), CPU_FEATURES_IF_NEON(computeNeon), computeScalar);
+    return selected;
+}
+
+} // namespace
+
+RangeStats TripStatsKernels::compute(const qint64 *msecs, const double *speeds, qsizetype count)
+{
+    if (count <= 0) return emptyStats();
+    return kernel().function(msecs, speeds, count);
+}
+
+const char *TripStatsKernels::implementation()
+{
+    return kernel().name;
+}
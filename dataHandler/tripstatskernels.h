@@ -0,0 +1,27 @@
+#ifndef TRIPSTATSKERNELS_H
+#define TRIPSTATSKERNELS_H
+
+#include <QtGlobal>
+
+// Fused single pass over the timestamp and speed columns of a run of points:
+// speed sum and spread, max speed and the trapezoidal speed-time integral.
+// Like MotionSegmentation it uses AVX2 or NEON when available and scalar code
+// otherwise. Timestamps must be ascending.
+namespace TripStatsKernels {
+
+struct RangeStats {
+    double sum;                // sum of speeds
+    double shiftedSum;         // sum of (speed - first speed)
+    double shiftedSumSquares;  // sum of (speed - first speed)^2, for a stable variance
+    double max;                // largest speed, -inf for no points, NaN ignored
+    double integral;           // sum of (v[i] + v[i+1]) / 2 * (t[i+1] - t[i]), m/s * ms
+};
+
+RangeStats compute(const qint64 *msecs, const double *speeds, qsizetype count);
+
+// Name of the kernel selected for this CPU, for logging
+const char *implementation();
+
+} // namespace TripStatsKernels
+
+#endif // TRIPSTATSKERNELS_H
@@ -0,0 +1,150 @@
+#include "triptelemetrycodec.h"
+#include <QTimeZone>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double SPEED_SCALE = 100.0;   // 0.01 m/s
+const double CHARGE_SCALE = 100.0;  // 0.01 %
+
+quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+void writeVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char(value | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+// False for a value that cannot be stored, i.e. one that is not finite
+bool quantize(double value, double scale, qint64& quantized)
+{
+    const double scaled = value * scale;
+    // Also keeps llround() in range
+    if (!std::isfinite(scaled) || std::fabs(scaled) >= 1e15) return false;
+    quantized = qint64(std::llround(scaled));
+    return true;
+}
+
+// Deltas between the finite values, each shifted left for the flag bit; a
+// value that is not finite is the flag alone and leaves the base unchanged
+void writeValues(QByteArray& out, const QList<VehicleDataPoint>& points, double VehicleDataPoint::*member,
+                 double scale)
+{
+    qint64 previous = 0;
+    for (const VehicleDataPoint& point : points) {
+        qint64 value = 0;
+        if (!quantize(point.*member, scale, value)) {
+            writeVarint(out, 1);
+            continue;
+        }
+        writeVarint(out, zigzag(value - previous) << 1);
+        previous = value;
+    }
+}
+
+struct VarintReader {
+    const uchar *position;
+    const uchar *end;
+    bool ok = true;
+
+    quint64 next()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (position == end) break;
+            const uchar byte = *position++;
+            value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    qint64 nextSigned() { return unzigzag(next()); }
+
+    void readValues(QList<VehicleDataPoint>& points, double VehicleDataPoint::*member, double scale, bool flagged)
+    {
+        qint64 value = 0;
+        for (VehicleDataPoint& point : points) {
+            quint64 encoded = next();
+            if (flagged) {
+                if (encoded & 1) {
+                    point.*member = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                }
+                encoded >>= 1;
+            }
+            value += unzigzag(encoded);
+            point.*member = value / scale;
+        }
+    }
+};
+
+} // namespace
+
+namespace TripTelemetryCodec {
+
+QByteArray encode(const QList<VehicleDataPoint>& points)
+{
+    QByteArray raw;
+    raw.reserve(points.size() * 4 + 8);
+    writeVarint(raw, quint64(points.size()));
+
+    qint64 previous = 0;
+    for (const VehicleDataPoint& point : points) {
+        const qint64 msecs = point.timestamp.toMSecsSinceEpoch();
+        writeVarint(raw, zigzag(msecs - previous));
+        previous = msecs;
+    }
+
+    writeValues(raw, points, &VehicleDataPoint::speed, SPEED_SCALE);
+    writeValues(raw, points, &VehicleDataPoint::batteryCharge, CHARGE_SCALE);
+
+    return qCompress(raw);
+}
+
+bool decode(const QByteArray& blob, QList<VehicleDataPoint>& points, int encoding)
+{
+    points.clear();
+    if (encoding < 1 || encoding > ENCODING_VERSION) return false;
+
+    const QByteArray raw = qUncompress(blob);
+    if (raw.isEmpty()) return false;
+
+    VarintReader reader{ reinterpret_cast<const uchar *>(raw.constData()),
+                         reinterpret_cast<const uchar *>(raw.constData()) + raw.size() };
+    const quint64 count = reader.next();
+    // Every point takes at least one byte per column
+    if (!reader.ok || count > quint64(raw.size()) / 3) return false;
+
+    points.resize(qsizetype(count));
+
+    qint64 value = 0;
+    for (VehicleDataPoint& point : points) {
+        value += reader.nextSigned();
+        point.timestamp = QDateTime::fromMSecsSinceEpoch(value, QTimeZone::UTC);
+    }
+    // Version 1 has no flag bits
+    reader.readValues(points, &VehicleDataPoint::speed, SPEED_SCALE, encoding >= 2);
+    reader.readValues(points, &VehicleDataPoint::batteryCharge, CHARGE_SCALE, encoding >= 2);
+
+    if (!reader.ok || reader.position != reader.end) {
+        points.clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace TripTelemetryCodec
@@ -0,0 +1,29 @@
+#ifndef TRIPTELEMETRYCODEC_H
+#define TRIPTELEMETRYCODEC_H
+
+#include <QByteArray>
+#include <QList>
+
+#include "tripdata.h"
+
+// Compact encoding of one trip's points for the trip_telemetry table.
+//
+// The points are stored column by column: timestamps as varint deltas from the
+// previous point, speed (0.01 m/s) and charge (0.01 %) quantized to integers
+// and stored as zigzag varint deltas too. Steady 1 Hz data becomes a few bytes
+// per point, which qCompress() then shrinks further. Since version 2 the low
+// bit of each speed and charge varint flags a value that is not finite, which
+// decodes back to NaN (unknown); version 1 stored those as 0.
+namespace TripTelemetryCodec {
+
+// Stored next to the blob so the layout can change later
+const int ENCODING_VERSION = 2;
+
+QByteArray encode(const QList<VehicleDataPoint>& points);
+// False for a truncated or corrupt blob or an unknown encoding, 'points' is
+// left empty then. Older encodings are still read.
+bool decode(const QByteArray& blob, QList<VehicleDataPoint>& points, int encoding = ENCODING_VERSION);
+
+} // namespace TripTelemetryCodec
+
+#endif // TRIPTELEMETRYCODEC_H